@@ -256,8 +256,6 @@ HEADERS += src/typedefs.h \
            src/rendersettings.h \
            src/colormap.h \
            src/ThrownTogetherRenderer.h \
-           src/CGAL_OGL_Polyhedron.h \
-           src/OGL_helper.h \
            src/QGLView.h \
            src/GLView.h \
            src/MainWindow.h \
@@ -271,11 +269,13 @@ HEADERS += src/typedefs.h \
            src/context.h \
            src/modcontext.h \
            src/evalcontext.h \
+           src/functionmemo.h \
            src/csgterm.h \
            src/csgtermnormalizer.h \
            src/dxfdata.h \
            src/dxfdim.h \
            src/export.h \
+           src/import.h \
            src/expression.h \
            src/stackcheck.h \
            src/function.h \
@@ -305,19 +305,26 @@ HEADERS += src/typedefs.h \
            src/GeometryUtils.h \
            src/polyset-utils.h \
            src/polyset.h \
+           src/VBOCache.h \
+           src/IndexedMesh.h \
            src/printutils.h \
            src/fileutils.h \
            src/value.h \
            src/progress.h \
+           src/parallel.h \
            src/editor.h \
            src/visitor.h \
            src/state.h \
            src/traverser.h \
            src/nodecache.h \
            src/nodedumper.h \
+           src/nodehasher.h \
            src/ModuleCache.h \
+           src/InstantiationCache.h \
            src/GeometryCache.h \
+           src/DiskCache.h \
            src/GeometryEvaluator.h \
+           src/GeometryProfiler.h \
            src/CSGTermEvaluator.h \
            src/Tree.h \
 src/DrawingCallback.h \
@@ -339,6 +346,7 @@ src/FontCache.h \
            src/OffscreenContextAll.hpp \
            src/fbo.h \
            src/imageutils.h \
+           src/PngWriteQueue.h \
            src/system-gl.h \
            src/CsgInfo.h \
            \
@@ -365,6 +373,7 @@ SOURCES += src/version_check.cc \
            src/context.cc \
            src/modcontext.cc \
            src/evalcontext.cc \
+           src/functionmemo.cc \
            src/csgterm.cc \
            src/csgtermnormalizer.cc \
            src/Geometry.cc \
@@ -373,6 +382,8 @@ SOURCES += src/version_check.cc \
            src/polyset-utils.cc \
            src/GeometryUtils.cc \
            src/polyset.cc \
+           src/VBOCache.cc \
+           src/IndexedMesh.cc \
            src/csgops.cc \
            src/transform.cc \
            src/color.cc \
@@ -391,6 +402,7 @@ SOURCES += src/version_check.cc \
            src/printutils.cc \
            src/fileutils.cc \
            src/progress.cc \
+           src/parallel.cc \
            src/parsersettings.cc \
            src/stl-utils.cc \
            src/boost-utils.cc \
@@ -398,10 +410,14 @@ SOURCES += src/version_check.cc \
            src/LibraryInfo.cc \
            \
            src/nodedumper.cc \
+           src/nodehasher.cc \
            src/traverser.cc \
            src/GeometryEvaluator.cc \
+           src/GeometryProfiler.cc \
            src/ModuleCache.cc \
+           src/InstantiationCache.cc \
            src/GeometryCache.cc \
+           src/DiskCache.cc \
            src/Tree.cc \
 	   src/DrawingCallback.cc \
 	   src/FreetypeRenderer.cc \
@@ -423,6 +439,7 @@ SOURCES += src/version_check.cc \
            src/export.cc \
            src/export_png.cc \
            src/import.cc \
+           src/import_stl.cc \
            src/renderer.cc \
            src/colormap.cc \
            src/ThrownTogetherRenderer.cc \
@@ -432,6 +449,7 @@ SOURCES += src/version_check.cc \
            src/fbo.cc \
            src/system-gl.cc \
            src/imageutils.cc \
+           src/PngWriteQueue.cc \
            src/lodepng.cpp \
            \
            src/openscad.cc \
@@ -490,7 +508,9 @@ HEADERS += src/cgal.h \
            src/cgalutils.h \
            src/Reindexer.h \
            src/CGALCache.h \
+           src/ConvexDecompositionCache.h \
            src/CGALRenderer.h \
+           src/CGALRenderBuffer.h \
            src/CGAL_Nef_polyhedron.h \
            src/CGAL_Nef3_workaround.h \
            src/convex_hull_3_bugfix.h \
@@ -500,8 +520,11 @@ HEADERS += src/cgal.h \
 SOURCES += src/cgalutils.cc \
            src/cgalutils-tess.cc \
            src/cgalutils-polyhedron.cc \
+           src/cgalutils-corefine.cc \
            src/CGALCache.cc \
+           src/ConvexDecompositionCache.cc \
            src/CGALRenderer.cc \
+           src/CGALRenderBuffer.cc \
            src/CGAL_Nef_polyhedron.cc \
            src/cgalworker.cc \
            src/Polygon2d-CGAL.cc
@@ -2,24 +2,44 @@
 #include "printutils.h"
 #include "CGAL_Nef_polyhedron.h"
 
+#include <boost/thread/locks.hpp>
+
 CGALCache *CGALCache::inst = NULL;
 
 CGALCache::CGALCache(size_t limit) : cache(limit)
 {
 }
 
+bool CGALCache::contains(const std::string &id) const
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	return this->cache.contains(id);
+}
+
+/*!
+	Returns an empty pointer if the entry doesn't exist, e.g. since it was
+	evicted by another thread after calling contains().
+*/
 shared_ptr<const CGAL_Nef_polyhedron> CGALCache::get(const std::string &id) const
 {
-	const shared_ptr<const CGAL_Nef_polyhedron> &N = this->cache[id]->N;
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	const cache_entry *entry = this->cache[id];
+	if (!entry) return shared_ptr<const CGAL_Nef_polyhedron>();
+	const shared_ptr<const CGAL_Nef_polyhedron> &N = entry->N;
 #ifdef DEBUG
 	PRINTB("CGAL Cache hit: %s (%d bytes)", id.substr(0, 40) % (N ? N->memsize() : 0));
 #endif
 	return N;
 }
 
-bool CGALCache::insert(const std::string &id, const shared_ptr<const CGAL_Nef_polyhedron> &N)
+/*!
+	computetime is the time in seconds it took to create the object. Entries
+	which are expensive to recompute relative to their size are kept longer.
+*/
+bool CGALCache::insert(const std::string &id, const shared_ptr<const CGAL_Nef_polyhedron> &N, double computetime)
 {
-	bool inserted = this->cache.insert(id, new cache_entry(N), N ? N->memsize() : 0);
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	bool inserted = this->cache.insert(id, new cache_entry(N), N ? N->memsize() : 0, computetime);
 #ifdef DEBUG
 	if (inserted) PRINTB("CGAL Cache insert: %s (%d bytes)", id.substr(0, 40) % (N ? N->memsize() : 0));
 	else PRINTB("CGAL Cache insert failed: %s (%d bytes)", id.substr(0, 40) % (N ? N->memsize() : 0));
@@ -29,25 +49,44 @@ bool CGALCache::insert(const std::string &id, const shared_ptr<const CGAL_Nef_po
 
 size_t CGALCache::maxSize() const
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	return this->cache.maxCost();
 }
 
 void CGALCache::setMaxSize(size_t limit)
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	this->cache.setMaxCost(limit);
 }
 
 void CGALCache::clear()
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	cache.clear();
 }
 
 void CGALCache::print()
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	PRINTB("CGAL Polyhedrons in cache: %d", this->cache.size());
 	PRINTB("CGAL cache size in bytes: %d", this->cache.totalCost());
 }
 
+/*!
+	Counts a lookup which found nothing, see Cache::recordMiss().
+*/
+void CGALCache::recordMiss()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->cache.recordMiss();
+}
+
+void CGALCache::printStats()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	PRINTB("CGAL cache: %d hits, %d misses, %d evictions", this->cache.hits() % this->cache.misses() % this->cache.evictions());
+}
+
 CGALCache::cache_entry::cache_entry(const shared_ptr<const CGAL_Nef_polyhedron> &N)
 	: N(N)
 {
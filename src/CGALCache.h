@@ -3,6 +3,8 @@
 #include "cache.h"
 #include "memory.h"
 
+#include <boost/thread/mutex.hpp>
+
 /*!
 */
 class CGALCache
@@ -12,13 +14,15 @@ public:
 
 	static CGALCache *instance() { if (!inst) inst = new CGALCache; return inst; }
 
-	bool contains(const std::string &id) const { return this->cache.contains(id); }
+	bool contains(const std::string &id) const;
 	shared_ptr<const class CGAL_Nef_polyhedron> get(const std::string &id) const;
-	bool insert(const std::string &id, const shared_ptr<const CGAL_Nef_polyhedron> &N);
+	bool insert(const std::string &id, const shared_ptr<const CGAL_Nef_polyhedron> &N, double computetime = 0);
 	size_t maxSize() const;
 	void setMaxSize(size_t limit);
 	void clear();
 	void print();
+	void recordMiss();
+	void printStats();
 
 private:
 	static CGALCache *inst;
@@ -31,4 +35,6 @@ private:
 	};
 
 	Cache<std::string, cache_entry> cache;
+	// Guards the cache, which is shared by concurrent GeometryEvaluators
+	mutable boost::mutex mutex;
 };
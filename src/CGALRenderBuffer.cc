@@ -0,0 +1,90 @@
+#include "CGALRenderBuffer.h"
+#include "GeometryUtils.h"
+#include "cgal.h"
+
+#include <boost/foreach.hpp>
+
+namespace /* anonymous */ {
+	template<typename Result, typename V>
+	Result vector_convert(V const& v) {
+		return Result(CGAL::to_double(v[0]),CGAL::to_double(v[1]),CGAL::to_double(v[2]));
+	}
+
+	void addVertex(std::vector<float> &data, const Vector3f &p, const Vector3f &n, BoundingBox &bbox)
+	{
+		data.push_back(p[0]);
+		data.push_back(p[1]);
+		data.push_back(p[2]);
+		data.push_back(n[0]);
+		data.push_back(n[1]);
+		data.push_back(n[2]);
+		bbox.extend(p.cast<double>());
+	}
+}
+
+CGALRenderBuffer::CGALRenderBuffer(const CGAL_Nef_polyhedron3 &N)
+{
+	std::vector<float> parts[NUM_PARTS];
+	const Vector3f nonormal(0, 0, 0);
+
+	std::vector<Vector3f> verts;
+	std::vector<IndexedFace> faces;
+	std::vector<IndexedTriangle> triangles;
+	CGAL_Nef_polyhedron3::Halffacet_const_iterator hfaceti;
+	CGAL_forall_halffacets(hfaceti, N) {
+		// Skip halffacets facing the solid volume
+		if (hfaceti->incident_volume()->mark()) continue;
+		verts.clear();
+		faces.clear();
+		CGAL_Nef_polyhedron3::Halffacet_cycle_const_iterator cyclei;
+		CGAL_forall_facet_cycles_of(cyclei, hfaceti) {
+			if (!cyclei.is_shalfedge()) continue;
+			CGAL_Nef_polyhedron3::SHalfedge_around_facet_const_circulator c1(cyclei);
+			CGAL_Nef_polyhedron3::SHalfedge_around_facet_const_circulator c2(c1);
+			faces.push_back(IndexedFace());
+			IndexedFace &currface = faces.back();
+			CGAL_For_all(c1, c2) {
+				// Vertices may merge when converting to float; skip consecutive duplicates
+				const Vector3f p = vector_convert<Vector3f>(c1->source()->center_vertex()->point());
+				if (!currface.empty() && verts.back() == p) continue;
+				currface.push_back(verts.size());
+				verts.push_back(p);
+			}
+			if (currface.size() > 1 && verts[currface.front()] == verts[currface.back()]) currface.pop_back();
+			if (currface.size() < 3) faces.pop_back();
+		}
+		if (faces.empty()) continue;
+
+		triangles.clear();
+		if (GeometryUtils::tessellatePolygonWithHoles(&verts[0], faces, triangles, NULL)) continue;
+		Vector3f normal = vector_convert<Vector3f>(hfaceti->plane().orthogonal_vector());
+		normal.normalize();
+		std::vector<float> &part = parts[hfaceti->mark() ? MARKED_FACETS : UNMARKED_FACETS];
+		BOOST_FOREACH(const IndexedTriangle &t, triangles) {
+			for (int i=0;i<3;i++) addVertex(part, verts[t[i]], normal, this->bbox);
+		}
+	}
+
+	CGAL_Nef_polyhedron3::Halfedge_const_iterator e;
+	CGAL_forall_edges(e, *N.sncp()) {
+		std::vector<float> &part = parts[e->mark() ? MARKED_EDGES : UNMARKED_EDGES];
+		addVertex(part, vector_convert<Vector3f>(e->source()->point()), nonormal, this->bbox);
+		addVertex(part, vector_convert<Vector3f>(e->twin()->source()->point()), nonormal, this->bbox);
+	}
+
+	CGAL_Nef_polyhedron3::Vertex_const_iterator v;
+	CGAL_forall_vertices(v, *N.sncp()) {
+		std::vector<float> &part = parts[v->mark() ? MARKED_VERTICES : UNMARKED_VERTICES];
+		addVertex(part, vector_convert<Vector3f>(v->point()), nonormal, this->bbox);
+	}
+
+	size_t size = 0;
+	for (int i=0;i<NUM_PARTS;i++) size += parts[i].size();
+	this->data.reserve(size);
+	for (int i=0;i<NUM_PARTS;i++) {
+		this->first[i] = this->data.size() / stride;
+		this->count[i] = parts[i].size() / stride;
+		this->data.insert(this->data.end(), parts[i].begin(), parts[i].end());
+		std::vector<float>().swap(parts[i]);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "linalg.h"
+#include "cgalfwd.h"
+
+#include <vector>
+
+/*!
+	The facets, edges and vertices of a 3D Nef polyhedron as flat vertex
+	data, ready to be uploaded to the GPU in one go.
+
+	Building it only does CPU work and no OpenGL calls, so it can run on the
+	CGALWorker thread. Facets are triangulated with libtess2, like when
+	converting to a PolySet, instead of GLU tessellation at draw time.
+
+	All parts share one array of interleaved positions and normals. Edges and
+	vertices have zero normals, as they're drawn without lighting.
+*/
+class CGALRenderBuffer
+{
+public:
+	enum Part {
+		MARKED_FACETS,
+		UNMARKED_FACETS,
+		MARKED_EDGES,
+		UNMARKED_EDGES,
+		MARKED_VERTICES,
+		UNMARKED_VERTICES,
+		NUM_PARTS
+	};
+
+	CGALRenderBuffer(const CGAL_Nef_polyhedron3 &N);
+
+	static const size_t stride = 6; // floats per vertex
+
+	std::vector<float> data;
+	size_t first[NUM_PARTS]; // first vertex of each part
+	size_t count[NUM_PARTS]; // number of vertices of each part
+	BoundingBox bbox;
+};
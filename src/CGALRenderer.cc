@@ -36,13 +36,19 @@
 #include "printutils.h"
 
 #include "CGALRenderer.h"
-#include "CGAL_OGL_Polyhedron.h"
+#include "CGALRenderBuffer.h"
+#include "VBOCache.h"
 #include "CGAL_Nef_polyhedron.h"
 #include "cgal.h"
 
 //#include "Preferences.h"
 
-CGALRenderer::CGALRenderer(shared_ptr<const class Geometry> geom)
+/*!
+	For Nef polyhedra, \a buffer may hold the already converted geometry, see
+	CGALWorker. Otherwise the conversion is done here.
+*/
+CGALRenderer::CGALRenderer(shared_ptr<const class Geometry> geom, shared_ptr<CGALRenderBuffer> buffer)
+	: vbo(0), vbocache(NULL)
 {
 	if (shared_ptr<const PolySet> ps = dynamic_pointer_cast<const PolySet>(geom)) {
 		assert(ps->getDimension() == 3);
@@ -58,40 +64,54 @@ CGALRenderer::CGALRenderer(shared_ptr<const class Geometry> geom)
 	}
 	else if (shared_ptr<const CGAL_Nef_polyhedron> new_N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
 		assert(new_N->getDimension() == 3);
-		if (!new_N->isEmpty()) {
-			this->N = new_N;
+		if (buffer) {
+			this->buffer = buffer;
+		}
+		else if (!new_N->isEmpty()) {
+			this->buffer.reset(new CGALRenderBuffer(*new_N->p3));
 		}
 	}
 }
 
+/*!
+	The renderer may be destroyed outside of drawing, e.g. by MainWindow, when
+	its GL context isn't current. The buffer is then deleted by the view's
+	cache the next time it draws.
+*/
 CGALRenderer::~CGALRenderer()
 {
+	if (!this->vbo) return;
+	if (this->vbocache) this->vbocache->release(this->vbo);
+	else glDeleteBuffers(1, &this->vbo);
 }
 
-shared_ptr<class CGAL_OGL_Polyhedron> CGALRenderer::getPolyhedron() const
+/*!
+	Draws one part of the buffer. The vertex arrays must be set up.
+*/
+void CGALRenderer::drawPart(int part, GLenum mode) const
 {
-	if (this->N && !this->polyhedron) buildPolyhedron();
-	return this->polyhedron;
-}
-
-void CGALRenderer::buildPolyhedron() const
-{
-	PRINTD("buildPolyhedron");
-	this->polyhedron.reset(new CGAL_OGL_Polyhedron(*this->colorscheme));
-	CGAL::OGL::Nef3_Converter<CGAL_Nef_polyhedron3>::convert_to_OGLPolyhedron(*this->N->p3, this->polyhedron.get());
-	// CGAL_NEF3_MARKED_FACET_COLOR <- CGAL_FACE_BACK_COLOR
-	// CGAL_NEF3_UNMARKED_FACET_COLOR <- CGAL_FACE_FRONT_COLOR
-	this->polyhedron->init();
-	PRINTD("buildPolyhedron() end");
-}
-
-// Overridden from Renderer
-void CGALRenderer::setColorScheme(const ColorScheme &cs)
-{
-	PRINTD("setColorScheme");
-	Renderer::setColorScheme(cs);
-	this->polyhedron.reset(); // Mark as dirty
-	PRINTD("setColorScheme done");
+	if (this->buffer->count[part] == 0) return;
+	switch (part) {
+	case CGALRenderBuffer::MARKED_FACETS:
+		glColor3fv(ColorMap::getColor(*this->colorscheme, CGAL_FACE_FRONT_COLOR).data());
+		break;
+	case CGALRenderBuffer::UNMARKED_FACETS:
+		glColor3fv(ColorMap::getColor(*this->colorscheme, CGAL_FACE_BACK_COLOR).data());
+		break;
+	case CGALRenderBuffer::MARKED_EDGES:
+		glColor3fv(ColorMap::getColor(*this->colorscheme, CGAL_EDGE_FRONT_COLOR).data());
+		break;
+	case CGALRenderBuffer::UNMARKED_EDGES:
+		glColor3fv(ColorMap::getColor(*this->colorscheme, CGAL_EDGE_BACK_COLOR).data());
+		break;
+	case CGALRenderBuffer::MARKED_VERTICES:
+		glColor3ub(0xff, 0xf6, 0x7c);
+		break;
+	case CGALRenderBuffer::UNMARKED_VERTICES:
+		glColor3ub(0xb7, 0xe8, 0x5c);
+		break;
+	}
+	glDrawArrays(mode, this->buffer->first[part], this->buffer->count[part]);
 }
 
 void CGALRenderer::draw(bool showfaces, bool showedges) const
@@ -120,24 +140,58 @@ void CGALRenderer::draw(bool showfaces, bool showedges) const
 			glLineWidth(2);
 // FIXME:		const QColor &col2 = Preferences::inst()->color(Preferences::CGAL_EDGE_2D_COLOR);
 			glColor3f(1.0f, 0.0f, 0.0f);
-			this->polyset->render_edges(CSGMODE_NONE);
+			render_edges(this->polyset, CSGMODE_NONE);
 			glEnable(GL_DEPTH_TEST);
 		}
 		else {
 			// Draw 3D polygons
 			const Color4f c(-1,-1,-1,-1);	
 			setColor(COLORMODE_MATERIAL, c.data(), NULL);
-			this->polyset->render_surface(CSGMODE_NORMAL, Transform3d::Identity(), NULL);
+			render_surface(this->polyset, CSGMODE_NORMAL, Transform3d::Identity(), NULL);
 		}
 	}
-	else {
-		shared_ptr<class CGAL_OGL_Polyhedron> polyhedron = getPolyhedron();
-        if (polyhedron) {
-            PRINTD("draw() polyhedron");
-            if (showfaces) polyhedron->set_style(SNC_BOUNDARY);
-            else polyhedron->set_style(SNC_SKELETON);
-            polyhedron->draw(showfaces && showedges);
-        }
+	else if (this->buffer) {
+		PRINTD("draw() polyhedron");
+		std::vector<float> &data = this->buffer->data;
+		if (!this->vbo && GLEW_VERSION_1_5 && !data.empty()) {
+			// Upload everything at once and drop the CPU copy
+			glGenBuffers(1, &this->vbo);
+			this->vbocache = VBOCache::current();
+			if (this->vbo) {
+				glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+				glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				std::vector<float>().swap(data);
+			}
+		}
+
+		const GLsizei stridebytes = CGALRenderBuffer::stride * sizeof(float);
+		const float *base = NULL;
+		if (this->vbo) glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+		else if (!data.empty()) base = &data[0];
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, stridebytes, base);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, stridebytes, base + 3);
+
+		if (showfaces) {
+			drawPart(CGALRenderBuffer::MARKED_FACETS, GL_TRIANGLES);
+			drawPart(CGALRenderBuffer::UNMARKED_FACETS, GL_TRIANGLES);
+		}
+		if (!showfaces || showedges) {
+			glDisable(GL_LIGHTING);
+			glLineWidth(5);
+			drawPart(CGALRenderBuffer::MARKED_EDGES, GL_LINES);
+			drawPart(CGALRenderBuffer::UNMARKED_EDGES, GL_LINES);
+			glPointSize(10);
+			drawPart(CGALRenderBuffer::MARKED_VERTICES, GL_POINTS);
+			drawPart(CGALRenderBuffer::UNMARKED_VERTICES, GL_POINTS);
+			glEnable(GL_LIGHTING);
+		}
+
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		if (this->vbo) glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 	PRINTD("draw() end");
 }
@@ -149,14 +203,8 @@ BoundingBox CGALRenderer::getBoundingBox() const
 	if (this->polyset) {
 		bbox = this->polyset->getBoundingBox();
 	}
-	else {
-		shared_ptr<class CGAL_OGL_Polyhedron> polyhedron = getPolyhedron();
-		if (polyhedron) {
-			CGAL::Bbox_3 cgalbbox = polyhedron->bbox();
-			bbox = BoundingBox(
-				Vector3d(cgalbbox.xmin(), cgalbbox.ymin(), cgalbbox.zmin()),
-				Vector3d(cgalbbox.xmax(), cgalbbox.ymax(), cgalbbox.zmax()));
-		}
+	else if (this->buffer) {
+		bbox = this->buffer->bbox;
 	}
 	return bbox;
 }
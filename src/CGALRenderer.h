@@ -1,22 +1,23 @@
 #pragma once
 
 #include "renderer.h"
-#include "CGAL_Nef_polyhedron.h"
 
 class CGALRenderer : public Renderer
 {
 public:
-	CGALRenderer(shared_ptr<const class Geometry> geom);
+	CGALRenderer(shared_ptr<const class Geometry> geom,
+							 shared_ptr<class CGALRenderBuffer> buffer = shared_ptr<CGALRenderBuffer>());
 	~CGALRenderer();
 	virtual void draw(bool showfaces, bool showedges) const;
-	virtual void setColorScheme(const ColorScheme &cs);
 	virtual BoundingBox getBoundingBox() const;
 
 private:
-	shared_ptr<class CGAL_OGL_Polyhedron> getPolyhedron() const;
-	void buildPolyhedron() const;
+	void drawPart(int part, GLenum mode) const;
 
-	mutable shared_ptr<class CGAL_OGL_Polyhedron> polyhedron;
-	shared_ptr<const CGAL_Nef_polyhedron> N;
+	// Uploaded to vbo on the first draw, after which only the layout is kept
+	shared_ptr<CGALRenderBuffer> buffer;
+	mutable GLuint vbo;
+	// The cache of the view vbo was created in, which deletes it
+	mutable class VBOCache *vbocache;
 	shared_ptr<const class PolySet> polyset;
 };
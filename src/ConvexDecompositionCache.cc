@@ -0,0 +1,64 @@
+#include "ConvexDecompositionCache.h"
+#include "printutils.h"
+
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+
+ConvexDecompositionCache *ConvexDecompositionCache::inst = NULL;
+
+ConvexDecompositionCache::ConvexDecompositionCache(size_t limit) : cache(limit)
+{
+}
+
+/*!
+	Returns an empty pointer if the entry doesn't exist.
+*/
+shared_ptr<const ConvexDecompositionCache::Parts> ConvexDecompositionCache::get(const std::string &id) const
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	const cache_entry *entry = this->cache[id];
+	if (!entry) return shared_ptr<const Parts>();
+	PRINTDB("Convex decomposition cache hit: %s (%d parts)", id.substr(0, 40) % entry->parts->size());
+	return entry->parts;
+}
+
+bool ConvexDecompositionCache::insert(const std::string &id, const shared_ptr<const Parts> &parts)
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	bool inserted = this->cache.insert(id, new cache_entry(parts), memsize(*parts));
+	PRINTDB("Convex decomposition cache insert%s: %s (%d bytes)",
+					(inserted ? "" : " failed") % id.substr(0, 40) % memsize(*parts));
+	return inserted;
+}
+
+size_t ConvexDecompositionCache::maxSize() const
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	return this->cache.maxCost();
+}
+
+void ConvexDecompositionCache::setMaxSize(size_t limit)
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->cache.setMaxCost(limit);
+}
+
+void ConvexDecompositionCache::clear()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	cache.clear();
+}
+
+void ConvexDecompositionCache::print()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	PRINTB("Convex decompositions in cache: %d", this->cache.size());
+	PRINTB("Convex decomposition cache size in bytes: %d", this->cache.totalCost());
+}
+
+size_t ConvexDecompositionCache::memsize(const Parts &parts)
+{
+	size_t mem = sizeof(Parts) + parts.capacity() * sizeof(Part);
+	BOOST_FOREACH(const Part &part, parts) mem += part.capacity() * sizeof(Part::value_type);
+	return mem;
+}
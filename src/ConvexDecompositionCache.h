@@ -0,0 +1,46 @@
+#pragma once
+
+#include "cache.h"
+#include "memory.h"
+
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+
+/*!
+	Caches the convex parts of Minkowski operands, keyed by the node ID string
+	of the operand (see Tree::getIdString()). Each part is stored as the
+	vertices of a convex polyhedron, which is all the pairwise hull computation
+	in CGALUtils::applyMinkowski() needs.
+*/
+class ConvexDecompositionCache
+{
+public:
+	typedef std::vector<CGAL::Epick::Point_3> Part;
+	typedef std::vector<Part> Parts;
+
+	ConvexDecompositionCache(size_t limit = 50*1024*1024);
+
+	static ConvexDecompositionCache *instance() { if (!inst) inst = new ConvexDecompositionCache; return inst; }
+
+	shared_ptr<const Parts> get(const std::string &id) const;
+	bool insert(const std::string &id, const shared_ptr<const Parts> &parts);
+	size_t maxSize() const;
+	void setMaxSize(size_t limit);
+	void clear();
+	void print();
+
+private:
+	static ConvexDecompositionCache *inst;
+
+	struct cache_entry {
+		shared_ptr<const Parts> parts;
+		cache_entry(const shared_ptr<const Parts> &parts) : parts(parts) {}
+	};
+
+	static size_t memsize(const Parts &parts);
+
+	Cache<std::string, cache_entry> cache;
+	// Guards the cache, which is shared by concurrent GeometryEvaluators
+	mutable boost::mutex mutex;
+};
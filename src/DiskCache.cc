@@ -0,0 +1,546 @@
+#include "DiskCache.h"
+#include "printutils.h"
+#include "polyset.h"
+#include "IndexedMesh.h"
+#include "Polygon2d.h"
+#ifdef ENABLE_CGAL
+#include "CGAL_Nef_polyhedron.h"
+#include "cgalutils.h"
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/locks.hpp>
+#include "boosty.h"
+
+#ifdef __WIN32__
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+using boost::int8_t;
+using boost::uint8_t;
+using boost::uint32_t;
+using boost::int32_t;
+using boost::uint64_t;
+
+DiskCache *DiskCache::inst = NULL;
+
+namespace {
+	const char magic[4] = {'O', 'S', 'G', 'C'};
+	// Bump if the file format changes. Files with a different version are treated as misses.
+	const uint32_t format_version = 2;
+	const char *suffix = ".geom";
+	const char *tmpsuffix = ".tmp";
+	// Temporary files older than this (in seconds) are left over from a crashed process
+	const std::time_t stale_tmp_age = 60 * 60;
+
+	enum GeometryType { NO_GEOMETRY = 0, POLYSET = 1, POLYGON2D = 2, NEF_POLYHEDRON = 3 };
+
+	// FNV-1a, used for file names
+	uint64_t hash_fnv1a(const std::string &str)
+	{
+		uint64_t h = 14695981039346656037ULL;
+		for (size_t i=0;i<str.size();i++) {
+			h ^= (unsigned char)str[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	// sdbm, stored in the file to detect file name collisions without storing the whole key
+	uint64_t hash_sdbm(const std::string &str)
+	{
+		uint64_t h = 0;
+		for (size_t i=0;i<str.size();i++) {
+			h = (unsigned char)str[i] + (h << 6) + (h << 16) - h;
+		}
+		return h;
+	}
+
+	template <typename T> void write(std::ostream &out, const T &val)
+	{
+		out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+	}
+
+	template <typename T> bool read(std::istream &in, T &val)
+	{
+		in.read(reinterpret_cast<char *>(&val), sizeof(T));
+		return in.good();
+	}
+
+	void writeVector(std::ostream &out, const double *data, size_t n)
+	{
+		out.write(reinterpret_cast<const char *>(data), n * sizeof(double));
+	}
+
+	bool readVector(std::istream &in, double *data, size_t n)
+	{
+		in.read(reinterpret_cast<char *>(data), n * sizeof(double));
+		return in.good();
+	}
+
+	/*!
+		Returns the number of bytes left in the stream. Counts read from a file
+		are checked against this before allocating anything, so a corrupt file
+		can't make us reserve huge amounts of memory.
+	*/
+	uint64_t remaining(std::istream &in)
+	{
+		std::streampos pos = in.tellg();
+		in.seekg(0, std::ios::end);
+		std::streampos end = in.tellg();
+		in.seekg(pos);
+		if (pos < 0 || end < pos) return 0;
+		return uint64_t(end - pos);
+	}
+
+	// PolySets are stored as an IndexedMesh, so shared vertices are only stored once
+	void writePolySet(std::ostream &out, const PolySet &ps)
+	{
+		IndexedMesh mesh(ps);
+		write<int8_t>(out, ps.convexValue() ? 1 : !ps.convexValue() ? 0 : -1);
+		write<uint32_t>(out, mesh.vertices.size());
+		write<uint32_t>(out, mesh.numFaces());
+		write<uint32_t>(out, mesh.indices.size());
+		BOOST_FOREACH(const Vector3d &v, mesh.vertices) writeVector(out, v.data(), 3);
+		for (size_t i=0;i<mesh.numFaces();i++) write<uint32_t>(out, mesh.faceSize(i));
+		BOOST_FOREACH(int idx, mesh.indices) write<uint32_t>(out, idx);
+	}
+
+	PolySet *readPolySet(std::istream &in)
+	{
+		int8_t convex;
+		uint32_t numvertices, numfaces, numindices;
+		if (!read(in, convex) || !read(in, numvertices) ||
+				!read(in, numfaces) || !read(in, numindices)) return NULL;
+		if (uint64_t(numvertices) * 3 * sizeof(double) +
+				(uint64_t(numfaces) + numindices) * sizeof(uint32_t) > remaining(in)) return NULL;
+
+		IndexedMesh mesh;
+		mesh.reserve(numvertices, numfaces, numindices);
+		for (uint32_t i=0;i<numvertices && in.good();i++) {
+			Vector3d v;
+			if (readVector(in, v.data(), 3)) mesh.addVertex(v);
+		}
+		size_t offset = 0;
+		for (uint32_t i=0;i<numfaces && in.good();i++) {
+			uint32_t facesize;
+			if (!read(in, facesize)) break;
+			offset += facesize;
+			mesh.faceoffsets.push_back(offset);
+		}
+		for (uint32_t i=0;i<numindices && in.good();i++) {
+			uint32_t idx;
+			if (read(in, idx)) mesh.addIndex(idx);
+		}
+		if (!in.good() || offset != numindices) return NULL;
+		BOOST_FOREACH(int idx, mesh.indices) if (size_t(idx) >= mesh.vertices.size()) return NULL;
+
+		PolySet *ps = new PolySet(3, convex < 0 ? boost::tribool(unknown) : boost::tribool(convex == 1));
+		mesh.toPolySet(*ps);
+		return ps;
+	}
+
+	void writePolygon2d(std::ostream &out, const Polygon2d &poly)
+	{
+		write<uint8_t>(out, poly.isSanitized());
+		write<uint32_t>(out, poly.outlines().size());
+		BOOST_FOREACH(const Outline2d &o, poly.outlines()) {
+			write<uint8_t>(out, o.positive);
+			write<uint32_t>(out, o.vertices.size());
+			BOOST_FOREACH(const Vector2d &v, o.vertices) writeVector(out, v.data(), 2);
+		}
+	}
+
+	Polygon2d *readPolygon2d(std::istream &in)
+	{
+		uint8_t sanitized;
+		uint32_t numoutlines;
+		if (!read(in, sanitized) || !read(in, numoutlines)) return NULL;
+		if (uint64_t(numoutlines) * (sizeof(uint8_t) + sizeof(uint32_t)) > remaining(in)) return NULL;
+		Polygon2d *poly = new Polygon2d;
+		poly->setSanitized(sanitized);
+		for (uint32_t i=0;i<numoutlines && in.good();i++) {
+			Outline2d o;
+			uint8_t positive;
+			uint32_t numverts;
+			if (!read(in, positive) || !read(in, numverts)) break;
+			if (uint64_t(numverts) * 2 * sizeof(double) > remaining(in)) {
+				in.setstate(std::ios::failbit);
+				break;
+			}
+			o.positive = positive;
+			o.vertices.resize(numverts);
+			BOOST_FOREACH(Vector2d &v, o.vertices) if (!readVector(in, v.data(), 2)) break;
+			poly->addOutline(o);
+		}
+		if (!in.good()) {
+			delete poly;
+			return NULL;
+		}
+		return poly;
+	}
+
+	/*!
+		Returns false if the geometry type cannot be stored.
+	*/
+	bool writeGeometry(std::ostream &out, const Geometry *geom)
+	{
+		if (!geom) {
+			write<uint8_t>(out, NO_GEOMETRY);
+			return true;
+		}
+		if (const PolySet *ps = dynamic_cast<const PolySet *>(geom)) {
+			// 2D PolySets carry render outlines which we don't store
+			if (ps->getDimension() != 3) return false;
+			write<uint8_t>(out, POLYSET);
+			write<int32_t>(out, ps->getConvexity());
+			writePolySet(out, *ps);
+			return true;
+		}
+		if (const Polygon2d *poly = dynamic_cast<const Polygon2d *>(geom)) {
+			write<uint8_t>(out, POLYGON2D);
+			write<int32_t>(out, poly->getConvexity());
+			writePolygon2d(out, *poly);
+			return true;
+		}
+#ifdef ENABLE_CGAL
+		if (const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron *>(geom)) {
+			write<uint8_t>(out, NEF_POLYHEDRON);
+			write<int32_t>(out, N->getConvexity());
+			write<uint8_t>(out, N->p3 ? 1 : 0);
+			if (N->p3) out << *N->p3;
+			return true;
+		}
+#endif
+		return false;
+	}
+
+	bool readGeometry(std::istream &in, shared_ptr<const Geometry> &geom)
+	{
+		uint8_t type;
+		int32_t convexity;
+		if (!read(in, type)) return false;
+		if (type == NO_GEOMETRY) {
+			geom.reset();
+			return true;
+		}
+		if (!read(in, convexity)) return false;
+		Geometry *g = NULL;
+		switch (type) {
+		case POLYSET:
+			g = readPolySet(in);
+			break;
+		case POLYGON2D:
+			g = readPolygon2d(in);
+			break;
+#ifdef ENABLE_CGAL
+		case NEF_POLYHEDRON: {
+			uint8_t hasp3;
+			if (!read(in, hasp3)) return false;
+			shared_ptr<CGAL_Nef_polyhedron3> p3;
+			if (hasp3) {
+				// Make CGAL report a corrupt file by throwing rather than aborting
+				CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
+				p3.reset(new CGAL_Nef_polyhedron3);
+				in >> *p3;
+				if (in.fail()) return false;
+			}
+			CGAL_Nef_polyhedron *N = new CGAL_Nef_polyhedron;
+			N->p3 = p3;
+			g = N;
+			break;
+		}
+#endif
+		default:
+			break;
+		}
+		if (!g) return false;
+		g->setConvexity(convexity);
+		geom.reset(g);
+		return true;
+	}
+
+	void removeFiles(const std::string &dir, const std::vector<std::string> &names)
+	{
+		BOOST_FOREACH(const std::string &name, names) {
+			try {
+				fs::remove(fs::path(dir) / name);
+			}
+			catch (const fs::filesystem_error &e) {
+				PRINTB("WARNING: Can't remove geometry cache file: %s", e.what());
+			}
+		}
+	}
+}
+
+/*!
+	Enables the cache, using the given directory which will be created if necessary.
+	Existing cache files are indexed, and the oldest ones are removed if they
+	exceed maxsize bytes. Stale temporary files left behind by a crashed
+	process are removed as well.
+*/
+bool DiskCache::setDirectory(const std::string &dirname, size_t maxsize)
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->dir.clear();
+	this->entries.clear();
+	this->lru.clear();
+	this->totalsize = 0;
+	this->maxsize = maxsize;
+
+	fs::path path(dirname);
+	try {
+		if (!fs::exists(path)) fs::create_directories(path);
+		if (!fs::is_directory(path)) {
+			PRINTB("WARNING: Geometry cache directory '%s' is not a directory", dirname);
+			return false;
+		}
+
+		std::vector<std::pair<std::time_t, fs::path> > files;
+		std::vector<std::string> staletmpfiles;
+		const std::time_t now = std::time(NULL);
+		for (fs::directory_iterator it(path); it != fs::directory_iterator(); ++it) {
+			if (!fs::is_regular_file(it->status())) continue;
+			const std::string ext = boosty::extension_str(it->path());
+			if (ext == suffix) {
+				files.push_back(std::make_pair(fs::last_write_time(it->path()), it->path()));
+			}
+			else if (ext == tmpsuffix && fs::last_write_time(it->path()) + stale_tmp_age < now) {
+				staletmpfiles.push_back(boosty::stringy(it->path().filename()));
+			}
+		}
+		removeFiles(dirname, staletmpfiles);
+		// Oldest first, so the most recent file ends up in front of the LRU list
+		std::sort(files.begin(), files.end());
+		for (size_t i=0;i<files.size();i++) {
+			std::string name = boosty::stringy(files[i].second.filename());
+			cache_entry &entry = this->entries[name];
+			entry.size = fs::file_size(files[i].second);
+			this->lru.push_front(name);
+			entry.lru = this->lru.begin();
+			this->totalsize += entry.size;
+		}
+	}
+	catch (const fs::filesystem_error &e) {
+		PRINTB("WARNING: Can't use geometry cache directory '%s': %s", dirname % e.what());
+		this->entries.clear();
+		this->lru.clear();
+		this->totalsize = 0;
+		return false;
+	}
+
+	this->dir = boosty::stringy(path);
+	std::vector<std::string> removed;
+	trim(this->maxsize, removed);
+	removeFiles(this->dir, removed);
+	PRINTDB("Disk cache: %d entries (%d bytes) in %s", this->entries.size() % this->totalsize % this->dir);
+	return true;
+}
+
+std::string DiskCache::filename(const std::string &key) const
+{
+	return str(boost::format("%016x%s") % hash_fnv1a(key) % suffix);
+}
+
+bool DiskCache::contains(const std::string &key) const
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	if (!isEnabled()) return false;
+	return this->entries.find(filename(key)) != this->entries.end();
+}
+
+/*!
+	Loads the geometry stored for the given key. geom can be set to an empty
+	pointer if the cached node didn't yield any geometry.
+	Returns false on a cache miss or if the cache file couldn't be read.
+
+	The lock is only held while looking up and updating the index, so
+	several threads can load files at the same time.
+*/
+bool DiskCache::get(const std::string &key, shared_ptr<const Geometry> &geom)
+{
+	const std::string name = filename(key);
+	fs::path path;
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		if (!isEnabled() || this->entries.find(name) == this->entries.end()) return false;
+		path = fs::path(this->dir) / name;
+	}
+
+	bool ok = false;
+	try {
+		std::ifstream in(path.string().c_str(), std::ios::in | std::ios::binary);
+		char filemagic[4];
+		uint32_t version;
+		uint64_t keylen, keyhash;
+		ok = in.is_open() &&
+			in.read(filemagic, 4) && std::equal(filemagic, filemagic + 4, magic) &&
+			read(in, version) && version == format_version &&
+			read(in, keylen) && keylen == key.size() &&
+			read(in, keyhash) && keyhash == hash_sdbm(key);
+		if (ok) {
+			ok = readGeometry(in, geom);
+			if (!ok) PRINTB("WARNING: Corrupt geometry cache file %s", boosty::stringy(path));
+		}
+	}
+	catch (const std::exception &e) {
+		PRINTB("WARNING: Corrupt geometry cache file %s: %s", boosty::stringy(path) % e.what());
+		ok = false;
+	}
+
+	std::vector<std::string> removed;
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		map_type::iterator it = this->entries.find(name);
+		if (it != this->entries.end()) {
+			// Stale or colliding entry; get rid of it so it can be overwritten
+			if (!ok) remove(it, removed);
+			else this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+		}
+	}
+	if (!ok) {
+		removeFiles(path.parent_path().string(), removed);
+		return false;
+	}
+	try {
+		// Keep recency across runs
+		fs::last_write_time(path, std::time(NULL));
+	}
+	catch (const fs::filesystem_error &e) {
+		// Not fatal, the entry will just be evicted earlier next time
+	}
+	PRINTDB("Disk cache hit: %s", key.substr(0, 40));
+	return true;
+}
+
+/*!
+	Writes the geometry to the cache, overwriting any existing entry.
+	Returns false if the cache is disabled, the geometry couldn't be serialized
+	or the file couldn't be written.
+*/
+bool DiskCache::insert(const std::string &key, const shared_ptr<const Geometry> &geom)
+{
+	// Serialize outside the lock, this can take a while for large Nef polyhedra
+	std::ostringstream out(std::ios::out | std::ios::binary);
+	out.write(magic, 4);
+	write<uint32_t>(out, format_version);
+	write<uint64_t>(out, key.size());
+	write<uint64_t>(out, hash_sdbm(key));
+	if (!writeGeometry(out, geom.get())) return false;
+	const std::string data = out.str();
+
+	const std::string name = filename(key);
+	std::string dirname;
+	unsigned int tmpid;
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		if (!isEnabled() || data.size() > this->maxsize) return false;
+		dirname = this->dir;
+		tmpid = this->tmpcounter++;
+	}
+
+	// Write to a temporary file first to never leave partial entries behind.
+	// Concurrent inserts, also from other processes sharing the directory,
+	// use different temporary files.
+	fs::path path = fs::path(dirname) / name;
+	fs::path tmppath = fs::path(dirname) / str(boost::format("%s.%d.%d%s") % name % getpid() % tmpid % tmpsuffix);
+	std::ofstream file(tmppath.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		PRINTB("WARNING: Can't write geometry cache file %s", boosty::stringy(tmppath));
+		return false;
+	}
+	file.write(data.data(), data.size());
+	file.close();
+	try {
+		if (file.fail()) {
+			PRINTB("WARNING: Can't write geometry cache file %s", boosty::stringy(tmppath));
+			fs::remove(tmppath);
+			return false;
+		}
+		fs::rename(tmppath, path);
+	}
+	catch (const fs::filesystem_error &e) {
+		PRINTB("WARNING: Can't write geometry cache file %s: %s", boosty::stringy(path) % e.what());
+		boost::system::error_code ec;
+		fs::remove(tmppath, ec);
+		return false;
+	}
+
+	std::vector<std::string> removed;
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		// The file of an existing entry has just been replaced, so only drop it from the index
+		map_type::iterator it = this->entries.find(name);
+		if (it != this->entries.end()) {
+			this->totalsize -= it->second.size;
+			this->lru.erase(it->second.lru);
+			this->entries.erase(it);
+		}
+		trim(this->maxsize - data.size(), removed);
+
+		cache_entry &entry = this->entries[name];
+		entry.size = data.size();
+		this->lru.push_front(name);
+		entry.lru = this->lru.begin();
+		this->totalsize += entry.size;
+	}
+	removeFiles(dirname, removed);
+	PRINTDB("Disk cache insert: %s (%d bytes)", key.substr(0, 40) % data.size());
+	return true;
+}
+
+void DiskCache::clear()
+{
+	std::vector<std::string> removed;
+	std::string dirname;
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		trim(0, removed);
+		dirname = this->dir;
+	}
+	removeFiles(dirname, removed);
+}
+
+void DiskCache::print()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	if (!isEnabled()) return;
+	PRINTB("Geometries in disk cache: %d", this->entries.size());
+	PRINTB("Geometry disk cache size in bytes: %d", this->totalsize);
+}
+
+/*!
+	Removes an entry from the index. The file name is added to removed, the
+	caller deletes the files once the lock is released.
+*/
+void DiskCache::remove(map_type::iterator it, std::vector<std::string> &removed)
+{
+	removed.push_back(it->first);
+	this->totalsize -= it->second.size;
+	this->lru.erase(it->second.lru);
+	this->entries.erase(it);
+}
+
+/*!
+	Removes least recently used entries until the total size is at most limit bytes.
+*/
+void DiskCache::trim(size_t limit, std::vector<std::string> &removed)
+{
+	while (this->totalsize > limit && !this->lru.empty()) {
+		map_type::iterator it = this->entries.find(this->lru.back());
+		assert(it != this->entries.end());
+		PRINTDB("Trimming disk cache: %s (%d bytes)", it->first % it->second.size);
+		remove(it, removed);
+	}
+}
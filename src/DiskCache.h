@@ -0,0 +1,67 @@
+#pragma once
+
+#include "memory.h"
+#include "Geometry.h"
+
+#include <string>
+#include <list>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+/*!
+	Persistent geometry cache tier.
+
+	Stores evaluated geometry in a directory on disk so that it survives between
+	OpenSCAD invocations. Entries are keyed by the node ID string (see
+	Tree::getIdString()) and stored as one file per entry, named by a hash of the key.
+	PolySets and Polygon2d objects are stored in a binary format, Nef polyhedra
+	in CGAL's exact Nef file format.
+
+	The total size of the cache directory is capped; least recently used entries
+	are removed first. File modification times are used as access times, so
+	recency survives between runs. Several processes can share a cache directory.
+
+	The cache is disabled until setDirectory() is called.
+*/
+class DiskCache
+{
+public:
+	static DiskCache *instance() { if (!inst) inst = new DiskCache; return inst; }
+
+	bool setDirectory(const std::string &dir, size_t maxsize = 1024*1024*1024);
+	bool isEnabled() const { return !this->dir.empty(); }
+
+	bool contains(const std::string &key) const;
+	bool get(const std::string &key, shared_ptr<const Geometry> &geom);
+	bool insert(const std::string &key, const shared_ptr<const Geometry> &geom);
+	size_t maxSize() const { return this->maxsize; }
+	void clear();
+	void print();
+
+private:
+	DiskCache() : maxsize(0), totalsize(0), tmpcounter(0) {}
+
+	static DiskCache *inst;
+
+	struct cache_entry {
+		size_t size;
+		std::list<std::string>::iterator lru;
+	};
+	typedef boost::unordered_map<std::string, cache_entry> map_type;
+
+	std::string filename(const std::string &key) const;
+	void remove(map_type::iterator it, std::vector<std::string> &removed);
+	void trim(size_t limit, std::vector<std::string> &removed);
+
+	std::string dir;
+	size_t maxsize;
+	size_t totalsize;
+	// Index of files in the cache directory, most recently used first
+	map_type entries;
+	std::list<std::string> lru;
+	// Together with the process ID, makes temporary file names unique between concurrent inserts
+	unsigned int tmpcounter;
+	// Guards the index only, files are read and written without holding it
+	mutable boost::mutex mutex;
+};
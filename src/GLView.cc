@@ -186,7 +186,10 @@ void GLView::paintGL()
     // FIXME: This belongs in the OpenCSG renderer, but it doesn't know about this ID yet
     OpenCSG::setContext(this->opencsg_id);
 #endif
+    this->vbocache.purge();
+    VBOCache::setCurrent(&this->vbocache);
     this->renderer->draw(showfaces, showedges);
+    VBOCache::setCurrent(NULL);
   }
 
   // Only for GIMBAL
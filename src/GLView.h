@@ -27,6 +27,7 @@ Some actions (showCrossHairs) only work properly on Gimbal Camera.
 #include <iostream>
 #include "Camera.h"
 #include "colormap.h"
+#include "VBOCache.h"
 
 class GLView
 {
@@ -63,6 +64,7 @@ public:
 	bool showedges;
 	bool showcrosshairs;
 	bool showscale;
+	VBOCache vbocache; // Vertex buffers of this view's GL context
 
 #ifdef ENABLE_OPENCSG
 	GLint shaderinfo[11];
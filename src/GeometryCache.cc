@@ -8,20 +8,40 @@
   #include "CGAL_Nef_polyhedron.h"
 #endif
 
+#include <boost/thread/locks.hpp>
+
 GeometryCache *GeometryCache::inst = NULL;
 
+bool GeometryCache::contains(const std::string &id) const
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	return this->cache.contains(id);
+}
+
+/*!
+	Returns an empty pointer if the entry doesn't exist, e.g. since it was
+	evicted by another thread after calling contains().
+*/
 shared_ptr<const Geometry> GeometryCache::get(const std::string &id) const
 {
-	const shared_ptr<const Geometry> &geom = this->cache[id]->geom;
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	const cache_entry *entry = this->cache[id];
+	if (!entry) return shared_ptr<const Geometry>();
+	const shared_ptr<const Geometry> &geom = entry->geom;
 #ifdef DEBUG
 	PRINTDB("Geometry Cache hit: %s (%d bytes)", id.substr(0, 40) % (geom ? geom->memsize() : 0));
 #endif
 	return geom;
 }
 
-bool GeometryCache::insert(const std::string &id, const shared_ptr<const Geometry> &geom)
+/*!
+	computetime is the time in seconds it took to create the object. Entries
+	which are expensive to recompute relative to their size are kept longer.
+*/
+bool GeometryCache::insert(const std::string &id, const shared_ptr<const Geometry> &geom, double computetime)
 {
-	bool inserted = this->cache.insert(id, new cache_entry(geom), geom ? geom->memsize() : 0);
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	bool inserted = this->cache.insert(id, new cache_entry(geom), geom ? geom->memsize() : 0, computetime);
 #ifdef DEBUG
 	assert(!dynamic_cast<const CGAL_Nef_polyhedron*>(geom.get()));
 	if (inserted) PRINTDB("Geometry Cache insert: %s (%d bytes)", 
@@ -34,20 +54,44 @@ bool GeometryCache::insert(const std::string &id, const shared_ptr<const Geometr
 
 size_t GeometryCache::maxSize() const
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	return this->cache.maxCost();
 }
 
 void GeometryCache::setMaxSize(size_t limit)
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	this->cache.setMaxCost(limit);
 }
 
+void GeometryCache::clear()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->cache.clear();
+}
+
 void GeometryCache::print()
 {
+	boost::lock_guard<boost::mutex> lock(this->mutex);
 	PRINTB("Geometries in cache: %d", this->cache.size());
 	PRINTB("Geometry cache size in bytes: %d", this->cache.totalCost());
 }
 
+/*!
+	Counts a lookup which found nothing, see Cache::recordMiss().
+*/
+void GeometryCache::recordMiss()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->cache.recordMiss();
+}
+
+void GeometryCache::printStats()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	PRINTB("Geometry cache: %d hits, %d misses, %d evictions", this->cache.hits() % this->cache.misses() % this->cache.evictions());
+}
+
 GeometryCache::cache_entry::cache_entry(const shared_ptr<const Geometry> &geom)
 	: geom(geom)
 {
@@ -4,6 +4,8 @@
 #include "memory.h"
 #include "Geometry.h"
 
+#include <boost/thread/mutex.hpp>
+
 class GeometryCache
 {
 public:	
@@ -11,13 +13,15 @@ public:
 
 	static GeometryCache *instance() { if (!inst) inst = new GeometryCache; return inst; }
 
-	bool contains(const std::string &id) const { return this->cache.contains(id); }
+	bool contains(const std::string &id) const;
 	shared_ptr<const class Geometry> get(const std::string &id) const;
-	bool insert(const std::string &id, const shared_ptr<const Geometry> &geom);
+	bool insert(const std::string &id, const shared_ptr<const Geometry> &geom, double computetime = 0);
 	size_t maxSize() const;
 	void setMaxSize(size_t limit);
-	void clear() { cache.clear(); }
+	void clear();
 	void print();
+	void recordMiss();
+	void printStats();
 
 private:
 	static GeometryCache *inst;
@@ -30,4 +34,6 @@ private:
 	};
 
 	Cache<std::string, cache_entry> cache;
+	// Guards the cache, which is shared by concurrent GeometryEvaluators
+	mutable boost::mutex mutex;
 };
@@ -3,6 +3,7 @@
 #include "Tree.h"
 #include "GeometryCache.h"
 #include "CGALCache.h"
+#include "DiskCache.h"
 #include "Polygon2d.h"
 #include "module.h"
 #include "state.h"
@@ -25,15 +26,20 @@
 #include "svg.h"
 #include "calc.h"
 #include "dxfdata.h"
+#include "grid.h"
+#include "parallel.h"
+#include "feature.h"
+#include "GeometryProfiler.h"
 
 #include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 #include <CGAL/convex_hull_2.h>
 #include <CGAL/Point_2.h>
 
 GeometryEvaluator::GeometryEvaluator(const class Tree &tree):
-	tree(tree)
+	tree(tree), isolated(false), rootparent(NULL)
 {
 }
 
@@ -43,15 +49,15 @@ GeometryEvaluator::GeometryEvaluator(const class Tree &tree):
 shared_ptr<const Geometry> GeometryEvaluator::evaluateGeometry(const AbstractNode &node, 
 																															 bool allownef)
 {
+	isSmartCached(node); // Pulls the geometry in from the disk cache if needed
 	if (!GeometryCache::instance()->contains(this->tree.getIdString(node))) {
-		shared_ptr<const CGAL_Nef_polyhedron> N;
-		if (CGALCache::instance()->contains(this->tree.getIdString(node))) {
-			N = CGALCache::instance()->get(this->tree.getIdString(node));
-		}
+		shared_ptr<const CGAL_Nef_polyhedron> N = getCachedNef(this->tree.getIdString(node));
 
 		// If not found in any caches, we need to evaluate the geometry
 		if (N) {
 			this->root = N;
+			GeometryProfiler::instance()->cacheHit(node);
+			GeometryProfiler::instance()->endNode(node, N);
 		}	
     else {
 			Traverser trav(*this, node, Traverser::PRE_AND_POSTFIX);
@@ -75,10 +81,13 @@ shared_ptr<const Geometry> GeometryEvaluator::evaluateGeometry(const AbstractNod
 		}
 		return this->root;
 	}
-	return GeometryCache::instance()->get(this->tree.getIdString(node));
+	shared_ptr<const Geometry> geom = GeometryCache::instance()->get(this->tree.getIdString(node));
+	GeometryProfiler::instance()->cacheHit(node);
+	GeometryProfiler::instance()->endNode(node, geom);
+	return geom;
 }
 
-GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren(const AbstractNode &node, OpenSCADOperator op)
+GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren(const AbstractNode &node, OpenSCADOperator op, const AbstractNode *parent)
 {
 	unsigned int dim = 0;
 	BOOST_FOREACH(const Geometry::ChildItem &item, this->visitedchildren[node.index()]) {
@@ -95,16 +104,166 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren(const Abstrac
         assert(p2d);
         return ResultObject(p2d);
     }
-    else if (dim == 3) return applyToChildren3D(node, op);
+    else if (dim == 3) return applyToChildren3D(node, op, parent);
 	return ResultObject();
 }
 
+static BoundingBox childBoundingBox(const Geometry &geom)
+{
+	if (const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron *>(&geom)) {
+		CGAL_Iso_cuboid_3 bb = CGALUtils::boundingBox(*N->p3);
+		return BoundingBox(Vector3d(CGAL::to_double(bb.xmin()), CGAL::to_double(bb.ymin()), CGAL::to_double(bb.zmin())),
+											 Vector3d(CGAL::to_double(bb.xmax()), CGAL::to_double(bb.ymax()), CGAL::to_double(bb.zmax())));
+	}
+	return geom.getBoundingBox();
+}
+
+static bool bboxesOverlap(const BoundingBox &a, const BoundingBox &b)
+{
+	for (int i=0;i<3;i++) {
+		if (a.max()[i] < b.min()[i] || b.max()[i] < a.min()[i]) return false;
+	}
+	return true;
+}
+
+static size_t findGroup(std::vector<size_t> &parent, size_t i)
+{
+	while (parent[i] != i) i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+static bool compareMinX(const std::pair<BoundingBox, size_t> &a, const std::pair<BoundingBox, size_t> &b)
+{
+	return a.first.min()[0] < b.first.min()[0];
+}
+
+/*!
+	Partitions the non-empty children into groups of transitively overlapping
+	bounding boxes. Boxes closer than the vertex grid used for Nef conversion
+	count as overlapping, since such objects may end up touching and need to be
+	merged by a real union.
+*/
+static std::vector<Geometry::ChildList> groupOverlappingChildren(const Geometry::ChildList &children)
+{
+	std::vector<Geometry::ChildItem> items;
+	std::vector<std::pair<BoundingBox, size_t> > boxes;
+	BOOST_FOREACH(const Geometry::ChildItem &item, children) {
+		if (item.second->isEmpty()) continue;
+		BoundingBox bbox = childBoundingBox(*item.second);
+		bbox.extend(bbox.min() - Vector3d(GRID_FINE, GRID_FINE, GRID_FINE));
+		bbox.extend(bbox.max() + Vector3d(GRID_FINE, GRID_FINE, GRID_FINE));
+		boxes.push_back(std::make_pair(bbox, items.size()));
+		items.push_back(item);
+	}
+
+	// Sweep along x, so only boxes overlapping in x are compared
+	std::sort(boxes.begin(), boxes.end(), compareMinX);
+	std::vector<size_t> parent(items.size());
+	for (size_t i=0;i<parent.size();i++) parent[i] = i;
+	for (size_t i=0;i<boxes.size();i++) {
+		for (size_t j=i+1;j<boxes.size() && boxes[j].first.min()[0] <= boxes[i].first.max()[0];j++) {
+			if (bboxesOverlap(boxes[i].first, boxes[j].first)) {
+				parent[findGroup(parent, boxes[i].second)] = findGroup(parent, boxes[j].second);
+			}
+		}
+	}
+
+	std::vector<Geometry::ChildList> groups;
+	std::vector<size_t> groupindex(items.size(), items.size());
+	for (size_t i=0;i<items.size();i++) {
+		size_t root = findGroup(parent, i);
+		if (groupindex[root] == items.size()) {
+			groupindex[root] = groups.size();
+			groups.push_back(Geometry::ChildList());
+		}
+		groups[groupindex[root]].push_back(items[i]);
+	}
+	return groups;
+}
+
+/*!
+	Applies op to all children, using mesh corefinement if enabled. Falls back to
+	Nef polyhedra if corefinement isn't possible, e.g. for objects which aren't closed.
+
+	May return NULL.
+*/
+static Geometry *applyOperator3D(const Geometry::ChildList &children, OpenSCADOperator op)
+{
+	if (Feature::ExperimentalCorefinement.is_enabled()) {
+		if (PolySet *ps = CGALUtils::applyOperatorCorefine(children, op)) return ps;
+	}
+	return CGALUtils::applyOperator(children, op);
+}
+
+/*!
+	Returns true if node combines its children using CGAL operations, which will
+	convert our result to a Nef polyhedron anyway.
+*/
+static bool isNefOperation(const AbstractNode *node)
+{
+	if (!node) return false;
+	if (const CsgNode *csgnode = dynamic_cast<const CsgNode *>(node)) return csgnode->type != OPENSCAD_UNION;
+	if (dynamic_cast<const AbstractIntersectionNode *>(node)) return true;
+	if (const CgaladvNode *advnode = dynamic_cast<const CgaladvNode *>(node)) return advnode->type == MINKOWSKI;
+	return false;
+}
+
+/*!
+	Unions children by grouping them by overlapping bounding boxes. Groups are
+	disjoint, so only groups with more than one object need an actual union;
+	the results are concatenated into one PolySet.
+
+	Only used if all children are closed manifold PolySets. Anything else
+	needs the cleanup done by converting to a Nef polyhedron, and Nef children
+	would lose their exactness by being converted back to a PolySet.
+
+	Returns NULL if the fast path doesn't apply or everything overlaps, in
+	which case there is nothing to gain.
+*/
+static PolySet *applyDisjointUnion3D(const Geometry::ChildList &children)
+{
+	BOOST_FOREACH(const Geometry::ChildItem &item, children) {
+		if (item.second->isEmpty()) continue;
+		const PolySet *ps = dynamic_cast<const PolySet *>(item.second.get());
+		if (!ps || !PolysetUtils::is_closed_manifold(*ps)) return NULL;
+	}
+
+	std::vector<Geometry::ChildList> groups = groupOverlappingChildren(children);
+	if (groups.size() < 2) return NULL;
+
+	PolySet *ps = new PolySet(3);
+	unsigned int convexity = 1;
+	BOOST_FOREACH(const Geometry::ChildList &group, groups) {
+		shared_ptr<const Geometry> geom = group.front().second;
+		if (group.size() > 1) geom.reset(applyOperator3D(group, OPENSCAD_UNION));
+		if (!geom) continue;
+		convexity = std::max(convexity, geom->getConvexity());
+
+		if (const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron *>(geom.get())) {
+			if (N->isEmpty()) continue;
+			PolySet nps(3);
+			if (CGALUtils::createPolySetFromNefPolyhedron3(*N->p3, nps)) {
+				PRINT("ERROR: Nef->PolySet failed");
+			}
+			ps->append(nps);
+		}
+		else if (const PolySet *chps = dynamic_cast<const PolySet *>(geom.get())) {
+			ps->append(*chps);
+		}
+	}
+	ps->setConvexity(convexity);
+	return ps;
+}
+
 /*!
 	Applies the operator to all child nodes of the given node.
 	
 	May return NULL or any 3D Geometry object (can be either PolySet or CGAL_Nef_polyhedron)
+
+	parent is the node our result is passed on to, NULL for the root of the
+	traversal. Unions are kept as Nef polyhedra if the parent is a CGAL operation.
 */
-GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const AbstractNode &node, OpenSCADOperator op)
+GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const AbstractNode &node, OpenSCADOperator op, const AbstractNode *parent)
 {
 	Geometry::ChildList children = collectChildren3D(node);
 	if (children.size() == 0) return ResultObject();
@@ -130,13 +289,17 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
 		}
 		if (actualchildren.empty()) return ResultObject();
 		if (actualchildren.size() == 1) return ResultObject(actualchildren.front().second);
-		return ResultObject(CGALUtils::applyMinkowski(actualchildren));
+		return ResultObject(CGALUtils::applyMinkowski(actualchildren, &this->tree));
+	}
+
+	if (op == OPENSCAD_UNION && !isNefOperation(parent ? parent : this->rootparent)) {
+		if (PolySet *ps = applyDisjointUnion3D(children)) return ResultObject(ps);
 	}
 
-	CGAL_Nef_polyhedron *N = CGALUtils::applyOperator(children, op);
+	Geometry *geom = applyOperator3D(children, op);
 	// FIXME: Clarify when we can return NULL and what that means
-	if (!N) N = new CGAL_Nef_polyhedron;
-	return ResultObject(N);
+	if (!geom) geom = new CGAL_Nef_polyhedron;
+	return ResultObject(geom);
 }
 
 
@@ -240,24 +403,105 @@ void GeometryEvaluator::smartCacheInsert(const AbstractNode &node,
 {
 	const std::string &key = this->tree.getIdString(node);
 
+	// What it would cost to recompute the node, see addToParent()
+	double computetime = 0;
+	std::map<int, double>::iterator it = this->computetimes.find(node.index());
+	if (it != this->computetimes.end()) {
+		computetime = it->second;
+		this->computetimes.erase(it);
+	}
+
 	shared_ptr<const CGAL_Nef_polyhedron> N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom);
 	if (N) {
-		if (!CGALCache::instance()->contains(key)) CGALCache::instance()->insert(key, N);
+		insertCachedNef(key, N, computetime);
 	}
 	else {
 		if (!GeometryCache::instance()->contains(key)) {
-			if (!GeometryCache::instance()->insert(key, geom)) {
+			if (!GeometryCache::instance()->insert(key, geom, computetime)) {
 				PRINT("WARNING: GeometryEvaluator: Node didn't fit into cache");
 			}
 		}
 	}
+
+	DiskCache *diskcache = DiskCache::instance();
+	if (diskcache->isEnabled() && !diskcache->contains(key)) diskcache->insert(key, geom);
 }
 
-bool GeometryEvaluator::isSmartCached(const AbstractNode &node)
+/*!
+	Nef polyhedra share their exact coordinates through reference counts which
+	aren't thread safe. An isolated evaluator therefore keeps the Nef polyhedra
+	it creates to itself and only takes detached copies of the ones found in
+	CGALCache. evaluateChildrenInParallel() moves its Nef polyhedra to the
+	parent evaluator once all threads are done.
+*/
+shared_ptr<const CGAL_Nef_polyhedron> GeometryEvaluator::getCachedNef(const std::string &key)
+{
+	if (this->isolated) {
+		NefMap::const_iterator it = this->localnefs.find(key);
+		if (it != this->localnefs.end()) return it->second.first;
+	}
+	shared_ptr<const CGAL_Nef_polyhedron> N;
+	if (CGALCache::instance()->contains(key)) N = CGALCache::instance()->get(key);
+	if (N && this->isolated) {
+		N.reset(CGALUtils::detachedCopy(*N));
+		this->localnefs[key] = std::make_pair(N, 0.0);
+	}
+	return N;
+}
+
+bool GeometryEvaluator::hasCachedNef(const std::string &key) const
+{
+	return (this->isolated && this->localnefs.count(key)) || CGALCache::instance()->contains(key);
+}
+
+bool GeometryEvaluator::insertCachedNef(const std::string &key, const shared_ptr<const CGAL_Nef_polyhedron> &N,
+																				double computetime)
+{
+	if (this->isolated) {
+		if (!this->localnefs.count(key)) this->localnefs[key] = std::make_pair(N, computetime);
+		return true;
+	}
+	if (CGALCache::instance()->contains(key)) return true;
+	return CGALCache::instance()->insert(key, N, computetime);
+}
+
+/*!
+	Checks the in-memory caches first. On a miss, the geometry is looked up in
+	the disk cache (if enabled) and moved into the appropriate in-memory cache.
+*/
+bool GeometryEvaluator::isCached(const AbstractNode &node)
 {
 	const std::string &key = this->tree.getIdString(node);
-	return (GeometryCache::instance()->contains(key) ||
-					CGALCache::instance()->contains(key));
+	if (GeometryCache::instance()->contains(key) || hasCachedNef(key)) return true;
+
+	shared_ptr<const Geometry> geom;
+	if (!DiskCache::instance()->isEnabled() ||
+			!DiskCache::instance()->get(key, geom)) return false;
+	if (shared_ptr<const CGAL_Nef_polyhedron> N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
+		return insertCachedNef(key, N);
+	}
+	return GeometryCache::instance()->insert(key, geom);
+}
+
+/*!
+	Like isCached(), but also marks the start of the node's evaluation. Only
+	call this for nodes which will reach addToParent(), which marks the end.
+	On a miss, the time is recorded so addToParent() knows how long the node
+	took to evaluate.
+
+	This is called several times per node, so misses are counted by
+	addToParent() once the node has been evaluated. Hits are counted when the
+	geometry is fetched from the cache.
+*/
+bool GeometryEvaluator::isSmartCached(const AbstractNode &node)
+{
+	GeometryProfiler::instance()->beginNode(node);
+	if (isCached(node)) return true;
+
+	// The last miss is right before the node itself is evaluated, i.e. after
+	// its children, so the recorded time doesn't include theirs
+	this->starttimes[node.index()] = boost::posix_time::microsec_clock::universal_time();
+	return false;
 }
 
 shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode &node, bool preferNef)
@@ -265,12 +509,80 @@ shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode &
 	const std::string &key = this->tree.getIdString(node);
 	shared_ptr<const Geometry> geom;
 	bool hasgeom = GeometryCache::instance()->contains(key);
-	bool hascgal = CGALCache::instance()->contains(key);
-	if (hascgal && (preferNef || !hasgeom)) geom = CGALCache::instance()->get(key);
+	bool hascgal = hasCachedNef(key);
+	if (hascgal && (preferNef || !hasgeom)) geom = getCachedNef(key);
 	else if (hasgeom) geom = GeometryCache::instance()->get(key);
+	if (geom) GeometryProfiler::instance()->cacheHit(node);
 	return geom;
 }
 
+/*!
+	If more than one thread is available (see Parallel::setMaxThreads()) and at
+	least two children of the given node need to be evaluated, the child subtrees
+	are evaluated concurrently, each by its own GeometryEvaluator. The results
+	are added to visitedchildren in child order, so the parent sees exactly what
+	a serial traversal would have produced.
+
+	Returns true if the children were evaluated. The caller should then prune
+	the traversal; its postfix visit will pick up the children as usual.
+*/
+bool GeometryEvaluator::evaluateChildrenInParallel(const State &state, const AbstractNode &node)
+{
+	if (Parallel::maxThreads() <= 1) return false;
+
+	const std::vector<AbstractNode *> &children = node.getChildren();
+	std::vector<size_t> pending;
+	for (size_t i=0;i<children.size();i++) {
+		if (!isCached(*children[i])) pending.push_back(i);
+	}
+	if (pending.size() < 2) return false;
+
+	// The pending children are profiled by the evaluators in evaluateChild()
+	std::vector<shared_ptr<const Geometry> > results(children.size());
+	for (size_t i=0;i<children.size();i++) {
+		if (isSmartCached(*children[i])) {
+			results[i] = smartCacheGet(*children[i], state.preferNef());
+			GeometryProfiler::instance()->endNode(*children[i], results[i]);
+		}
+	}
+	std::vector<NefMap> nefs(pending.size());
+	{
+		// Set once for all threads
+		CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
+		Parallel::for_each_index(pending.size(),
+														 boost::bind(&GeometryEvaluator::evaluateChild, this, boost::cref(children),
+																				 boost::cref(pending), boost::ref(results), boost::ref(nefs), &node, _1));
+	}
+	BOOST_FOREACH(const NefMap &map, nefs) {
+		BOOST_FOREACH(const NefMap::value_type &item, map) {
+			insertCachedNef(item.first, item.second.first, item.second.second);
+		}
+	}
+
+	Geometry::ChildList &visited = this->visitedchildren[node.index()];
+	for (size_t i=0;i<children.size();i++) {
+		visited.push_back(std::make_pair((const AbstractNode *)children[i], results[i]));
+	}
+	return true;
+}
+
+/*!
+	Worker for evaluateChildrenInParallel(): Evaluates the i'th pending child.
+	May be called from any thread. The Nef polyhedra created on the way are
+	returned in nefs rather than put into CGALCache.
+*/
+void GeometryEvaluator::evaluateChild(const std::vector<AbstractNode *> &children,
+																			const std::vector<size_t> &pending,
+																			std::vector<shared_ptr<const Geometry> > &results,
+																			std::vector<NefMap> &nefs, const AbstractNode *parent, size_t i)
+{
+	GeometryEvaluator evaluator(this->tree);
+	evaluator.isolated = true;
+	evaluator.rootparent = parent;
+	results[pending[i]] = evaluator.evaluateGeometry(*children[pending[i]], true);
+	nefs[i].swap(evaluator.localnefs);
+}
+
 /*!
 	Returns a list of 3D Geometry children of the given node.
 	May return empty geometries, but not NULL objects
@@ -357,6 +669,15 @@ void GeometryEvaluator::addToParent(const State &state,
 																		const AbstractNode &node, 
 																		const shared_ptr<const Geometry> &geom)
 {
+	GeometryProfiler::instance()->endNode(node, geom);
+	std::map<int, boost::posix_time::ptime>::iterator it = this->starttimes.find(node.index());
+	if (it != this->starttimes.end()) {
+		// The node wasn't cached and has been evaluated
+		this->computetimes[node.index()] = (boost::posix_time::microsec_clock::universal_time() - it->second).total_microseconds() / 1e6;
+		this->starttimes.erase(it);
+		if (dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) CGALCache::instance()->recordMiss();
+		else GeometryCache::instance()->recordMiss();
+	}
 	this->visitedchildren.erase(node.index());
 	if (state.parent()) {
 		this->visitedchildren[state.parent()->index()].push_back(std::make_pair(&node, geom));
@@ -377,11 +698,12 @@ Response GeometryEvaluator::visit(State &state, const AbstractNode &node)
 	if (state.isPrefix()) {
 		if (isSmartCached(node)) return PruneTraversal;
 		state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
 	}
 	if (state.isPostfix()) {
 		shared_ptr<const class Geometry> geom;
 		if (!isSmartCached(node)) {
-			geom = applyToChildren(node, OPENSCAD_UNION).constptr();
+			geom = applyToChildren(node, OPENSCAD_UNION, state.parent()).constptr();
 		}
 		else {
 			geom = smartCacheGet(node, state.preferNef());
@@ -426,11 +748,12 @@ Response GeometryEvaluator::visit(State &state, const RenderNode &node)
 	if (state.isPrefix()) {
 		if (isSmartCached(node)) return PruneTraversal;
 		state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
 	}
 	if (state.isPostfix()) {
 		shared_ptr<const class Geometry> geom;
 		if (!isSmartCached(node)) {
-			ResultObject res = applyToChildren(node, OPENSCAD_UNION);
+			ResultObject res = applyToChildren(node, OPENSCAD_UNION, state.parent());
 
 			geom = res.constptr();
 			if (shared_ptr<const PolySet> ps = dynamic_pointer_cast<const PolySet>(geom)) {
@@ -518,11 +841,12 @@ Response GeometryEvaluator::visit(State &state, const CsgNode &node)
 	if (state.isPrefix()) {
 		if (isSmartCached(node)) return PruneTraversal;
 		state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
 	}
 	if (state.isPostfix()) {
 		shared_ptr<const Geometry> geom;
 		if (!isSmartCached(node)) {
-			geom = applyToChildren(node, node.type).constptr();
+			geom = applyToChildren(node, node.type, state.parent()).constptr();
 		}
 		else {
 			geom = smartCacheGet(node, state.preferNef());
@@ -541,7 +865,10 @@ Response GeometryEvaluator::visit(State &state, const CsgNode &node)
  */			
 Response GeometryEvaluator::visit(State &state, const TransformNode &node)
 {
-	if (state.isPrefix() && isSmartCached(node)) return PruneTraversal;
+	if (state.isPrefix()) {
+		if (isSmartCached(node)) return PruneTraversal;
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
+	}
 	if (state.isPostfix()) {
 		shared_ptr<const class Geometry> geom;
 		if (!isSmartCached(node)) {
@@ -551,7 +878,7 @@ Response GeometryEvaluator::visit(State &state, const TransformNode &node)
 			}
 			else {
 				// First union all children
-				ResultObject res = applyToChildren(node, OPENSCAD_UNION);
+				ResultObject res = applyToChildren(node, OPENSCAD_UNION, state.parent());
 				if ((geom = res.constptr())) {
 					if (geom->getDimension() == 2) {
 						shared_ptr<const Polygon2d> polygons = dynamic_pointer_cast<const Polygon2d>(geom);
@@ -994,7 +1321,10 @@ Response GeometryEvaluator::visit(State &state, const ProjectionNode &node)
  */			
 Response GeometryEvaluator::visit(State &state, const CgaladvNode &node)
 {
-	if (state.isPrefix() && isSmartCached(node)) return PruneTraversal;
+	if (state.isPrefix()) {
+		if (isSmartCached(node)) return PruneTraversal;
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
+	}
 	if (state.isPostfix()) {
 		shared_ptr<const Geometry> geom;
 		if (!isSmartCached(node)) {
@@ -1018,7 +1348,7 @@ Response GeometryEvaluator::visit(State &state, const CgaladvNode &node)
 				break;
 			}
 			case RESIZE: {
-				ResultObject res = applyToChildren(node, OPENSCAD_UNION);
+				ResultObject res = applyToChildren(node, OPENSCAD_UNION, state.parent());
 				geom = res.constptr();
 				if (geom) {
 					shared_ptr<Geometry> editablegeom;
@@ -1067,6 +1397,7 @@ Response GeometryEvaluator::visit(State &state, const AbstractIntersectionNode &
 	if (state.isPrefix()) {
 		if (isSmartCached(node)) return PruneTraversal;
 		state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+		if (evaluateChildrenInParallel(state, node)) return PruneTraversal;
 	}
 	if (state.isPostfix()) {
 		shared_ptr<const class Geometry> geom;
@@ -9,6 +9,8 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <string>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 class GeometryEvaluator : public Visitor
 {
@@ -53,9 +55,19 @@ private:
 		shared_ptr<const Geometry> const_pointer;
 	};
 
+	typedef std::map<std::string, std::pair<shared_ptr<const class CGAL_Nef_polyhedron>, double> > NefMap;
+
+	shared_ptr<const class CGAL_Nef_polyhedron> getCachedNef(const std::string &key);
+	bool hasCachedNef(const std::string &key) const;
+	bool insertCachedNef(const std::string &key, const shared_ptr<const class CGAL_Nef_polyhedron> &N, double computetime = 0);
 	void smartCacheInsert(const AbstractNode &node, const shared_ptr<const Geometry> &geom);
 	shared_ptr<const Geometry> smartCacheGet(const AbstractNode &node, bool preferNef);
+	bool isCached(const AbstractNode &node);
 	bool isSmartCached(const AbstractNode &node);
+	bool evaluateChildrenInParallel(const State &state, const AbstractNode &node);
+	void evaluateChild(const std::vector<AbstractNode *> &children, const std::vector<size_t> &pending,
+										 std::vector<shared_ptr<const Geometry> > &results, std::vector<NefMap> &nefs,
+										 const AbstractNode *parent, size_t i);
 	std::vector<const class Polygon2d *> collectChildren2D(const AbstractNode &node);
 	Geometry::ChildList collectChildren3D(const AbstractNode &node);
 	Polygon2d *applyMinkowski2D(const AbstractNode &node);
@@ -63,13 +75,23 @@ private:
 	Geometry *applyHull3D(const AbstractNode &node);
 	void applyResize3D(class CGAL_Nef_polyhedron &N, const Vector3d &newsize, const Eigen::Matrix<bool,3,1> &autosize);
 	Polygon2d *applyToChildren2D(const AbstractNode &node, OpenSCADOperator op);
-	ResultObject applyToChildren3D(const AbstractNode &node, OpenSCADOperator op);
-	ResultObject applyToChildren(const AbstractNode &node, OpenSCADOperator op);
+	ResultObject applyToChildren3D(const AbstractNode &node, OpenSCADOperator op, const AbstractNode *parent = NULL);
+	ResultObject applyToChildren(const AbstractNode &node, OpenSCADOperator op, const AbstractNode *parent = NULL);
 	void addToParent(const State &state, const AbstractNode &node, const shared_ptr<const Geometry> &geom);
 
 	std::map<int, Geometry::ChildList> visitedchildren;
+	// Time of the last cache miss per node index, i.e. when evaluation started
+	std::map<int, boost::posix_time::ptime> starttimes;
+	// Time it took to evaluate each node, excluding its children. Used to weigh cache entries
+	std::map<int, double> computetimes;
 	const Tree &tree;
 	shared_ptr<const Geometry> root;
+	// Set for evaluators running on worker threads, see evaluateChild()
+	bool isolated;
+	// Nef polyhedra cached by an isolated evaluator
+	NefMap localnefs;
+	// Parent of the node evaluated by an isolated evaluator
+	const AbstractNode *rootparent;
 
 public:
 };
@@ -0,0 +1,232 @@
+#include "GeometryProfiler.h"
+#include "node.h"
+#include "module.h"
+#include "polyset.h"
+#include "Polygon2d.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "printutils.h"
+
+#include <fstream>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+
+// Created during static initialization, before any worker threads exist
+GeometryProfiler *GeometryProfiler::inst = new GeometryProfiler;
+
+namespace {
+	boost::posix_time::ptime now()
+	{
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	double seconds(const boost::posix_time::time_duration &d)
+	{
+		return d.total_microseconds() / 1e6;
+	}
+
+	std::string json_escape(const std::string &str)
+	{
+		std::string result;
+		BOOST_FOREACH(char c, str) {
+			switch (c) {
+			case '"': result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) result += ' ';
+				else result += c;
+			}
+		}
+		return result;
+	}
+
+	/*!
+		The name used for the node in the collapsed stacks, i.e. the name of the
+		module instantiation which created it. Semicolons and spaces separate
+		frames and counts, so they're replaced.
+	*/
+	std::string frame_name(const AbstractNode &node)
+	{
+		std::string name = (node.modinst && !node.modinst->name().empty()) ? node.modinst->name() : node.name();
+		std::replace(name.begin(), name.end(), ';', '_');
+		std::replace(name.begin(), name.end(), ' ', '_');
+		return name;
+	}
+}
+
+/*!
+	Marks the start of the evaluation of a node. Only the first call per node
+	has any effect, so it's safe to call this whenever a node is looked at.
+*/
+void GeometryProfiler::beginNode(const AbstractNode &node)
+{
+	if (!this->enabled) return;
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	node_map::iterator it = this->nodes.find(node.index());
+	if (it == this->nodes.end()) this->nodes[node.index()].start = now();
+}
+
+void GeometryProfiler::endNode(const AbstractNode &node, const shared_ptr<const Geometry> &geom)
+{
+	if (!this->enabled) return;
+	boost::posix_time::ptime end = now();
+
+	std::string type;
+	size_t vertices = 0, facets = 0, memsize = 0;
+	if (geom) {
+		memsize = geom->memsize();
+		if (const PolySet *ps = dynamic_cast<const PolySet *>(geom.get())) {
+			type = "PolySet";
+			facets = ps->polygons.size();
+			BOOST_FOREACH(const Polygon &p, ps->polygons) vertices += p.size();
+		}
+		else if (const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron *>(geom.get())) {
+			type = "Nef";
+			if (N->p3) {
+				vertices = N->p3->number_of_vertices();
+				facets = N->p3->number_of_facets();
+			}
+		}
+		else if (const Polygon2d *poly = dynamic_cast<const Polygon2d *>(geom.get())) {
+			type = "Polygon2d";
+			facets = poly->outlines().size();
+			BOOST_FOREACH(const Outline2d &o, poly->outlines()) vertices += o.vertices.size();
+		}
+	}
+
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	node_profile &profile = this->nodes[node.index()];
+	if (profile.finished) return;
+	if (profile.start.is_not_a_date_time()) profile.start = end;
+	profile.time = seconds(end - profile.start);
+	profile.finished = true;
+	profile.type = type;
+	profile.vertices = vertices;
+	profile.facets = facets;
+	profile.memsize = memsize;
+}
+
+/*!
+	Marks the result of the node as coming from a cache, unless the node was
+	already evaluated during this run.
+*/
+void GeometryProfiler::cacheHit(const AbstractNode &node)
+{
+	if (!this->enabled) return;
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	node_profile &profile = this->nodes[node.index()];
+	if (!profile.finished) profile.cachehit = true;
+}
+
+void GeometryProfiler::addOperationTime(const char *operation, double seconds)
+{
+	if (!this->enabled) return;
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	operation_profile &profile = this->operations[operation];
+	profile.calls++;
+	profile.time += seconds;
+}
+
+void GeometryProfiler::clear()
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+	this->nodes.clear();
+	this->operations.clear();
+}
+
+/*!
+	Writes the node and its profiled children as a JSON object, and adds the
+	self time of the node to its path in stacks. Returns the time of the node.
+	Nodes which weren't visited (e.g. since a parent was cached) are skipped.
+*/
+double GeometryProfiler::writeNode(std::ostream &json, std::map<std::string, double> &stacks,
+																	 const AbstractNode &node, const std::string &path, int indent) const
+{
+	node_map::const_iterator it = this->nodes.find(node.index());
+	if (it == this->nodes.end()) return -1;
+	const node_profile &profile = it->second;
+	const std::string pad(indent, ' ');
+
+	json << pad << "{\n"
+			 << pad << "  \"index\": " << node.index() << ",\n"
+			 << pad << "  \"name\": \"" << json_escape(node.name()) << "\",\n"
+			 << pad << "  \"module\": \"" << json_escape(node.modinst ? node.modinst->name() : "") << "\",\n"
+			 << pad << "  \"time\": " << profile.time << ",\n"
+			 << pad << "  \"cache\": \"" << (profile.cachehit ? "hit" : "miss") << "\",\n"
+			 << pad << "  \"type\": \"" << profile.type << "\",\n"
+			 << pad << "  \"vertices\": " << profile.vertices << ",\n"
+			 << pad << "  \"facets\": " << profile.facets << ",\n"
+			 << pad << "  \"memsize\": " << profile.memsize << ",\n"
+			 << pad << "  \"children\": [";
+
+	// Children evaluated in parallel may add up to more than the parent's time
+	double childtime = 0;
+	bool first = true;
+	BOOST_FOREACH(const AbstractNode *child, node.getChildren()) {
+		if (!this->nodes.count(child->index())) continue;
+		json << (first ? "\n" : ",\n");
+		first = false;
+		childtime += writeNode(json, stacks, *child, path + ";" + frame_name(*child), indent + 4);
+	}
+	if (!first) json << "\n" << pad << "  ";
+	json << "],\n"
+			 << pad << "  \"self_time\": " << std::max(0.0, profile.time - childtime) << "\n"
+			 << pad << "}";
+
+	stacks[path] += std::max(0.0, profile.time - childtime);
+	return profile.time;
+}
+
+/*!
+	Writes the JSON report to filename and the collapsed stacks to
+	stackfilename. Returns false if any of the files couldn't be written.
+*/
+bool GeometryProfiler::write(const AbstractNode &root, const std::string &filename, const std::string &stackfilename)
+{
+	boost::lock_guard<boost::mutex> lock(this->mutex);
+
+	std::ofstream json(filename.c_str());
+	if (!json.is_open()) {
+		PRINTB("ERROR: Can't open profile file '%s' for writing", filename);
+		return false;
+	}
+	std::map<std::string, double> stacks;
+	json << "{\n  \"root\":\n";
+	if (writeNode(json, stacks, root, frame_name(root), 4) < 0) json << "    null";
+	json << ",\n  \"operations\": [";
+	bool first = true;
+	BOOST_FOREACH(const operation_map::value_type &op, this->operations) {
+		json << (first ? "\n" : ",\n");
+		first = false;
+		json << "    { \"name\": \"" << json_escape(op.first) << "\", \"calls\": " << op.second.calls
+				 << ", \"time\": " << op.second.time << " }";
+	}
+	json << (first ? "]\n}\n" : "\n  ]\n}\n");
+	json.close();
+
+	std::ofstream stackfile(stackfilename.c_str());
+	if (!stackfile.is_open()) {
+		PRINTB("ERROR: Can't open profile file '%s' for writing", stackfilename);
+		return false;
+	}
+	typedef std::map<std::string, double>::value_type stack_entry;
+	BOOST_FOREACH(const stack_entry &stack, stacks) {
+		long usec = long(stack.second * 1e6 + 0.5);
+		if (usec > 0) stackfile << stack.first << " " << usec << "\n";
+	}
+	return !json.fail() && !stackfile.fail();
+}
+
+GeometryProfiler::Timer::Timer(const char *operation) : operation(operation)
+{
+	if (GeometryProfiler::instance()->isEnabled()) this->start = now();
+}
+
+GeometryProfiler::Timer::~Timer()
+{
+	if (!this->start.is_not_a_date_time()) {
+		GeometryProfiler::instance()->addOperationTime(this->operation, seconds(now() - this->start));
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "memory.h"
+#include "Geometry.h"
+
+#include <string>
+#include <map>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/*!
+	Collects timing information during geometry evaluation (--profile).
+
+	GeometryEvaluator reports when it starts and finishes evaluating each node,
+	and whether the result came from a cache. Expensive operations which aren't
+	tied to a single node, like CGAL conversions, are timed with
+	GeometryProfiler::Timer.
+
+	write() creates a JSON report following the node tree, and a collapsed stack
+	file (one line per module instantiation path with its self time in
+	microseconds) which can be fed to flame graph tools.
+
+	Recording is thread safe, and does nothing unless the profiler is enabled.
+*/
+class GeometryProfiler
+{
+public:
+	static GeometryProfiler *instance() { return inst; }
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return this->enabled; }
+
+	void beginNode(const class AbstractNode &node);
+	void endNode(const class AbstractNode &node, const shared_ptr<const Geometry> &geom);
+	void cacheHit(const class AbstractNode &node);
+	void addOperationTime(const char *operation, double seconds);
+
+	bool write(const class AbstractNode &root, const std::string &filename, const std::string &stackfilename);
+	void clear();
+
+	/*!
+		Adds the time from construction to destruction to the given operation.
+	*/
+	class Timer
+	{
+	public:
+		Timer(const char *operation);
+		~Timer();
+	private:
+		const char *operation;
+		boost::posix_time::ptime start;
+	};
+
+private:
+	GeometryProfiler() : enabled(false) {}
+
+	struct node_profile {
+		node_profile() : time(0), finished(false), cachehit(false), vertices(0), facets(0), memsize(0) {}
+		boost::posix_time::ptime start;
+		double time;
+		bool finished;
+		bool cachehit;
+		std::string type;
+		size_t vertices;
+		size_t facets;
+		size_t memsize;
+	};
+	struct operation_profile {
+		operation_profile() : calls(0), time(0) {}
+		size_t calls;
+		double time;
+	};
+	typedef std::map<int, node_profile> node_map;
+	typedef std::map<std::string, operation_profile> operation_map;
+
+	double writeNode(std::ostream &json, std::map<std::string, double> &stacks,
+									 const class AbstractNode &node, const std::string &path, int indent) const;
+
+	static GeometryProfiler *inst;
+
+	bool enabled;
+	node_map nodes;
+	operation_map operations;
+	mutable boost::mutex mutex;
+};
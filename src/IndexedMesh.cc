@@ -0,0 +1,74 @@
+#include "IndexedMesh.h"
+#include "polyset.h"
+#include "grid.h"
+
+#include <cstring>
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/cstdint.hpp>
+
+namespace {
+	/*!
+		Vertices are merged by the bit pattern of their coordinates, so -0.0 and
+		0.0 stay different vertices and are exported as they were given.
+	*/
+	struct VertexKey {
+		boost::uint64_t bits[3];
+		VertexKey(const Vector3d &v) { memcpy(this->bits, v.data(), sizeof(this->bits)); }
+		bool operator==(const VertexKey &other) const {
+			return this->bits[0] == other.bits[0] && this->bits[1] == other.bits[1] && this->bits[2] == other.bits[2];
+		}
+	};
+
+	size_t hash_value(const VertexKey &key)
+	{
+		return boost::hash_range(key.bits, key.bits + 3);
+	}
+}
+
+/*!
+	Converts a PolySet, merging vertices with bitwise identical coordinates.
+*/
+IndexedMesh::IndexedMesh(const PolySet &ps) : faceoffsets(1, 0)
+{
+	size_t numindices = 0;
+	BOOST_FOREACH(const Polygon &p, ps.polygons) numindices += p.size();
+	// Closed triangle meshes have about half as many vertices as faces
+	reserve(ps.polygons.size() / 2 + 3, ps.polygons.size(), numindices);
+
+	boost::unordered_map<VertexKey, int> vertexmap;
+	BOOST_FOREACH(const Polygon &p, ps.polygons) {
+		BOOST_FOREACH(const Vector3d &v, p) {
+			std::pair<boost::unordered_map<VertexKey, int>::iterator, bool> res =
+				vertexmap.insert(std::make_pair(VertexKey(v), int(this->vertices.size())));
+			if (res.second) this->vertices.push_back(v);
+			this->indices.push_back(res.first->second);
+		}
+		endFace();
+	}
+}
+
+void IndexedMesh::reserve(size_t numvertices, size_t numfaces, size_t numindices)
+{
+	this->vertices.reserve(numvertices);
+	this->faceoffsets.reserve(numfaces + 1);
+	this->indices.reserve(numindices);
+}
+
+int IndexedMesh::addVertex(const Vector3d &v)
+{
+	this->vertices.push_back(v);
+	return this->vertices.size() - 1;
+}
+
+void IndexedMesh::toPolySet(PolySet &ps) const
+{
+	ps.polygons.reserve(ps.polygons.size() + numFaces());
+	Polygon poly;
+	for (size_t i=0;i<numFaces();i++) {
+		poly.resize(faceSize(i));
+		for (size_t j=0;j<poly.size();j++) poly[j] = faceVertex(i, j);
+		ps.append_poly(poly);
+	}
+}
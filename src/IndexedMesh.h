@@ -0,0 +1,42 @@
+#pragma once
+
+#include "linalg.h"
+#include <vector>
+#include <stddef.h>
+
+class PolySet;
+
+/*!
+	Polygon mesh stored in flat arrays.
+
+	Each unique vertex is stored once in vertices. Faces are stored as one flat
+	array of vertex indices; face i uses indices[faceoffsets[i]] up to
+	indices[faceoffsets[i+1]]. Compared to PolySet, shared vertices are not
+	duplicated per face and there is no heap allocation per face.
+
+	PolySet keeps its own storage; this is a conversion target for code which
+	walks a mesh by shared vertex, i.e. the STL exporter and the disk cache.
+	Convert from a PolySet using the constructor and back using toPolySet().
+*/
+class IndexedMesh
+{
+public:
+	std::vector<Vector3d> vertices;
+	std::vector<int> indices;
+	std::vector<size_t> faceoffsets;
+
+	IndexedMesh() : faceoffsets(1, 0) {}
+	IndexedMesh(const PolySet &ps);
+
+	size_t numFaces() const { return this->faceoffsets.size() - 1; }
+	size_t faceSize(size_t face) const { return this->faceoffsets[face + 1] - this->faceoffsets[face]; }
+	const int *faceIndices(size_t face) const { return &this->indices[this->faceoffsets[face]]; }
+	const Vector3d &faceVertex(size_t face, size_t i) const { return this->vertices[this->indices[this->faceoffsets[face] + i]]; }
+
+	void reserve(size_t numvertices, size_t numfaces, size_t numindices);
+	int addVertex(const Vector3d &v);
+	void addIndex(int idx) { this->indices.push_back(idx); }
+	void endFace() { this->faceoffsets.push_back(this->indices.size()); }
+
+	void toPolySet(PolySet &ps) const;
+};
@@ -0,0 +1,318 @@
+#include "InstantiationCache.h"
+#include "ModuleCache.h"
+#include "module.h"
+#include "function.h"
+#include "context.h"
+#include "node.h"
+#include "printutils.h"
+
+#include <ctype.h>
+#include <algorithm>
+#include <set>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace {
+	typedef std::set<std::string> NameSet;
+
+	// Builtins whose results don't only depend on their arguments
+	const char *impure_names[] = {
+		"echo", "rands", "parent_module", "import", "import_stl", "import_off", "import_dxf",
+		"surface", "dxf_dim", "dxf_cross", "file", NULL
+	};
+
+	// Special variables which may be set outside of the document
+	const char *builtin_specials[] = {
+		"$fn", "$fs", "$fa", "$t", "$vpr", "$vpt", "$vpd", NULL
+	};
+
+	/*!
+		Adds all identifiers in the given dump to names, skipping string literals.
+	*/
+	void collectNames(const std::string &text, NameSet &names)
+	{
+		size_t i = 0;
+		const size_t n = text.size();
+		while (i < n) {
+			const unsigned char c = text[i];
+			if (c == '"') {
+				for (i++;i<n && text[i] != '"';i++) {
+					if (text[i] == '\\') i++;
+				}
+				i++;
+			}
+			else if (isalpha(c) || c == '_' || c == '$') {
+				const size_t start = i;
+				for (i++;i<n && (isalnum((unsigned char)text[i]) || text[i] == '_');i++);
+				names.insert(text.substr(start, i - start));
+			}
+			else if (isdigit(c)) {
+				for (i++;i<n && (isalnum((unsigned char)text[i]) || text[i] == '.');i++);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+
+	const std::string &lookupDefinition(const std::map<std::string, std::string> &definitions,
+																			const std::string &name)
+	{
+		static const std::string none;
+		std::map<std::string, std::string>::const_iterator it = definitions.find(name);
+		return it == definitions.end() ? none : it->second;
+	}
+
+	bool isTopLevelPath(const std::string &path)
+	{
+		return path.size() > 1 && path[0] == 'c' && isdigit((unsigned char)path[1]);
+	}
+}
+
+/*!
+	Instantiates the top-level statements of \a module in \a ctx, reusing nodes
+	from the previous call where possible. \a root is the node the returned
+	children will be added to, and must stay alive until the next call.
+*/
+std::vector<AbstractNode *> InstantiationCache::instantiateChildren(const FileModule &module, const Context &ctx, AbstractNode &root)
+{
+	AbstractNode *previousroot = this->root;
+	this->root = NULL;
+
+	DefinitionMap definitions;
+	BOOST_FOREACH(const LocalScope::FunctionContainer::value_type &f, module.scope.functions) {
+		definitions["function " + f.first] = f.second->dump("", f.first);
+	}
+	BOOST_FOREACH(const LocalScope::AbstractModuleContainer::value_type &m, module.scope.modules) {
+		definitions["module " + m.first] = m.second->dump("", m.first);
+	}
+
+	NameSet names;
+	collectNames(module.dump("", ""), names);
+	for (int i=0;builtin_specials[i];i++) names.insert(builtin_specials[i]);
+	ValueMap specials;
+	BOOST_FOREACH(const std::string &name, names) {
+		if (name[0] == '$') specials[name] = ctx.lookup_variable(name, true);
+	}
+
+	std::vector<std::string> libraries(module.usedlibs.begin(), module.usedlibs.end());
+	std::sort(libraries.begin(), libraries.end());
+	const unsigned long generation = ModuleCache::instance()->generation();
+
+	bool valid = previousroot && generation == this->generation &&
+		libraries == this->libraries && specials.size() == this->specials.size();
+	for (ValueMap::const_iterator it1 = specials.begin(), it2 = this->specials.begin();
+			 valid && it1 != specials.end(); ++it1, ++it2) {
+		valid = it1->first == it2->first && *it1->second == *it2->second;
+	}
+
+	EntryMap previous;
+	if (valid) previous.swap(this->entries);
+	this->entries.clear();
+	this->reused.clear();
+
+	PathMap paths;
+	InstantiationMap insts;
+	addPaths(module.scope, "", 'c', paths, insts);
+
+	std::vector<AbstractNode *> children;
+	for (size_t i=0;i<module.scope.children.size();i++) {
+		const ModuleInstantiation *modinst = module.scope.children[i];
+		const std::string key = modinst->dump("");
+		AbstractNode *node = NULL;
+
+		std::pair<EntryMap::iterator, EntryMap::iterator> range = previous.equal_range(key);
+		for (EntryMap::iterator it = range.first; it != range.second; ++it) {
+			if (reuse(it->second, i, ctx, definitions, insts)) {
+				node = it->second.node;
+				std::vector<AbstractNode *> &oldchildren = previousroot->children;
+				oldchildren.erase(std::remove(oldchildren.begin(), oldchildren.end(), node), oldchildren.end());
+				this->reused.insert(node);
+				this->entries.insert(*it);
+				previous.erase(it);
+				break;
+			}
+		}
+
+		if (!node) {
+			const size_t printed = printed_message_count();
+			node = modinst->evaluate(&ctx);
+			if (node && printed_message_count() == printed) record(key, i, node, ctx, definitions, paths);
+		}
+		if (node) children.push_back(node);
+	}
+	if (!this->reused.empty()) PRINTDB("Reused %d of %d top-level nodes", this->reused.size() % children.size());
+
+	this->definitions.swap(definitions);
+	this->specials.swap(specials);
+	this->libraries.swap(libraries);
+	this->generation = generation;
+	this->root = &root;
+	return children;
+}
+
+/*!
+	Assigns new indices to all nodes below \a root in depth-first order. For
+	each node of a reused subtree, the previous and the new index is added to
+	\a moved.
+*/
+void InstantiationCache::renumber(AbstractNode &root, std::vector<std::pair<size_t, size_t> > &moved)
+{
+	size_t idx = 1;
+	std::vector<std::pair<AbstractNode *, bool> > stack(1, std::make_pair(&root, false));
+	while (!stack.empty()) {
+		AbstractNode *node = stack.back().first;
+		const bool shared = stack.back().second || this->reused.count(node) > 0;
+		stack.pop_back();
+
+		if (shared) moved.push_back(std::make_pair(size_t(node->idx), idx));
+		node->idx = idx++;
+		BOOST_REVERSE_FOREACH(AbstractNode *child, node->children) {
+			stack.push_back(std::make_pair(child, shared));
+		}
+	}
+	this->reused.clear();
+}
+
+/*!
+	Forgets all previously instantiated nodes. Call this before deleting the
+	root node passed to the last instantiateChildren() call.
+*/
+void InstantiationCache::clear()
+{
+	this->entries.clear();
+	this->definitions.clear();
+	this->specials.clear();
+	this->libraries.clear();
+	this->reused.clear();
+	this->root = NULL;
+}
+
+/*!
+	Assigns a path to each ModuleInstantiation in the scope and its nested
+	scopes and module definitions, e.g. "c2/s0" for the first child of the
+	third top-level statement, or "cmfoo/s1" for the second child of the
+	top-level module foo.
+*/
+void InstantiationCache::addPaths(const LocalScope &scope, const std::string &path, char childtag,
+																	PathMap &paths, InstantiationMap &insts)
+{
+	for (size_t i=0;i<scope.children.size();i++) {
+		const ModuleInstantiation *inst = scope.children[i];
+		const std::string instpath = path + childtag + boost::lexical_cast<std::string>(i);
+		paths[inst] = instpath;
+		insts[instpath] = inst;
+		addPaths(inst->scope, instpath + "/", 's', paths, insts);
+		if (const IfElseModuleInstantiation *ifelse = dynamic_cast<const IfElseModuleInstantiation *>(inst)) {
+			addPaths(ifelse->else_scope, instpath + "/", 'e', paths, insts);
+		}
+	}
+	BOOST_FOREACH(const LocalScope::AbstractModuleContainer::value_type &m, scope.modules) {
+		if (const Module *mod = dynamic_cast<const Module *>(m.second)) {
+			addPaths(mod->scope, path + childtag + "m" + m.first + "/", 's', paths, insts);
+		}
+	}
+}
+
+int InstantiationCache::tags(const ModuleInstantiation &inst)
+{
+	return (inst.tag_root ? 1 : 0) | (inst.tag_highlight ? 2 : 0) | (inst.tag_background ? 4 : 0);
+}
+
+/*!
+	Stores the node instantiated for the top-level statement \a idx, unless
+	it depends on something which can't be checked later.
+	Returns false if the node can't be reused.
+*/
+bool InstantiationCache::record(const std::string &key, size_t idx, AbstractNode *node, const Context &ctx,
+																const DefinitionMap &definitions, const PathMap &paths)
+{
+	// Collect the names used by the statement and the definitions it uses
+	NameSet names;
+	collectNames(key, names);
+	std::vector<std::string> pending(names.begin(), names.end());
+	while (!pending.empty()) {
+		const std::string name = pending.back();
+		pending.pop_back();
+		NameSet used;
+		collectNames(lookupDefinition(definitions, "function " + name), used);
+		collectNames(lookupDefinition(definitions, "module " + name), used);
+		BOOST_FOREACH(const std::string &n, used) {
+			if (names.insert(n).second) pending.push_back(n);
+		}
+	}
+	for (int i=0;impure_names[i];i++) {
+		if (names.count(impure_names[i])) return false;
+	}
+
+	EntryMap::iterator it = this->entries.insert(std::make_pair(key, Entry()));
+	Entry &entry = it->second;
+	entry.node = node;
+	BOOST_FOREACH(const std::string &name, names) {
+		entry.names.push_back(name);
+		entry.values.push_back(ctx.lookup_variable(name, true));
+	}
+
+	// Nodes refer to their statement by a path relative to the top-level
+	// statement ("t"), or to a statement in a module definition
+	const std::string self = "c" + boost::lexical_cast<std::string>(idx);
+	std::vector<AbstractNode *> stack(1, node);
+	while (!stack.empty()) {
+		AbstractNode *n = stack.back();
+		stack.pop_back();
+		NodeRef ref;
+		ref.node = n;
+		ref.tags = n->modinst ? tags(*n->modinst) : 0;
+		PathMap::const_iterator pathit = n->modinst ? paths.find(n->modinst) : paths.end();
+		if (pathit != paths.end()) {
+			const std::string &path = pathit->second;
+			if (path.compare(0, self.size(), self) == 0 && (path.size() == self.size() || path[self.size()] == '/')) {
+				ref.path = "t" + path.substr(self.size());
+			}
+			else if (isTopLevelPath(path)) {
+				this->entries.erase(it);
+				return false;
+			}
+			else {
+				ref.path = path;
+			}
+		}
+		entry.refs.push_back(ref);
+		stack.insert(stack.end(), n->children.begin(), n->children.end());
+	}
+	return true;
+}
+
+/*!
+	Checks whether the entry can be reused for the top-level statement \a idx
+	and, if so, remaps its nodes to the ModuleInstantiations of the new document.
+*/
+bool InstantiationCache::reuse(Entry &entry, size_t idx, const Context &ctx,
+															 const DefinitionMap &definitions, const InstantiationMap &insts)
+{
+	for (size_t i=0;i<entry.names.size();i++) {
+		const std::string &name = entry.names[i];
+		if (lookupDefinition(this->definitions, "function " + name) != lookupDefinition(definitions, "function " + name) ||
+				lookupDefinition(this->definitions, "module " + name) != lookupDefinition(definitions, "module " + name)) {
+			return false;
+		}
+		if (!(*ctx.lookup_variable(name, true) == *entry.values[i])) return false;
+	}
+
+	const std::string self = "c" + boost::lexical_cast<std::string>(idx);
+	std::vector<const ModuleInstantiation *> modinsts(entry.refs.size());
+	for (size_t i=0;i<entry.refs.size();i++) {
+		const NodeRef &ref = entry.refs[i];
+		if (ref.path.empty()) {
+			modinsts[i] = ref.node->modinst;
+			continue;
+		}
+		InstantiationMap::const_iterator it = insts.find(ref.path[0] == 't' ? self + ref.path.substr(1) : ref.path);
+		if (it == insts.end() || tags(*it->second) != ref.tags) return false;
+		modinsts[i] = it->second;
+	}
+	for (size_t i=0;i<entry.refs.size();i++) {
+		entry.refs[i].node->modinst = modinsts[i];
+	}
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "value.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+class AbstractNode;
+class FileModule;
+class ModuleInstantiation;
+class LocalScope;
+class Context;
+
+/*!
+	Reuses the node trees of unchanged top-level statements when a document
+	is instantiated again after an edit.
+
+	A top-level statement is matched to one of the previous instantiation by
+	its dump. Its node tree is reused if all top-level functions and modules
+	it refers to, directly or through other definitions, are unchanged and all
+	variables it refers to evaluate to the same values as before. Any change
+	of a special variable visible to the document, of the used libraries or
+	of the ModuleCache invalidates everything.
+
+	Statements which print anything while being instantiated, or which refer
+	to builtins reading files or random numbers, are always instantiated again.
+
+	Reused nodes are moved from the previous root node into the new one, and
+	their modinst pointers are remapped to the matching ModuleInstantiations
+	of the new document. renumber() gives all nodes new indices and reports
+	which indices moved, so the Tree can keep the cached strings of reused
+	subtrees.
+
+	The previous root node must stay alive until the next call to
+	instantiateChildren(), otherwise clear() has to be called first.
+*/
+class InstantiationCache
+{
+public:
+	InstantiationCache() : root(NULL), generation(0) {}
+
+	std::vector<AbstractNode *> instantiateChildren(const FileModule &module, const Context &ctx, AbstractNode &root);
+	void renumber(AbstractNode &root, std::vector<std::pair<size_t, size_t> > &moved);
+	void clear();
+
+private:
+	// A node of a reused subtree and the location of its ModuleInstantiation
+	struct NodeRef {
+		AbstractNode *node;
+		std::string path;
+		int tags;
+	};
+
+	struct Entry {
+		AbstractNode *node;
+		std::vector<std::string> names;
+		std::vector<ValuePtr> values;
+		std::vector<NodeRef> refs;
+	};
+
+	typedef std::multimap<std::string, Entry> EntryMap;
+	typedef std::map<std::string, std::string> DefinitionMap;
+	typedef std::map<std::string, ValuePtr> ValueMap;
+	typedef boost::unordered_map<const ModuleInstantiation *, std::string> PathMap;
+	typedef boost::unordered_map<std::string, const ModuleInstantiation *> InstantiationMap;
+
+	static void addPaths(const LocalScope &scope, const std::string &path, char childtag,
+											 PathMap &paths, InstantiationMap &insts);
+	static int tags(const ModuleInstantiation &inst);
+
+	bool record(const std::string &key, size_t idx, AbstractNode *node, const Context &ctx,
+							const DefinitionMap &definitions, const PathMap &paths);
+	bool reuse(Entry &entry, size_t idx, const Context &ctx,
+						 const DefinitionMap &definitions, const InstantiationMap &insts);
+
+	EntryMap entries;
+	DefinitionMap definitions;
+	ValueMap specials;
+	std::vector<std::string> libraries;
+	AbstractNode *root;
+	unsigned long generation;
+	// Top-level nodes reused by the last instantiateChildren()
+	boost::unordered_set<const AbstractNode *> reused;
+};
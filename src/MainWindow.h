@@ -9,6 +9,7 @@
 #include "modcontext.h"
 #include "module.h"
 #include "Tree.h"
+#include "InstantiationCache.h"
 #include "memory.h"
 #include "editor.h"
 #include <vector>
@@ -49,6 +50,7 @@ public:
 	AbstractNode *absolute_root_node; // Result of tree evaluation
 	AbstractNode *root_node;          // Root if the root modifier (!) is used
 	Tree tree;
+	InstantiationCache instantiation_cache; // Unchanged subtrees of the previous evaluation
 
 	shared_ptr<class CSGTerm> root_raw_term;           // Result of CSG term rendering
 	shared_ptr<CSGTerm> root_norm_term;          // Normalized CSG products
@@ -181,7 +183,7 @@ private slots:
 	void csgReloadRender();
 #ifdef ENABLE_CGAL
 	void actionRender();
-	void actionRenderDone(shared_ptr<const class Geometry>);
+	void actionRenderDone(shared_ptr<const class Geometry>, shared_ptr<class CGALRenderBuffer>);
 	void cgalRender();
 #endif
 	void actionCheckValidity();
@@ -115,6 +115,7 @@ bool ModuleCache::evaluate(const std::string &filename, FileModule *&module)
 		if (oldmodule) delete oldmodule;
 		entry.module = lib_mod;
 		entry.cache_id = cache_id;
+		this->current_generation++;
 		
 		print_messages_pop();
 	}
@@ -128,6 +129,7 @@ bool ModuleCache::evaluate(const std::string &filename, FileModule *&module)
 void ModuleCache::clear()
 {
 	this->entries.clear();
+	this->current_generation++;
 }
 
 FileModule *ModuleCache::lookup(const std::string &filename)
@@ -15,9 +15,11 @@ public:
 	bool isCached(const std::string &filename);
 	size_t size() { return this->entries.size(); }
 	void clear();
+	/*! Incremented whenever a cached module is compiled or the cache is cleared */
+	unsigned long generation() const { return this->current_generation; }
 
 private:
-	ModuleCache() {}
+	ModuleCache() : current_generation(0) {}
 	~ModuleCache() {}
 
 	static ModuleCache *inst;
@@ -27,4 +29,5 @@ private:
 		std::string cache_id;
 	};
 	boost::unordered_map<std::string, cache_entry> entries;
+	unsigned long current_generation;
 };
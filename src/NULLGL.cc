@@ -23,11 +23,10 @@ BoundingBox ThrownTogetherRenderer::getBoundingBox() const {assert(false && "not
 
 #include "CGALRenderer.h"
 
-CGALRenderer::CGALRenderer(shared_ptr<const class Geometry> geom) {}
+CGALRenderer::CGALRenderer(shared_ptr<const class Geometry> geom, shared_ptr<CGALRenderBuffer> buffer) {}
 CGALRenderer::~CGALRenderer() {}
 void CGALRenderer::draw(bool showfaces, bool showedges) const {}
 BoundingBox CGALRenderer::getBoundingBox() const {assert(false && "not implemented");}
-void CGALRenderer::setColorScheme(const ColorScheme &cs){assert(false && "not implemented");}
 
 
 #include "system-gl.h"
@@ -7,10 +7,12 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 #include "fbo.h"
 
 struct OffscreenContext *create_offscreen_context(int w, int h);
 bool teardown_offscreen_context(OffscreenContext *ctx);
 bool save_framebuffer(OffscreenContext *ctx, const char * filename);
 bool save_framebuffer(OffscreenContext *ctx, std::ostream &output);
+bool read_framebuffer(OffscreenContext *ctx, int width, int height, std::vector<unsigned char> &pixels);
 std::string offscreen_context_getinfo(OffscreenContext *ctx);
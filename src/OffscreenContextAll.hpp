@@ -26,31 +26,32 @@ bool save_framebuffer(OffscreenContext *ctx, const char *filename)
 }
 
 /*!
-  Capture framebuffer from OpenGL and write it to the given ostream.
-  Called by save_framebuffer() from platform-specific code.
+  Capture the lower left width x height pixels of the framebuffer as RGBA,
+  with the rows in the top-down order expected by write_png().
  */
-bool save_framebuffer_common(OffscreenContext *ctx, std::ostream &output)
+bool read_framebuffer(OffscreenContext *ctx, int width, int height, std::vector<unsigned char> &pixels)
 {
-	if (!ctx) return false;
+	if (!ctx || width > ctx->width || height > ctx->height) return false;
 	int samplesPerPixel = 4; // R, G, B and A
-	std::vector<GLubyte> pixels(ctx->width * ctx->height * samplesPerPixel);
-	glReadPixels(0, 0, ctx->width, ctx->height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	std::vector<GLubyte> glpixels(width * height * samplesPerPixel);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &glpixels[0]);
 
 	// Flip it vertically - images read from OpenGL buffers are upside-down
-	int rowBytes = samplesPerPixel * ctx->width;
-
-	unsigned char *flippedBuffer = (unsigned char *)malloc(rowBytes * ctx->height);
-	if (!flippedBuffer) {
-		std::cerr << "Unable to allocate flipped buffer for corrected image.";
-		return 1;
-	}
-	flip_image(&pixels[0], flippedBuffer, samplesPerPixel, ctx->width, ctx->height);
-
-	bool writeok = write_png(output, flippedBuffer, ctx->width, ctx->height);
-
-	free(flippedBuffer);
+	pixels.resize(glpixels.size());
+	flip_image(&glpixels[0], &pixels[0], samplesPerPixel, width, height);
+	return true;
+}
 
-	return writeok;
+/*!
+  Capture framebuffer from OpenGL and write it to the given ostream.
+  Called by save_framebuffer() from platform-specific code.
+ */
+bool save_framebuffer_common(OffscreenContext *ctx, std::ostream &output)
+{
+	if (!ctx) return false;
+	std::vector<unsigned char> pixels;
+	if (!read_framebuffer(ctx, ctx->width, ctx->height, pixels)) return false;
+	return write_png(output, &pixels[0], ctx->width, ctx->height);
 }
 
 //	Called by create_offscreen_context() from platform-specific code.
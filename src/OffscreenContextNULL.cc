@@ -64,3 +64,10 @@ bool save_framebuffer(OffscreenContext *ctx, std::ostream &output)
   return true;
 }
 
+bool read_framebuffer(OffscreenContext *ctx, int width, int height, std::vector<unsigned char> &pixels)
+{
+  if (!ctx || width > ctx->width || height > ctx->height) return false;
+  pixels.assign(width * height * 4, 0);
+  return true;
+}
+
@@ -71,25 +71,29 @@ void OpenCSGRenderer::draw(bool /*showfaces*/, bool showedges) const
 	}
 }
 
+/*!
+	Products consisting of a single object don't need OpenCSG. Consecutive
+	ones are collected and drawn grouped by geometry, before the next product
+	which does need OpenCSG and at the end.
+*/
 void OpenCSGRenderer::renderCSGChain(CSGChain *chain, GLint *shaderinfo, 
 																		 bool highlight, bool background) const
 {
 	std::vector<OpenCSG::Primitive*> primitives;
+	InstanceGroups instances;
 	size_t j = 0;
 	for (size_t i = 0;; i++) {
 		bool last = i == chain->objects.size();
 		const CSGChainObject &i_obj = last ? chain->objects[i-1] : chain->objects[i];
 		if (last || i_obj.type == CSGTerm::TYPE_UNION) {
-			if (j+1 != i) {
+			const bool usecsg = j+1 != i;
+			if (usecsg) {
+				renderInstances(instances, shaderinfo);
 				 OpenCSG::render(primitives);
 				glDepthFunc(GL_EQUAL);
 			}
-			if (shaderinfo) glUseProgram(shaderinfo[0]);
 			for (; j < i; j++) {
 				const CSGChainObject &j_obj = chain->objects[j];
-				const Color4f &c = j_obj.color;
-				glPushMatrix();
-				glMultMatrixd(j_obj.matrix.data());
 				csgmode_e csgmode = csgmode_e(
 					(highlight ? 
 					 CSGMODE_HIGHLIGHT :
@@ -120,12 +124,9 @@ void OpenCSGRenderer::renderCSGChain(CSGChain *chain, GLint *shaderinfo,
 					}
 				}
 
-				setColor(colormode, c.data(), shaderinfo);
-
-				render_surface(j_obj.geom, csgmode, j_obj.matrix, shaderinfo);
-				glPopMatrix();
+				instances.add(j_obj.geom, csgmode, j_obj.matrix, j_obj.color, colormode);
 			}
-			if (shaderinfo) glUseProgram(0);
+			if (usecsg || last) renderInstances(instances, shaderinfo);
 			for (unsigned int k = 0; k < primitives.size(); k++) {
 				delete primitives[k];
 			}
@@ -153,6 +154,18 @@ void OpenCSGRenderer::renderCSGChain(CSGChain *chain, GLint *shaderinfo,
 	std::for_each(primitives.begin(), primitives.end(), del_fun<OpenCSG::Primitive>());
 }
 
+/*!
+	Draws and clears the collected instances.
+*/
+void OpenCSGRenderer::renderInstances(InstanceGroups &instances, GLint *shaderinfo) const
+{
+	if (instances.empty()) return;
+	if (shaderinfo) glUseProgram(shaderinfo[0]);
+	render_instances(instances, false, shaderinfo);
+	if (shaderinfo) glUseProgram(0);
+	instances.clear();
+}
+
 BoundingBox OpenCSGRenderer::getBoundingBox() const
 {
 	BoundingBox bbox;
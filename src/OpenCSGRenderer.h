@@ -13,6 +13,7 @@ public:
 private:
 	void renderCSGChain(class CSGChain *chain, GLint *shaderinfo, 
 											bool highlight, bool background) const;
+	void renderInstances(InstanceGroups &instances, GLint *shaderinfo) const;
 
 	CSGChain *root_chain;
 	CSGChain *highlights_chain;
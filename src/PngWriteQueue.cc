@@ -0,0 +1,74 @@
+#include "PngWriteQueue.h"
+#include "imageutils.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+PngWriteQueue::PngWriteQueue(unsigned int numthreads)
+	: maxpending(2 * std::max(numthreads, 1u)), stopping(false), ok(true)
+{
+	for (unsigned int i=0;i<std::max(numthreads, 1u);i++) {
+		this->threads.create_thread(boost::bind(&PngWriteQueue::run, this));
+	}
+}
+
+PngWriteQueue::~PngWriteQueue()
+{
+	finish();
+}
+
+/*!
+	Queues an image for writing. The pixels are taken over, leaving \a pixels
+	empty.
+*/
+void PngWriteQueue::push(const std::string &filename, std::vector<unsigned char> &pixels, int width, int height)
+{
+	boost::unique_lock<boost::mutex> lock(this->mutex);
+	while (this->jobs.size() >= this->maxpending) this->cond.wait(lock);
+	this->jobs.push_back(Job());
+	Job &job = this->jobs.back();
+	job.filename = filename;
+	job.pixels.swap(pixels);
+	job.width = width;
+	job.height = height;
+	this->cond.notify_all();
+}
+
+/*!
+	Waits until all queued images are written and stops the worker threads.
+	Returns false if any image couldn't be written.
+*/
+bool PngWriteQueue::finish()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(this->mutex);
+		this->stopping = true;
+		this->cond.notify_all();
+	}
+	this->threads.join_all();
+	return this->ok;
+}
+
+void PngWriteQueue::run()
+{
+	Job job;
+	while (true) {
+		{
+			boost::unique_lock<boost::mutex> lock(this->mutex);
+			while (this->jobs.empty() && !this->stopping) this->cond.wait(lock);
+			if (this->jobs.empty()) return;
+			job.filename.swap(this->jobs.front().filename);
+			job.pixels.swap(this->jobs.front().pixels);
+			job.width = this->jobs.front().width;
+			job.height = this->jobs.front().height;
+			this->jobs.pop_front();
+			this->cond.notify_all();
+		}
+		bool written = write_png(job.filename.c_str(), &job.pixels[0], job.width, job.height);
+		if (!written) {
+			boost::lock_guard<boost::mutex> lock(this->mutex);
+			this->ok = false;
+		}
+	}
+}
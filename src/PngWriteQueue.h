@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/*!
+	Encodes and writes PNG images on worker threads, so the offscreen GL
+	context can render the next image while the previous ones are compressed.
+
+	push() hands over the RGBA pixels of one image, as returned by
+	read_framebuffer(). It blocks while too many images are pending, which
+	keeps memory bounded when encoding is slower than rendering.
+	finish() waits for all images to be written.
+*/
+class PngWriteQueue
+{
+public:
+	PngWriteQueue(unsigned int numthreads);
+	~PngWriteQueue();
+
+	void push(const std::string &filename, std::vector<unsigned char> &pixels, int width, int height);
+	bool finish();
+
+private:
+	struct Job {
+		std::string filename;
+		std::vector<unsigned char> pixels;
+		int width, height;
+	};
+
+	void run();
+
+	boost::thread_group threads;
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::deque<Job> jobs;
+	size_t maxpending;
+	bool stopping;
+	bool ok;
+};
@@ -1,4 +1,5 @@
 #include "Polygon2d-CGAL.h"
+#include "cgalutils.h"
 #include "polyset.h"
 #include "printutils.h"
 
@@ -87,17 +88,15 @@ mark_domains(CDT &cdt)
 }
 
 #define OPENSCAD_CGAL_ERROR_BEGIN \
-	CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION); \
+	CGALUtils::ErrorBehaviourGuard error_behaviour_guard; \
 	try {
 
 #define OPENSCAD_CGAL_ERROR_END(errorstr, onerror) \
   } \
 	catch (const CGAL::Precondition_exception &e) { \
 		PRINTB(errorstr ": %s", e.what()); \
-		CGAL::set_error_behaviour(old_behaviour); \
 		onerror; \
-	} \
-	CGAL::set_error_behaviour(old_behaviour);
+	}
   
 
 /*!
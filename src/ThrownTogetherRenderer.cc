@@ -67,13 +67,10 @@ void ThrownTogetherRenderer::renderCSGChain(CSGChain *chain, bool highlight,
 	PRINTD("Thrown renderCSGChain");
 	glDepthFunc(GL_LEQUAL);
 	boost::unordered_map<std::pair<const Geometry*,const Transform3d*>,int> geomVisitMark;
+	InstanceGroups instances;
 	BOOST_FOREACH(const CSGChainObject &obj, chain->objects) {
 		if (geomVisitMark[std::make_pair(obj.geom.get(), &obj.matrix)]++ > 0)
 			continue;
-		const Transform3d &m = obj.matrix;
-		const Color4f &c = obj.color;
-		glPushMatrix();
-		glMultMatrixd(m.data());
 		csgmode_e csgmode = csgmode_e(
 			(highlight ? 
 			 CSGMODE_HIGHLIGHT :
@@ -111,17 +108,12 @@ void ThrownTogetherRenderer::renderCSGChain(CSGChain *chain, bool highlight,
 			}
 			edge_colormode = COLORMODE_MATERIAL_EDGES;
 		}
-		
-		setColor(colormode, c.data());
-		render_surface(obj.geom, csgmode, m);
-		if (showedges) {
-			// FIXME? glColor4f((c[0]+1)/2, (c[1]+1)/2, (c[2]+1)/2, 1.0);
-			setColor(edge_colormode);
-			render_edges(obj.geom, csgmode);
-		}
 
-		glPopMatrix();
+		// FIXME? edge color (c[0]+1)/2, (c[1]+1)/2, (c[2]+1)/2, 1.0
+		instances.add(obj.geom, csgmode, obj.matrix, obj.color, colormode, edge_colormode);
 	}
+	// Objects sharing a geometry are drawn together, see render_instances()
+	render_instances(instances, showedges);
 }
 
 BoundingBox ThrownTogetherRenderer::getBoundingBox() const
@@ -1,11 +1,10 @@
 #include "Tree.h"
 #include "nodedumper.h"
+#include "nodehasher.h"
 #include "printutils.h"
 
 #include <assert.h>
-#include <algorithm>
-#include <sstream>
-#include <boost/regex.hpp>
+#include <boost/thread/locks.hpp>
 
 Tree::~Tree()
 {
@@ -15,14 +14,13 @@ Tree::~Tree()
 
 /*!
 	Returns the cached string representation of the subtree rooted by \a node.
-	If node is not cached, the cache will be rebuilt.
+	If node is not cached, the missing parts of the cache will be rebuilt.
 */
 const std::string &Tree::getString(const AbstractNode &node) const
 {
 	assert(this->root_node);
+	boost::lock_guard<boost::recursive_mutex> lock(this->mutex);
 	if (!this->nodecache.contains(node)) {
-		this->nodecache.clear();
-		this->nodeidcache.clear();
 		NodeDumper dumper(this->nodecache, false);
 		Traverser trav(dumper, *this->root_node, Traverser::PRE_AND_POSTFIX);
 		trav.execute();
@@ -33,30 +31,31 @@ const std::string &Tree::getString(const AbstractNode &node) const
 }
 
 /*!
-	Returns the cached ID string representation of the subtree rooted by \a node.
-	If node is not cached, the cache will be rebuilt.
+	Returns the cached ID string of the subtree rooted by \a node.
+	If node is not cached, the missing IDs of the tree will be rebuilt.
 
-	The difference between this method and getString() is that the ID string
-	is stripped for whitespace. Especially indentation whitespace is important to
-	strip to enable cache hits for equivalent nodes from different scopes.
+	The ID string is a 128-bit structural hash (see NodeHasher) of the subtree.
+	Equivalent subtrees from different scopes get the same ID, and since it is
+	computed from the child IDs rather than the full text dump, it's cheap to
+	create and to use as a cache key, even near the root of large trees.
+	Use getString() for a human readable representation.
 */
 const std::string &Tree::getIdString(const AbstractNode &node) const
 {
 	assert(this->root_node);
+	boost::lock_guard<boost::recursive_mutex> lock(this->mutex);
 
 	if (!this->nodeidcache.contains(node)) {
-		const std::string &nodestr = getString(node);
-		const boost::regex re("[^\\s\\\"]+|\\\"(?:[^\\\"\\\\]|\\\\.)*\\\"");
-		std::stringstream sstream;
-		boost::sregex_token_iterator i(nodestr.begin(), nodestr.end(), re, 0);
-		std::copy(i, boost::sregex_token_iterator(), std::ostream_iterator<std::string>(sstream));
-
-		const std::string & result = this->nodeidcache.insert(node, sstream.str());
-		PRINTDB("Id Cache MISS: %s", result);
+		NodeHasher hasher(this->nodeidcache);
+		Traverser trav(hasher, *this->root_node, Traverser::PRE_AND_POSTFIX);
+		trav.execute();
+		assert(this->nodeidcache.contains(node) && "NodeHasher failed to create a cache");
+		const std::string &result = this->nodeidcache[node];
+		if (OpenSCAD::debug != "") PRINTDB("Id Cache MISS: %s %s", result % getString(node));
 		return result;
 	} else {
-		const std::string & result = this->nodeidcache[node];
-		PRINTDB("Id Cache HIT:  %s", result);
+		const std::string &result = this->nodeidcache[node];
+		if (OpenSCAD::debug != "") PRINTDB("Id Cache HIT:  %s %s", result % getString(node));
 		return result;
 	}
 }
@@ -66,6 +65,26 @@ const std::string &Tree::getIdString(const AbstractNode &node) const
  */
 void Tree::setRoot(const AbstractNode *root)
 {
+	boost::lock_guard<boost::recursive_mutex> lock(this->mutex);
 	this->root_node = root; 
 	this->nodecache.clear();
+	this->nodeidcache.clear();
+}
+
+/*!
+	Sets a new root which shares subtrees with the current one. \a moved holds
+	pairs of the previous and new index of each shared node; the strings cached
+	for those nodes are kept, everything else is cleared.
+ */
+void Tree::setRoot(const AbstractNode *root, const std::vector<std::pair<size_t, size_t> > &moved)
+{
+	boost::lock_guard<boost::recursive_mutex> lock(this->mutex);
+	NodeCache oldcache, oldidcache;
+	oldcache.swap(this->nodecache);
+	oldidcache.swap(this->nodeidcache);
+	this->root_node = root;
+	for (size_t i=0;i<moved.size();i++) {
+		this->nodecache.take(oldcache, moved[i].first, moved[i].second);
+		this->nodeidcache.take(oldidcache, moved[i].first, moved[i].second);
+	}
 }
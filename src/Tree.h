@@ -2,11 +2,18 @@
 
 #include "nodecache.h"
 
+#include <vector>
+#include <utility>
+#include <boost/thread/recursive_mutex.hpp>
+
 /*!  
 	For now, just an abstraction of the node tree which keeps a dump
 	cache based on node indices around.
 
-	Note that since node trees don't survive a recompilation, the tree cannot either.
+	Node trees generally don't survive a recompilation, but subtrees which do
+	can keep their cached strings, see setRoot().
+
+	The string getters are safe to call from concurrent GeometryEvaluators.
  */
 class Tree
 {
@@ -15,6 +22,7 @@ public:
 	~Tree();
 
 	void setRoot(const AbstractNode *root);
+	void setRoot(const AbstractNode *root, const std::vector<std::pair<size_t, size_t> > &moved);
 	const AbstractNode *root() const { return this->root_node; }
 
 	const std::string &getString(const AbstractNode &node) const;
@@ -24,4 +32,5 @@ private:
 	const AbstractNode *root_node;
   mutable NodeCache nodecache;
   mutable NodeCache nodeidcache;
+	mutable boost::recursive_mutex mutex;
 };
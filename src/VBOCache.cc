@@ -0,0 +1,266 @@
+#include "VBOCache.h"
+#include "polyset.h"
+#include "printutils.h"
+
+#include <math.h>
+
+VBOCache *VBOCache::curr = NULL;
+
+VertexArray::VertexArray(GLenum mode, bool normals, bool edgeattribs)
+	: mode(mode), normals(normals), edgeattribs(normals && edgeattribs),
+		stride(normals ? (this->edgeattribs ? 18 : 6) : 3), count(0)
+{
+}
+
+void VertexArray::addVertex(const Vector3d &p)
+{
+	this->data.push_back(p[0]);
+	this->data.push_back(p[1]);
+	this->data.push_back(p[2]);
+	this->count++;
+}
+
+/*!
+	Adds a triangle with its face normal. If edge shader attributes are
+	included, e0, e1 and e2 tell which edges of the triangle should be drawn.
+	All vertices are offset by z.
+*/
+void VertexArray::addTriangle(const Vector3d &p0, const Vector3d &p1, const Vector3d &p2,
+															bool e0, bool e1, bool e2, double z)
+{
+	double ax = p1[0] - p0[0], bx = p1[0] - p2[0];
+	double ay = p1[1] - p0[1], by = p1[1] - p2[1];
+	double az = p1[2] - p0[2], bz = p1[2] - p2[2];
+	double nx = ay*bz - az*by;
+	double ny = az*bx - ax*bz;
+	double nz = ax*by - ay*bx;
+	double nl = sqrt(nx*nx + ny*ny + nz*nz);
+	const Vector3d n(nx / nl, ny / nl, nz / nl);
+	const Vector3d offset(0, 0, z);
+	const Vector3d *p[3] = { &p0, &p1, &p2 };
+	const double ef[3] = { e0 ? 2.0 : -1.0, e1 ? 2.0 : -1.0, e2 ? 2.0 : -1.0 };
+	// Which vertex is which in the edge shader
+	static const double mask[3][3] = { {0, 1, 0}, {0, 0, 1}, {1, 0, 0} };
+
+	for (int i=0;i<3;i++) {
+		const Vector3d v = *p[i] + offset;
+		this->data.push_back(v[0]);
+		this->data.push_back(v[1]);
+		this->data.push_back(v[2]);
+		if (this->normals) {
+			this->data.push_back(n[0]);
+			this->data.push_back(n[1]);
+			this->data.push_back(n[2]);
+		}
+		if (this->edgeattribs) {
+			// The positions of the two other vertices
+			const Vector3d a = *p[i == 0 ? 1 : 0] + offset;
+			const Vector3d b = *p[i == 2 ? 1 : 2] + offset;
+			for (int j=0;j<3;j++) this->data.push_back(ef[j]);
+			for (int j=0;j<3;j++) this->data.push_back(a[j]);
+			for (int j=0;j<3;j++) this->data.push_back(b[j]);
+			for (int j=0;j<3;j++) this->data.push_back(mask[i][j]);
+		}
+		this->count++;
+	}
+}
+
+#ifndef NULLGL
+/*!
+	Draws the vertices, either from client memory or, if vbo is given, from
+	that buffer object. Triangles of mirrored objects are drawn with reversed
+	orientation, so they still face outwards.
+*/
+void VertexArray::draw(GLint *shaderinfo, bool mirrored, GLuint vbo) const
+{
+	bind(shaderinfo, vbo);
+	drawArrays(mirrored);
+	unbind(shaderinfo, vbo);
+}
+
+/*!
+	Sets up the vertex arrays for drawArrays().
+*/
+void VertexArray::bind(GLint *shaderinfo, GLuint vbo) const
+{
+	const GLsizei stridebytes = this->stride * sizeof(GLfloat);
+	const GLfloat *base = NULL;
+	if (vbo) glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	else if (!this->data.empty()) base = &this->data[0];
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stridebytes, base);
+	if (this->normals) {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, stridebytes, base + 3);
+	}
+#ifdef ENABLE_OPENCSG
+	if (shaderinfo && this->edgeattribs) {
+		glUniform1f(shaderinfo[7], shaderinfo[9]);
+		glUniform1f(shaderinfo[8], shaderinfo[10]);
+		for (int i=0;i<4;i++) {
+			glEnableVertexAttribArray(shaderinfo[3+i]);
+			glVertexAttribPointer(shaderinfo[3+i], 3, GL_FLOAT, GL_FALSE, stridebytes, base + 6 + 3*i);
+		}
+	}
+#endif
+}
+
+void VertexArray::drawArrays(bool mirrored) const
+{
+	if (this->count == 0) return;
+	if (mirrored) glFrontFace(GL_CW);
+	glDrawArrays(this->mode, 0, this->count);
+	if (mirrored) glFrontFace(GL_CCW);
+}
+
+void VertexArray::unbind(GLint *shaderinfo, GLuint vbo) const
+{
+#ifdef ENABLE_OPENCSG
+	if (shaderinfo && this->edgeattribs) {
+		for (int i=0;i<4;i++) glDisableVertexAttribArray(shaderinfo[3+i]);
+	}
+#endif
+	if (this->normals) glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (vbo) glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int VBOCache::surfaceVariant(const PolySet &ps, Renderer::csgmode_e csgmode, GLint *shaderinfo)
+{
+	// The thickness of 2D objects depends on the mode
+	return (shaderinfo ? 1 : 0) |
+		((ps.getDimension() == 2 && (csgmode & CSGMODE_DIFFERENCE_FLAG)) ? 2 : 0);
+}
+
+int VBOCache::edgeVariant(const PolySet &ps, Renderer::csgmode_e csgmode)
+{
+	int variant = 4;
+	if (ps.getDimension() == 2) {
+		if (csgmode == Renderer::CSGMODE_NONE) variant |= 8;
+		else if (csgmode & CSGMODE_DIFFERENCE_FLAG) variant |= 2;
+	}
+	return variant;
+}
+
+/*!
+	Returns the cached vertices for the given variant of the PolySet, creating
+	and uploading them if necessary.
+*/
+const VBOCache::Entry &VBOCache::get(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode, int variant)
+{
+	Key key(ps.get(), variant);
+	EntryMap::iterator it = this->entries.find(key);
+	if (it != this->entries.end()) {
+		// A different PolySet may have been allocated at the same address
+		if (it->second.geom.lock() == ps) return it->second;
+		if (it->second.vbo) glDeleteBuffers(1, &it->second.vbo);
+		this->entries.erase(it);
+	}
+
+	Entry &entry = this->entries[key];
+	entry.geom = ps;
+	entry.vbo = 0;
+	if (variant & 4) ps->createEdgeVertices(csgmode, entry.vertices);
+	else ps->createSurfaceVertices(csgmode, variant & 1, entry.vertices);
+
+	if (GLEW_VERSION_1_5 && entry.vertices.count > 0) {
+		glGenBuffers(1, &entry.vbo);
+		if (entry.vbo) {
+			glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
+			glBufferData(GL_ARRAY_BUFFER, entry.vertices.data.size() * sizeof(GLfloat),
+									 &entry.vertices.data[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			std::vector<GLfloat>().swap(entry.vertices.data);
+		}
+	}
+	return entry;
+}
+
+void VBOCache::render_surface(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+															const Transform3d &m, GLint *shaderinfo)
+{
+	const Entry &entry = get(ps, csgmode, surfaceVariant(*ps, csgmode, shaderinfo));
+	entry.vertices.draw(shaderinfo, m.matrix().determinant() < 0, entry.vbo);
+}
+
+void VBOCache::render_edges(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode)
+{
+	const Entry &entry = get(ps, csgmode, edgeVariant(*ps, csgmode));
+	glDisable(GL_LIGHTING);
+	entry.vertices.draw(NULL, false, entry.vbo);
+	glEnable(GL_LIGHTING);
+}
+
+VBOCache::Batch::Batch(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+											 GLint *shaderinfo, bool edges)
+	: vertices(&this->local), vbo(0), shaderinfo(edges ? NULL : shaderinfo), edges(edges)
+{
+	if (VBOCache *cache = VBOCache::current()) {
+		const Entry &entry = cache->get(ps, csgmode, edges ? edgeVariant(*ps, csgmode) :
+																		surfaceVariant(*ps, csgmode, shaderinfo));
+		this->vertices = &entry.vertices;
+		this->vbo = entry.vbo;
+	}
+	else if (edges) {
+		ps->createEdgeVertices(csgmode, this->local);
+	}
+	else {
+		ps->createSurfaceVertices(csgmode, shaderinfo != NULL, this->local);
+	}
+	if (edges) glDisable(GL_LIGHTING);
+	this->vertices->bind(this->shaderinfo, this->vbo);
+}
+
+VBOCache::Batch::~Batch()
+{
+	this->vertices->unbind(this->shaderinfo, this->vbo);
+	if (this->edges) glEnable(GL_LIGHTING);
+}
+
+/*!
+	Draws one instance. \a m is only used to detect mirroring; the caller
+	has already applied it to the modelview matrix.
+*/
+void VBOCache::Batch::draw(const Transform3d &m) const
+{
+	this->vertices->drawArrays(!this->edges && m.matrix().determinant() < 0);
+}
+
+/*!
+	Releases the buffers of all PolySets which no longer exist, and the
+	buffers passed to release().
+	Must be called with the cache's GL context current.
+*/
+void VBOCache::purge()
+{
+	if (!this->released.empty()) {
+		glDeleteBuffers(this->released.size(), &this->released[0]);
+		this->released.clear();
+	}
+	EntryMap::iterator it = this->entries.begin();
+	while (it != this->entries.end()) {
+		if (it->second.geom.expired()) {
+			if (it->second.vbo) glDeleteBuffers(1, &it->second.vbo);
+			it = this->entries.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+}
+
+#else //NULLGL
+void VertexArray::draw(GLint *shaderinfo, bool mirrored, GLuint vbo) const {}
+void VertexArray::bind(GLint *shaderinfo, GLuint vbo) const {}
+void VertexArray::drawArrays(bool mirrored) const {}
+void VertexArray::unbind(GLint *shaderinfo, GLuint vbo) const {}
+void VBOCache::render_surface(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+															const Transform3d &m, GLint *shaderinfo) {}
+void VBOCache::render_edges(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode) {}
+void VBOCache::purge() {}
+VBOCache::Batch::Batch(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+											 GLint *shaderinfo, bool edges) {}
+VBOCache::Batch::~Batch() {}
+void VBOCache::Batch::draw(const Transform3d &m) const {}
+#endif //NULLGL
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "system-gl.h"
+#include "linalg.h"
+#include "memory.h"
+#include "renderer.h"
+
+#include <vector>
+#include <utility>
+#include <boost/weak_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+class PolySet;
+
+/*!
+	Interleaved vertex data drawn with a single glDrawArrays() call.
+	Each vertex has a position, optionally followed by a normal and the
+	four attributes used by the OpenCSG edge shader.
+*/
+class VertexArray
+{
+public:
+	VertexArray(GLenum mode = GL_TRIANGLES, bool normals = false, bool edgeattribs = false);
+
+	void addVertex(const Vector3d &p);
+	void addTriangle(const Vector3d &p0, const Vector3d &p1, const Vector3d &p2,
+									 bool e0, bool e1, bool e2, double z);
+	void draw(GLint *shaderinfo, bool mirrored, GLuint vbo = 0) const;
+	void bind(GLint *shaderinfo, GLuint vbo = 0) const;
+	void drawArrays(bool mirrored) const;
+	void unbind(GLint *shaderinfo, GLuint vbo = 0) const;
+
+	GLenum mode;
+	bool normals;
+	bool edgeattribs;
+	size_t stride; // floats per vertex
+	GLsizei count; // number of vertices
+	std::vector<GLfloat> data;
+};
+
+/*!
+	Caches the surfaces and edges of PolySets in vertex buffer objects, so
+	they're uploaded to the GPU once instead of being sent on every frame.
+
+	Entries are keyed by geometry pointer and render variant, i.e. whether edge
+	shader attributes are included and how thick 2D objects are drawn. A weak
+	reference detects when the geometry is gone; purge() then releases its
+	buffers. Mirrored transforms are handled by flipping the front face, so
+	they share the buffers.
+
+	Buffers belong to the GL context they were created in, so each GLView has
+	its own cache and makes it current while drawing. If vertex buffer objects
+	aren't supported, the vertex arrays are kept in client memory instead.
+*/
+class VBOCache
+{
+public:
+	VBOCache() {}
+	// Buffers are released together with their GL context
+	~VBOCache() {}
+
+	static VBOCache *current() { return curr; }
+	static void setCurrent(VBOCache *cache) { curr = cache; }
+
+	void render_surface(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+											const Transform3d &m, GLint *shaderinfo);
+	void render_edges(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode);
+	void purge();
+
+	/*!
+		Deletes a buffer created in this cache's GL context by its owner, the
+		next time the context is current, see purge(). Owners may be destroyed
+		while another context, or none, is current.
+	*/
+	void release(GLuint vbo) { this->released.push_back(vbo); }
+
+	/*!
+		Draws any number of instances of one PolySet's surface or edges, while
+		setting up its vertex arrays only once. The caller sets the transform
+		and color of each instance before calling draw().
+		Uses the current cache, or temporary vertex arrays if there is none.
+	*/
+	class Batch
+	{
+	public:
+		Batch(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode,
+					GLint *shaderinfo, bool edges = false);
+		~Batch();
+		void draw(const Transform3d &m) const;
+
+	private:
+		const VertexArray *vertices;
+		VertexArray local;
+		GLuint vbo;
+		GLint *shaderinfo;
+		bool edges;
+	};
+
+private:
+	struct Entry {
+		boost::weak_ptr<const PolySet> geom;
+		GLuint vbo;
+		VertexArray vertices; // Only holds data if there is no vbo
+	};
+	typedef std::pair<const PolySet *, int> Key;
+	typedef boost::unordered_map<Key, Entry> EntryMap;
+
+	static int surfaceVariant(const PolySet &ps, Renderer::csgmode_e csgmode, GLint *shaderinfo);
+	static int edgeVariant(const PolySet &ps, Renderer::csgmode_e csgmode);
+	const Entry &get(const shared_ptr<const PolySet> &ps, Renderer::csgmode_e csgmode, int variant);
+
+	EntryMap entries;
+	std::vector<GLuint> released;
+	static VBOCache *curr;
+};
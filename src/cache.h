@@ -44,33 +44,54 @@
 
 #pragma once
 
+#include <map>
+#include <utility>
 #include <boost/unordered_map.hpp>
 #include <boost/format.hpp>
 #include "printutils.h"
 
+/*!
+	Cost limited cache, evicting entries using the GreedyDual-Size policy.
+
+	Each entry has a cost (its size, which counts against maxCost()) and a
+	weight, which is how expensive it would be to recreate the object, e.g. the
+	time it took to compute. Entries are ranked by L + weight/cost, where L is
+	the rank of the last evicted entry, and the lowest ranked entry is evicted
+	first. An entry's rank is refreshed when it is accessed. Ties are broken by
+	recency, so with all weights 0 this is plain LRU.
+
+	object() counts a hit or a miss. contains() has no side effects; callers
+	which find an entry missing that way report the miss with recordMiss().
+*/
 template <class Key, class T>
 class Cache
 {
+	// Rank and access stamp; ordered lowest rank and least recently used first
+	typedef std::pair<double, unsigned long> Priority;
 	struct Node {
-		inline Node() : keyPtr(0) {}
-		inline Node(T *data, int cost)
-			: keyPtr(0), t(data), c(cost), p(0), n(0) {}
-		const Key *keyPtr; T *t; int c; Node *p,*n;
+		inline Node() : keyPtr(0), t(0), c(0), w(0) {}
+		inline Node(T *data, int cost, double weight)
+			: keyPtr(0), t(data), c(cost), w(weight) {}
+		const Key *keyPtr; T *t; int c; double w; Priority prio;
 	};
 	typedef typename boost::unordered_map<Key, Node> map_type;
 	typedef typename map_type::iterator iterator_type;
 	typedef typename map_type::value_type value_type;
+	typedef std::map<Priority, Node *> queue_type;
 
-	boost::unordered_map<Key, Node> hash;
-	Node *f, *l;
-	void *unused;
+	map_type hash;
+	queue_type queue;
+	double inflation;
+	unsigned long stamp;
 	int mx, total;
+	size_t nhits, nmisses, nevictions;
 
+	inline void prioritize(Node &n) {
+		n.prio = Priority(inflation + (n.c > 0 ? n.w / n.c : n.w), stamp++);
+		queue[n.prio] = &n;
+	}
 	inline void unlink(Node &n) {
-		if (n.p) n.p->n = n.n;
-		if (n.n) n.n->p = n.p;
-		if (l == &n) l = n.p;
-		if (f == &n) f = n.n;
+		queue.erase(n.prio);
 		total -= n.c;
 		T *obj = n.t;
 		hash.erase(*n.keyPtr);
@@ -78,24 +99,21 @@ class Cache
 	}
 	inline T *relink(const Key &key) {
 		iterator_type i = hash.find(key);
-		if (i == hash.end()) return 0;
+		if (i == hash.end()) {
+			nmisses++;
+			return 0;
+		}
+		nhits++;
 
 		Node &n = i->second;
-		if (f != &n) {
-			if (n.p) n.p->n = n.n;
-			if (n.n) n.n->p = n.p;
-			if (l == &n) l = n.p;
-			n.p = 0;
-			n.n = f;
-			f->p = &n;
-			f = &n;
-		}
+		queue.erase(n.prio);
+		prioritize(n);
 		return n.t;
 	}
 
 public:
 	inline explicit Cache(int maxCost = 100)
-		: f(0), l(0), unused(0), mx(maxCost), total(0) { }
+		: inflation(0), stamp(0), mx(maxCost), total(0), nhits(0), nmisses(0), nevictions(0) { }
 	inline ~Cache() { clear(); }
 
 	inline int maxCost() const { return mx; }
@@ -105,14 +123,19 @@ public:
 	inline int size() const { return hash.size(); }
 	inline bool empty() const { return hash.empty(); }
 
+	inline size_t hits() const { return nhits; }
+	inline size_t misses() const { return nmisses; }
+	inline size_t evictions() const { return nevictions; }
+
 	void clear() {
-		while (f) { delete f->t; f = f->n; }
-		hash.clear(); l = 0; total = 0;
+		for (iterator_type i = hash.begin(); i != hash.end(); ++i) delete i->second.t;
+		hash.clear(); queue.clear(); total = 0; inflation = 0;
 	}
 
-	bool insert(const Key &key, T *object, int cost = 1);
+	bool insert(const Key &key, T *object, int cost = 1, double weight = 0);
 	T *object(const Key &key) const { return const_cast<Cache<Key,T>*>(this)->relink(key); }
 	inline bool contains(const Key &key) const { return hash.find(key) != hash.end(); }
+	inline void recordMiss() { nmisses++; }
 	T *operator[](const Key &key) const { return object(key); }
 
 	bool remove(const Key &key);
@@ -140,7 +163,7 @@ inline T *Cache<Key,T>::take(const Key &key)
 	iterator_type i = hash.find(key);
 	if (i == hash.end()) return 0;
 
-	Node &n = *i;
+	Node &n = i->second;
 	T *t = n.t;
 	n.t = 0;
 	unlink(n);
@@ -148,7 +171,7 @@ inline T *Cache<Key,T>::take(const Key &key)
 }
 
 template <class Key, class T>
-bool Cache<Key,T>::insert(const Key &akey, T *aobject, int acost)
+bool Cache<Key,T>::insert(const Key &akey, T *aobject, int acost, double aweight)
 {
 	remove(akey);
 	if (acost > mx) {
@@ -156,29 +179,26 @@ bool Cache<Key,T>::insert(const Key &akey, T *aobject, int acost)
 		return false;
 	}
 	trim(mx - acost);
-	Node node(aobject, acost);
+	Node node(aobject, acost, aweight);
 	hash[akey] = node;
 	iterator_type i = hash.find(akey);
 	total += acost;
 	Node *n = &i->second;
 	n->keyPtr = &i->first;
-	if (f) f->p = n;
-	n->n = f;
-	f = n;
-	if (!l) l = f;
+	prioritize(*n);
 	return true;
 }
 
 template <class Key, class T>
 void Cache<Key,T>::trim(int m)
 {
-	Node *n = l;
-	while (n && total > m) {
-		Node *u = n;
-		n = n->p;
+	while (!queue.empty() && total > m) {
+		Node *u = queue.begin()->second;
+		inflation = u->prio.first;
 #ifdef DEBUG
 		PRINTB("Trimming cache: %1% (%2% bytes)", u->keyPtr->substr(0, 40) % u->c);
 #endif
+		nevictions++;
 		unlink(*u);
 	}
 }
@@ -0,0 +1,185 @@
+#ifdef ENABLE_CGAL
+
+#include "cgalutils.h"
+#include "polyset.h"
+#include "polyset-utils.h"
+#include "printutils.h"
+#include "grid.h"
+#include "node.h"
+
+#include "cgal.h"
+#include <CGAL/version.h>
+
+// Polygon_mesh_processing::corefine_and_compute_*() appeared in CGAL-4.10
+#if CGAL_VERSION_NR >= CGAL_VERSION_NUMBER(4,10,0)
+#define ENABLE_COREFINEMENT
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <CGAL/Surface_mesh.h>
+#include <CGAL/boost/graph/helpers.h>
+#include <CGAL/Polygon_mesh_processing/corefinement.h>
+#include <CGAL/Polygon_mesh_processing/self_intersections.h>
+#include <CGAL/Polygon_mesh_processing/orientation.h>
+#endif
+
+#include <vector>
+#include <boost/foreach.hpp>
+
+#ifdef ENABLE_COREFINEMENT
+namespace /* anonymous */ {
+	typedef CGAL::Epeck::Point_3 MeshPoint;
+	typedef CGAL::Surface_mesh<MeshPoint> Mesh;
+	namespace PMP = CGAL::Polygon_mesh_processing;
+
+	/*!
+		Builds a triangle mesh from the PolySet. Vertices are aligned to the same
+		grid as used when creating Nef polyhedra, so both backends see the same input.
+		Returns false if the faces don't form a valid halfedge structure.
+	*/
+	bool createMeshFromPolySet(const PolySet &ps, Mesh &mesh)
+	{
+		PolySet psq(3);
+		PolysetUtils::tessellate_faces(ps, psq);
+
+		GridWelder grid(GRID_FINE, psq.polygons.size() * 3);
+		std::vector<Mesh::Vertex_index> vertices;
+		std::vector<Mesh::Vertex_index> face;
+		BOOST_FOREACH(const Polygon &p, psq.polygons) {
+			face.clear();
+			BOOST_REVERSE_FOREACH(Vector3d v, p) {
+				size_t idx = grid.align(v);
+				if (idx == vertices.size()) vertices.push_back(mesh.add_vertex(MeshPoint(v[0], v[1], v[2])));
+				face.push_back(vertices[idx]);
+			}
+			// Skip triangles which collapsed when aligning to the grid
+			if (face.size() != 3 || face[0] == face[1] || face[1] == face[2] || face[2] == face[0]) continue;
+			if (mesh.add_face(face) == Mesh::null_face()) return false;
+		}
+		return true;
+	}
+
+	/*!
+		Creates a closed, outward oriented mesh from the given geometry.
+		Returns false if the geometry doesn't bound a volume, since corefinement
+		is only defined for such meshes.
+	*/
+	bool createClosedMesh(const Geometry &geom, Mesh &mesh)
+	{
+		if (const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron *>(&geom)) {
+			PolySet ps(3);
+			if (CGALUtils::createPolySetFromNefPolyhedron3(*N->p3, ps)) return false;
+			if (!createMeshFromPolySet(ps, mesh)) return false;
+		}
+		else if (const PolySet *ps = dynamic_cast<const PolySet *>(&geom)) {
+			if (!createMeshFromPolySet(*ps, mesh)) return false;
+		}
+		else {
+			return false;
+		}
+
+		if (!CGAL::is_closed(mesh) || PMP::does_self_intersect(mesh)) return false;
+		if (!PMP::is_outward_oriented(mesh)) PMP::reverse_face_orientations(mesh);
+		return true;
+	}
+
+	void createPolySetFromMesh(const Mesh &mesh, PolySet &ps)
+	{
+		BOOST_FOREACH(Mesh::Face_index f, mesh.faces()) {
+			ps.append_poly();
+			BOOST_FOREACH(Mesh::Vertex_index v, CGAL::vertices_around_face(mesh.halfedge(f), mesh)) {
+				const MeshPoint &p = mesh.point(v);
+				ps.append_vertex(CGAL::to_double(p.x()), CGAL::to_double(p.y()), CGAL::to_double(p.z()));
+			}
+		}
+	}
+}
+#endif // ENABLE_COREFINEMENT
+
+namespace CGALUtils {
+
+/*!
+	Applies union, intersection or difference to all children using mesh
+	corefinement instead of Nef polyhedra.
+
+	Returns NULL if this isn't possible, i.e. if corefinement isn't supported by
+	the installed CGAL, for other operators, or if any non-empty child doesn't
+	bound a volume. The caller is expected to fall back to applyOperator().
+*/
+	PolySet *applyOperatorCorefine(const Geometry::ChildList &children, OpenSCADOperator op)
+	{
+#ifdef ENABLE_COREFINEMENT
+		if (op != OPENSCAD_UNION && op != OPENSCAD_INTERSECTION && op != OPENSCAD_DIFFERENCE) return NULL;
+
+		PolySet *ps = NULL;
+		CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
+		try {
+			Mesh result;
+			bool hasresult = false;
+			bool fallback = false;
+			bool first = true;
+			BOOST_FOREACH(const Geometry::ChildItem &item, children) {
+				const bool isfirst = first;
+				first = false;
+				if (item.second->isEmpty()) {
+					// Intersecting with nothing or subtracting from nothing results in nothing
+					if (op == OPENSCAD_INTERSECTION || (op == OPENSCAD_DIFFERENCE && isfirst)) {
+						hasresult = false;
+						break;
+					}
+					continue;
+				}
+
+				Mesh mesh;
+				if (!createClosedMesh(*item.second, mesh)) {
+					PRINTD("Corefinement: Child is not closed, falling back to Nef polyhedra");
+					fallback = true;
+					break;
+				}
+				if (!hasresult) {
+					result = mesh;
+					hasresult = true;
+					continue;
+				}
+
+				Mesh out;
+				bool ok = false;
+				switch (op) {
+				case OPENSCAD_UNION:
+					ok = PMP::corefine_and_compute_union(result, mesh, out);
+					break;
+				case OPENSCAD_INTERSECTION:
+					ok = PMP::corefine_and_compute_intersection(result, mesh, out);
+					break;
+				case OPENSCAD_DIFFERENCE:
+					ok = PMP::corefine_and_compute_difference(result, mesh, out);
+					break;
+				default:
+					break;
+				}
+				if (!ok) {
+					PRINTD("Corefinement: Operation failed, falling back to Nef polyhedra");
+					fallback = true;
+					break;
+				}
+				result = out;
+				item.first->progress_report();
+			}
+
+			if (!fallback) {
+				ps = new PolySet(3);
+				if (hasresult) createPolySetFromMesh(result, *ps);
+			}
+		}
+		catch (const CGAL::Failure_exception &e) {
+			PRINTB("WARNING: CGAL error in CGALUtils::applyOperatorCorefine: %s", e.what());
+			delete ps;
+			ps = NULL;
+		}
+		return ps;
+#else
+		return NULL;
+#endif
+	}
+
+}; // namespace CGALUtils
+
+#endif /* ENABLE_CGAL */
@@ -48,7 +48,7 @@ namespace /* anonymous */ {
 		void operator()(HDS& hds) {
 			CGAL_Polybuilder B(hds, true);
 		
-			Grid3d<int> grid(GRID_FINE);
+			GridWelder grid(GRID_FINE, ps.polygons.size() * 3);
 			std::vector<CGALPoint> vertices;
 			std::vector<std::vector<size_t> > indices;
 
@@ -251,7 +251,7 @@ namespace CGALUtils {
 	bool createPolyhedronFromPolySet(const PolySet &ps, Polyhedron &p)
 	{
 		bool err = false;
-		CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+		CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 		try {
 			CGAL_Build_PolySet<Polyhedron> builder(ps);
 			p.delegate(builder);
@@ -260,7 +260,6 @@ namespace CGALUtils {
 			PRINTB("CGAL error in CGALUtils::createPolyhedronFromPolySet: %s", e.what());
 			err = true;
 		}
-		CGAL::set_error_behaviour(old_behaviour);
 		return err;
 	}
 
@@ -26,13 +26,29 @@
 #include "svg.h"
 #include "Reindexer.h"
 #include "GeometryUtils.h"
+#include "parallel.h"
+#include "ConvexDecompositionCache.h"
+#include "Tree.h"
+#include "GeometryProfiler.h"
 
 #include <map>
+#include <algorithm>
 #include <queue>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #include <boost/unordered_set.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <sstream>
 
 namespace /* anonymous */ {
+	boost::mutex detached_copy_mutex;
+
+	// See CGALUtils::ErrorBehaviourGuard
+	boost::mutex error_behaviour_mutex;
+	int error_behaviour_users = 0;
+	CGAL::Failure_behaviour saved_error_behaviour;
+
 	template<typename Result, typename V>
 	Result vector_convert(V const& v) {
 		return Result(CGAL::to_double(v[0]),CGAL::to_double(v[1]),CGAL::to_double(v[2]));
@@ -75,7 +91,7 @@ static CGAL_Nef_polyhedron *createNefPolyhedronFromPolySet(const PolySet &ps)
 
 	CGAL_Nef_polyhedron3 *N = NULL;
 	bool plane_error = false;
-	CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+	CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 	try {
 		CGAL_Polyhedron P;
 		bool err = CGALUtils::createPolyhedronFromPolySet(psq, P);
@@ -107,7 +123,6 @@ static CGAL_Nef_polyhedron *createNefPolyhedronFromPolySet(const PolySet &ps)
 		catch (const CGAL::Assertion_exception &e) {
 			PRINTB("ERROR: Alternate construction failed. CGAL error in CGAL_Nef_polyhedron3(): %s", e.what());
 		}
-	CGAL::set_error_behaviour(old_behaviour);
 	return new CGAL_Nef_polyhedron(N);
 }
 
@@ -201,7 +216,7 @@ namespace CGALUtils {
 		// Apply hull
 		bool success = false;
 		if (points.size() >= 4) {
-			CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+			CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 			try {
 				CGAL::Polyhedron_3<K> r;
 				CGAL::convex_hull_3(points.begin(), points.end(), r);
@@ -214,7 +229,6 @@ namespace CGALUtils {
 			catch (const CGAL::Assertion_exception &e) {
 				PRINTB("ERROR: CGAL error in applyHull(): %s", e.what());
 			}
-			CGAL::set_error_behaviour(old_behaviour);
 		}
 		return success;
 	}
@@ -255,10 +269,109 @@ namespace CGALUtils {
 		return visited.size() == p.size_of_facets();
 	}
 
+	namespace {
+		typedef CGAL::Epick Hull_kernel;
+		typedef std::vector<Hull_kernel::Point_3> HullPoints;
+		typedef CGAL::Polyhedron_3<Hull_kernel> HullPolyhedron;
+
+		/*!
+			Computes the convex hull of the Minkowski sum of two convex parts given
+			by their vertices. Returns false if the sum is degenerate.
+			Called from worker threads, so only inexact data may be used here.
+		*/
+		bool minkowskiHull(const HullPoints &points0, const HullPoints &points1, HullPolyhedron &result)
+		{
+			std::vector<Hull_kernel::Point_3> minkowski_points;
+			minkowski_points.reserve(points0.size() * points1.size());
+			for (size_t i = 0; i < points0.size(); i++) {
+				for (size_t j = 0; j < points1.size(); j++) {
+					minkowski_points.push_back(points0[i]+(points1[j]-CGAL::ORIGIN));
+				}
+			}
+
+			if (minkowski_points.size() <= 3) return false;
+
+			CGAL::convex_hull_3(minkowski_points.begin(), minkowski_points.end(), result);
+
+			std::vector<Hull_kernel::Point_3> strict_points;
+			strict_points.reserve(minkowski_points.size());
+
+			for (HullPolyhedron::Vertex_iterator i = result.vertices_begin(); i != result.vertices_end(); ++i) {
+				Hull_kernel::Point_3 const& p = i->point();
+
+				HullPolyhedron::Vertex::Halfedge_handle h,e;
+				h = i->halfedge();
+				e = h;
+				bool collinear = false;
+				bool coplanar = true;
+
+				do {
+					Hull_kernel::Point_3 const& q = h->opposite()->vertex()->point();
+					if (coplanar && !CGAL::coplanar(p,q,
+													h->next_on_vertex()->opposite()->vertex()->point(),
+													h->next_on_vertex()->next_on_vertex()->opposite()->vertex()->point())) {
+						coplanar = false;
+					}
+
+
+					for (HullPolyhedron::Vertex::Halfedge_handle j = h->next_on_vertex();
+						 j != h && !collinear && ! coplanar;
+						 j = j->next_on_vertex()) {
+
+						Hull_kernel::Point_3 const& r = j->opposite()->vertex()->point();
+						if (CGAL::collinear(p,q,r)) {
+							collinear = true;
+						}
+					}
+
+					h = h->next_on_vertex();
+				} while (h != e && !collinear);
+
+				if (!collinear && !coplanar)
+					strict_points.push_back(p);
+			}
+
+			result.clear();
+			CGAL::convex_hull_3(strict_points.begin(), strict_points.end(), result);
+			return true;
+		}
+
+		void minkowskiHullTask(const std::vector<HullPoints> *parts0, const std::vector<HullPoints> *parts1,
+													 std::vector<HullPolyhedron> *hulls, std::vector<char> *valid, size_t idx)
+		{
+			(*valid)[idx] = minkowskiHull((*parts0)[idx / parts1->size()], (*parts1)[idx % parts1->size()], (*hulls)[idx]);
+		}
+
+		void hullPolySetTask(const std::vector<HullPolyhedron> *hulls, std::vector<PolySet> *polysets, size_t idx)
+		{
+			createPolySetFromPolyhedron((*hulls)[idx], (*polysets)[idx]);
+		}
+
+		/*!
+			Unions the convex hulls. Only the conversion of the inexact hulls to
+			PolySets is spread across threads; the exact Nef polyhedra are created
+			and unioned in the calling thread.
+		*/
+		CGAL_Nef_polyhedron *unionHulls(const std::vector<HullPolyhedron> &hulls)
+		{
+			std::vector<PolySet> polysets(hulls.size(), PolySet(3, true));
+			Parallel::for_each_index(hulls.size(), boost::bind(&hullPolySetTask, &hulls, &polysets, _1));
+
+			Geometry::ChildList fake_children;
+			BOOST_FOREACH(const PolySet &ps, polysets) {
+				fake_children.push_back(std::make_pair((const AbstractNode*)NULL,
+																							 shared_ptr<const Geometry>(createNefPolyhedronFromGeometry(ps))));
+			}
+			return CGALUtils::applyOperator(fake_children, OPENSCAD_UNION);
+		}
+	}
+
 	/*!
-		children cannot contain NULL objects
+		children cannot contain NULL objects.
+		If tree is given, convex decompositions of the children are cached by their
+		node ID string.
 	*/
-	Geometry const * applyMinkowski(const Geometry::ChildList &children)
+	Geometry const * applyMinkowski(const Geometry::ChildList &children, const Tree *tree)
 	{
 		CGAL::Timer t,t_tot;
 		assert(children.size() >= 2);
@@ -269,12 +382,20 @@ namespace CGALUtils {
 			while (++it != children.end()) {
 				operands[1] = it->second.get();
 
-				typedef CGAL::Epick Hull_kernel;
-
-				std::list<CGAL_Polyhedron> P[2];
-				std::list<CGAL::Polyhedron_3<Hull_kernel> > result_parts;
+				std::vector<HullPolyhedron> result_parts;
+				shared_ptr<const ConvexDecompositionCache::Parts> parts[2];
 
 				for (int i = 0; i < 2; i++) {
+					// Operands which are child nodes (rather than intermediate results)
+					// may have been decomposed before
+					std::string key;
+					if (tree && (i == 1 || it == boost::next(children.begin()))) {
+						key = tree->getIdString(*(i == 1 ? it : children.begin())->first);
+						parts[i] = ConvexDecompositionCache::instance()->get(key);
+						if (parts[i]) continue;
+					}
+
+					std::list<CGAL_Polyhedron> P;
 					CGAL_Polyhedron poly;
 
 					const PolySet * ps = dynamic_cast<const PolySet *>(operands[i]);
@@ -288,7 +409,7 @@ namespace CGALUtils {
 					if ((ps && ps->is_convex()) ||
 							(!ps && is_weakly_convex(poly))) {
 						PRINTDB("Minkowski: child %d is convex and %s",i % (ps?"PolySet":"Nef"));
-						P[i].push_back(poly);
+						P.push_back(poly);
 					} else {
 						CGAL_Nef_polyhedron3 decomposed_nef;
 
@@ -311,111 +432,46 @@ namespace CGALUtils {
 							if(ci->mark()) {
 								CGAL_Polyhedron poly;
 								decomposed_nef.convert_inner_shell_to_polyhedron(ci->shells_begin(), poly);
-								P[i].push_back(poly);
+								P.push_back(poly);
 							}
 						}
 
 
-						PRINTDB("Minkowski: decomposed into %d convex parts", P[i].size());
+						PRINTDB("Minkowski: decomposed into %d convex parts", P.size());
 						t.stop();
 						PRINTDB("Minkowski: decomposition took %f s", t.time());
 					}
-				}
-
-				std::vector<Hull_kernel::Point_3> points[2];
-				std::vector<Hull_kernel::Point_3> minkowski_points;
-
-				for (size_t i = 0; i < P[0].size(); i++) {
-					for (size_t j = 0; j < P[1].size(); j++) {
-						t.start();
-						points[0].clear();
-						points[1].clear();
-
-						for (int k = 0; k < 2; k++) {
-							std::list<CGAL_Polyhedron>::iterator it = P[k].begin();
-							std::advance(it, k==0?i:j);
-
-							CGAL_Polyhedron const& poly = *it;
-							points[k].reserve(poly.size_of_vertices());
-
-							for (CGAL_Polyhedron::Vertex_const_iterator pi = poly.vertices_begin(); pi != poly.vertices_end(); ++pi) {
-								CGAL_Polyhedron::Point_3 const& p = pi->point();
-								points[k].push_back(Hull_kernel::Point_3(to_double(p[0]),to_double(p[1]),to_double(p[2])));
-							}
-						}
-
-						minkowski_points.clear();
-						minkowski_points.reserve(points[0].size() * points[1].size());
-						for (int i = 0; i < points[0].size(); i++) {
-							for (int j = 0; j < points[1].size(); j++) {
-								minkowski_points.push_back(points[0][i]+(points[1][j]-CGAL::ORIGIN));
-							}
-						}
-
-						if (minkowski_points.size() <= 3) {
-							t.stop();
-							continue;
-						}
-
-
-						CGAL::Polyhedron_3<Hull_kernel> result;
-						t.stop();
-						PRINTDB("Minkowski: Point cloud creation (%d ⨉ %d -> %d) took %f ms", points[0].size() % points[1].size() % minkowski_points.size() % (t.time()*1000));
-						t.reset();
-
-						t.start();
-
-						CGAL::convex_hull_3(minkowski_points.begin(), minkowski_points.end(), result);
-
-						std::vector<Hull_kernel::Point_3> strict_points;
-						strict_points.reserve(minkowski_points.size());
-
-						for (CGAL::Polyhedron_3<Hull_kernel>::Vertex_iterator i = result.vertices_begin(); i != result.vertices_end(); ++i) {
-							Hull_kernel::Point_3 const& p = i->point();
-
-							CGAL::Polyhedron_3<Hull_kernel>::Vertex::Halfedge_handle h,e;
-							h = i->halfedge();
-							e = h;
-							bool collinear = false;
-							bool coplanar = true;
-
-							do {
-								Hull_kernel::Point_3 const& q = h->opposite()->vertex()->point();
-								if (coplanar && !CGAL::coplanar(p,q,
-																h->next_on_vertex()->opposite()->vertex()->point(),
-																h->next_on_vertex()->next_on_vertex()->opposite()->vertex()->point())) {
-									coplanar = false;
-								}
 
-
-								for (CGAL::Polyhedron_3<Hull_kernel>::Vertex::Halfedge_handle j = h->next_on_vertex();
-									 j != h && !collinear && ! coplanar;
-									 j = j->next_on_vertex()) {
-
-									Hull_kernel::Point_3 const& r = j->opposite()->vertex()->point();
-									if (CGAL::collinear(p,q,r)) {
-										collinear = true;
-									}
-								}
-
-								h = h->next_on_vertex();
-							} while (h != e && !collinear);
-
-							if (!collinear && !coplanar)
-								strict_points.push_back(p);
+					// Convert all parts to inexact points up front. Exact coordinates use
+					// non thread-safe reference counting, so this must be done serially.
+					shared_ptr<ConvexDecompositionCache::Parts> newparts(new ConvexDecompositionCache::Parts);
+					BOOST_FOREACH(const CGAL_Polyhedron &poly, P) {
+						newparts->push_back(HullPoints());
+						newparts->back().reserve(poly.size_of_vertices());
+						for (CGAL_Polyhedron::Vertex_const_iterator pi = poly.vertices_begin(); pi != poly.vertices_end(); ++pi) {
+							CGAL_Polyhedron::Point_3 const& p = pi->point();
+							newparts->back().push_back(Hull_kernel::Point_3(to_double(p[0]),to_double(p[1]),to_double(p[2])));
 						}
-
-						result.clear();
-						CGAL::convex_hull_3(strict_points.begin(), strict_points.end(), result);
-
-
-						t.stop();
-						PRINTDB("Minkowski: Computing convex hull took %f s", t.time());
-						t.reset();
-
-						result_parts.push_back(result);
 					}
+					parts[i] = newparts;
+					if (!key.empty()) ConvexDecompositionCache::instance()->insert(key, parts[i]);
+				}
+
+				t.start();
+				size_t numpairs = parts[0]->size() * parts[1]->size();
+				std::vector<HullPolyhedron> hulls(numpairs);
+				std::vector<char> valid(numpairs, false);
+				{
+					// Set once for all threads
+					CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
+					Parallel::for_each_index(numpairs, boost::bind(&minkowskiHullTask, parts[0].get(), parts[1].get(), &hulls, &valid, _1));
+				}
+				for (size_t i = 0; i < numpairs; i++) {
+					if (valid[i]) result_parts.push_back(hulls[i]);
 				}
+				t.stop();
+				PRINTDB("Minkowski: Computing %d convex hulls took %f s", numpairs % t.time());
+				t.reset();
 
 				if (it != boost::next(children.begin()))
 					delete operands[0];
@@ -427,14 +483,7 @@ namespace CGALUtils {
 				} else if (!result_parts.empty()) {
 					t.start();
 					PRINTDB("Minkowski: Computing union of %d parts",result_parts.size());
-					Geometry::ChildList fake_children;
-					for (std::list<CGAL::Polyhedron_3<Hull_kernel> >::iterator i = result_parts.begin(); i != result_parts.end(); ++i) {
-						PolySet ps(3,true);
-						createPolySetFromPolyhedron(*i, ps);
-						fake_children.push_back(std::make_pair((const AbstractNode*)NULL,
-															   shared_ptr<const Geometry>(createNefPolyhedronFromGeometry(ps))));
-					}
-					CGAL_Nef_polyhedron *N = CGALUtils::applyOperator(fake_children, OPENSCAD_UNION);
+					CGAL_Nef_polyhedron *N = unionHulls(result_parts);
 					// FIXME: This hould really never throw.
 					// Assert once we figured out what went wrong with issue #1069?
 					if (!N) throw 0;
@@ -461,6 +510,91 @@ namespace CGALUtils {
 		}
 	}
 	
+	namespace {
+		/*
+			Returns false if the boxes are separated along some axis. Touching boxes
+			count as overlapping since the operation may still affect the shared boundary.
+		*/
+		bool bboxesOverlap(const CGAL_Iso_cuboid_3 &a, const CGAL_Iso_cuboid_3 &b)
+		{
+			for (int i=0;i<3;i++) {
+				if (a.max_coord(i) < b.min_coord(i) || b.max_coord(i) < a.min_coord(i)) return false;
+			}
+			return true;
+		}
+
+		typedef std::pair<NT3, shared_ptr<const CGAL_Nef_polyhedron> > SizedNef;
+
+		bool compareSize(const SizedNef &a, const SizedNef &b)
+		{
+			return a.first < b.first;
+		}
+
+		/*!
+			Subtracts the union of all but the first operand from the first operand.
+			Operands which don't overlap the first one are skipped.
+		*/
+		CGAL_Nef_polyhedron *applyDifference(const std::vector<shared_ptr<const CGAL_Nef_polyhedron> > &operands)
+		{
+			const CGAL_Nef_polyhedron &first = *operands[0];
+			if (first.isEmpty()) return new CGAL_Nef_polyhedron(first);
+			CGAL_Iso_cuboid_3 bbox = boundingBox(*first.p3);
+
+			CGAL::Nef_nary_union_3<CGAL_Nef_polyhedron3> nary_union;
+			int nary_union_num_inserted = 0;
+			for (size_t i=1;i<operands.size();i++) {
+				const CGAL_Nef_polyhedron &chN = *operands[i];
+				if (chN.isEmpty() || !bboxesOverlap(bbox, boundingBox(*chN.p3))) continue;
+				nary_union.add_polyhedron(*chN.p3);
+				nary_union_num_inserted++;
+			}
+
+			CGAL_Nef_polyhedron *N = new CGAL_Nef_polyhedron(first);
+			if (nary_union_num_inserted > 0) {
+				*N -= CGAL_Nef_polyhedron(new CGAL_Nef_polyhedron3(nary_union.get_union()));
+			}
+			return N;
+		}
+
+		/*!
+			Intersects operands pairwise in a balanced tree, smallest bounding boxes first,
+			so the intermediate results stay small. Stops as soon as the result is
+			known to be empty.
+		*/
+		CGAL_Nef_polyhedron *applyIntersection(const std::vector<shared_ptr<const CGAL_Nef_polyhedron> > &operands)
+		{
+			std::vector<SizedNef> sized;
+			CGAL_Iso_cuboid_3 bbox;
+			BOOST_FOREACH(const shared_ptr<const CGAL_Nef_polyhedron> &chN, operands) {
+				// Intersecting something with nothing results in nothing
+				if (chN->isEmpty()) return new CGAL_Nef_polyhedron(*chN);
+				CGAL_Iso_cuboid_3 chbbox = boundingBox(*chN->p3);
+				if (sized.empty()) bbox = chbbox;
+				else if (!bboxesOverlap(bbox, chbbox)) return new CGAL_Nef_polyhedron(new CGAL_Nef_polyhedron3());
+				else bbox = CGAL_Iso_cuboid_3(
+					std::max(bbox.xmin(), chbbox.xmin()), std::max(bbox.ymin(), chbbox.ymin()), std::max(bbox.zmin(), chbbox.zmin()),
+					std::min(bbox.xmax(), chbbox.xmax()), std::min(bbox.ymax(), chbbox.ymax()), std::min(bbox.zmax(), chbbox.zmax()));
+				sized.push_back(SizedNef(chbbox.volume(), chN));
+			}
+			std::stable_sort(sized.begin(), sized.end(), compareSize);
+
+			std::vector<shared_ptr<const CGAL_Nef_polyhedron> > level;
+			BOOST_FOREACH(const SizedNef &item, sized) level.push_back(item.second);
+			while (level.size() > 1) {
+				std::vector<shared_ptr<const CGAL_Nef_polyhedron> > next;
+				for (size_t i=0;i+1<level.size();i+=2) {
+					CGAL_Nef_polyhedron *N = new CGAL_Nef_polyhedron(*level[i]);
+					*N *= *level[i+1];
+					if (N->isEmpty()) return N;
+					next.push_back(shared_ptr<const CGAL_Nef_polyhedron>(N));
+				}
+				if (level.size() % 2) next.push_back(level.back());
+				level.swap(next);
+			}
+			return new CGAL_Nef_polyhedron(*level[0]);
+		}
+	}
+
 /*!
 	Applies op to all children and returns the result.
 	The child list should be guaranteed to contain non-NULL 3D or empty Geometry objects
@@ -468,11 +602,12 @@ namespace CGALUtils {
 	CGAL_Nef_polyhedron *applyOperator(const Geometry::ChildList &children, OpenSCADOperator op)
 	{
 		CGAL_Nef_polyhedron *N = NULL;
-		CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+		CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 		try {
 			// Speeds up n-ary union operations significantly
 			CGAL::Nef_nary_union_3<CGAL_Nef_polyhedron3> nary_union;
 			int nary_union_num_inserted = 0;
+			std::vector<shared_ptr<const CGAL_Nef_polyhedron> > operands;
 			
 			BOOST_FOREACH(const Geometry::ChildItem &item, children) {
 				const shared_ptr<const Geometry> &chgeom = item.second;
@@ -492,28 +627,22 @@ namespace CGALUtils {
 					}
 					continue;
 				}
+				// Difference and intersection are reduced once all operands are known
+				if (op == OPENSCAD_DIFFERENCE || op == OPENSCAD_INTERSECTION) {
+					operands.push_back(chN);
+					item.first->progress_report();
+					continue;
+				}
 				// Initialize N with first expected geometric object
 				if (!N) {
 					N = new CGAL_Nef_polyhedron(*chN);
 					continue;
 				}
 				
-				// Intersecting something with nothing results in nothing
-				if (chN->isEmpty()) {
-					if (op == OPENSCAD_INTERSECTION) *N = *chN;
-					continue;
-				}
-				
 				// empty op <something> => empty
-				if (N->isEmpty()) continue;
+				if (chN->isEmpty() || N->isEmpty()) continue;
 				
 				switch (op) {
-				case OPENSCAD_INTERSECTION:
-					*N *= *chN;
-					break;
-				case OPENSCAD_DIFFERENCE:
-					*N -= *chN;
-					break;
 				case OPENSCAD_MINKOWSKI:
 					N->minkowski(*chN);
 					break;
@@ -526,13 +655,15 @@ namespace CGALUtils {
 			if (op == OPENSCAD_UNION && nary_union_num_inserted > 0) {
 				N = new CGAL_Nef_polyhedron(new CGAL_Nef_polyhedron3(nary_union.get_union()));
 			}
+			else if (!operands.empty()) {
+				N = op == OPENSCAD_DIFFERENCE ? applyDifference(operands) : applyIntersection(operands);
+			}
 		}
 	// union && difference assert triggered by testdata/scad/bugs/rotate-diff-nonmanifold-crash.scad and testdata/scad/bugs/issue204.scad
 		catch (const CGAL::Failure_exception &e) {
 			std::string opstr = op == OPENSCAD_INTERSECTION ? "intersection" : op == OPENSCAD_DIFFERENCE ? "difference" : op == OPENSCAD_UNION ? "union" : "UNKNOWN";
 			PRINTB("ERROR: CGAL error in CGALUtils::applyBinaryOperator %s: %s", opstr % e.what());
 		}
-		CGAL::set_error_behaviour(old_behaviour);
 		return N;
 	}
 
@@ -557,7 +688,7 @@ namespace CGALUtils {
 		if (target.isEmpty() && op != OPENSCAD_UNION) return; // empty op <something> => empty
 		if (target.getDimension() != src.getDimension()) return; // If someone tries to e.g. union 2d and 3d objects
 
-		CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+		CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 		try {
 			switch (op) {
 			case OPENSCAD_UNION:
@@ -585,7 +716,6 @@ namespace CGALUtils {
 			// Errors can result in corrupt polyhedrons, so put back the old one
 			target = src;
 		}
-		CGAL::set_error_behaviour(old_behaviour);
 	}
 #endif
 
@@ -645,7 +775,7 @@ namespace CGALUtils {
 
 		CGAL_Nef_polyhedron newN;
 		if (cut) {
-			CGAL::Failure_behaviour old_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+			CGALUtils::ErrorBehaviourGuard error_behaviour_guard;
 			try {
 				CGAL_Nef_polyhedron3::Plane_3 xy_plane = CGAL_Nef_polyhedron3::Plane_3(0,0,1,0);
 				newN.p3.reset(new CGAL_Nef_polyhedron3(N.p3->intersection(xy_plane, CGAL_Nef_polyhedron3::PLANE_ONLY)));
@@ -673,7 +803,6 @@ namespace CGALUtils {
 			}
 				
 			if (!newN.p3 || newN.p3->is_empty()) {
-				CGAL::set_error_behaviour(old_behaviour);
 				PRINT("WARNING: projection() failed.");
 				return poly;
 			}
@@ -700,7 +829,6 @@ namespace CGALUtils {
 			}
 			PRINTD("</svg>");
 				
-			CGAL::set_error_behaviour(old_behaviour);
 		}
 		// In projection mode all the triangles are projected manually into the XY plane
 		else {
@@ -1145,6 +1273,7 @@ namespace CGALUtils {
 #if 1
 	bool createPolySetFromNefPolyhedron3(const CGAL_Nef_polyhedron3 &N, PolySet &ps)
 	{
+		GeometryProfiler::Timer timer("createPolySetFromNefPolyhedron3");
 		// 1. Build Indexed PolyMesh
 		// 2. Validate mesh (manifoldness)
 		// 3. Triangulate each face
@@ -1276,6 +1405,7 @@ namespace CGALUtils {
 #endif
 	CGAL_Nef_polyhedron *createNefPolyhedronFromGeometry(const Geometry &geom)
 	{
+		GeometryProfiler::Timer timer("createNefPolyhedronFromGeometry");
 		const PolySet *ps = dynamic_cast<const PolySet*>(&geom);
 		if (ps) {
 			return createNefPolyhedronFromPolySet(*ps);
@@ -1287,6 +1417,43 @@ namespace CGALUtils {
 		assert(false && "createNefPolyhedronFromGeometry(): Unsupported geometry type");
 		return NULL;
 	}
+
+	/*!
+		Returns a copy of N which shares no exact numbers with N.
+
+		Copying a Nef polyhedron only copies handles to its reference counted
+		exact coordinates, and these reference counts aren't thread safe. A copy
+		which is to be used by another thread than the original must therefore be
+		rebuilt from scratch. Reading N can still modify its reference counts, so
+		all callers are serialized.
+	*/
+	CGAL_Nef_polyhedron *detachedCopy(const CGAL_Nef_polyhedron &N)
+	{
+		CGAL_Nef_polyhedron *copy = new CGAL_Nef_polyhedron();
+		copy->setConvexity(N.getConvexity());
+		if (!N.p3) return copy;
+
+		std::stringstream stream;
+		{
+			boost::lock_guard<boost::mutex> lock(detached_copy_mutex);
+			stream << *N.p3;
+		}
+		copy->p3.reset(new CGAL_Nef_polyhedron3);
+		stream >> *copy->p3;
+		return copy;
+	}
+
+	ErrorBehaviourGuard::ErrorBehaviourGuard()
+	{
+		boost::lock_guard<boost::mutex> lock(error_behaviour_mutex);
+		if (error_behaviour_users++ == 0) saved_error_behaviour = CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
+	}
+
+	ErrorBehaviourGuard::~ErrorBehaviourGuard()
+	{
+		boost::lock_guard<boost::mutex> lock(error_behaviour_mutex);
+		if (--error_behaviour_users == 0) CGAL::set_error_behaviour(saved_error_behaviour);
+	}
 }; // namespace CGALUtils
 
 
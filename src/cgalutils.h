@@ -11,15 +11,18 @@ typedef CGAL::Point_3<K> Vertex3K;
 typedef std::vector<Vertex3K> PolygonK;
 typedef std::vector<PolygonK> PolyholeK;
 
+class Tree;
+
 namespace CGALUtils {
 	bool applyHull(const Geometry::ChildList &children, PolySet &P);
 	CGAL_Nef_polyhedron *applyOperator(const Geometry::ChildList &children, OpenSCADOperator op);
+	PolySet *applyOperatorCorefine(const Geometry::ChildList &children, OpenSCADOperator op);
 	//FIXME: Old, can be removed:
 	//void applyBinaryOperator(CGAL_Nef_polyhedron &target, const CGAL_Nef_polyhedron &src, OpenSCADOperator op);
 	Polygon2d *project(const CGAL_Nef_polyhedron &N, bool cut);
 	CGAL_Iso_cuboid_3 boundingBox(const CGAL_Nef_polyhedron3 &N);
 	bool is_approximately_convex(const PolySet &ps);
-	Geometry const* applyMinkowski(const Geometry::ChildList &children);
+	Geometry const* applyMinkowski(const Geometry::ChildList &children, const Tree *tree = NULL);
 
 	template <typename Polyhedron> std::string printPolyhedron(const Polyhedron &p);
 	template <typename Polyhedron> bool createPolySetFromPolyhedron(const Polyhedron &p, PolySet &ps);
@@ -39,4 +42,21 @@ namespace CGALUtils {
 	bool tessellate3DFaceWithHoles(std::vector<CGAL_Polygon_3> &polygons, 
 																 std::vector<CGAL_Polygon_3> &triangles,
 																 CGAL::Plane_3<CGAL_Kernel3> &plane);
+
+	CGAL_Nef_polyhedron *detachedCopy(const CGAL_Nef_polyhedron &N);
+
+	/*!
+		Makes CGAL throw exceptions on failed assertions while in scope.
+
+		The error behaviour is a process-wide setting, so guards are counted:
+		the first guard sets it and the last one to go out of scope restores it.
+		Code which runs CGAL on several threads should hold a guard around the
+		whole parallel region, so the setting doesn't change while it runs.
+	*/
+	class ErrorBehaviourGuard
+	{
+	public:
+		ErrorBehaviourGuard();
+		~ErrorBehaviourGuard();
+	};
 };
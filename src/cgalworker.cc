@@ -3,6 +3,8 @@
 
 #include "Tree.h"
 #include "GeometryEvaluator.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "CGALRenderBuffer.h"
 #include "progress.h"
 #include "printutils.h"
 
@@ -28,14 +30,20 @@ void CGALWorker::start(const Tree &tree)
 void CGALWorker::work()
 {
 	shared_ptr<const Geometry> root_geom;
+	shared_ptr<CGALRenderBuffer> buffer;
 	try {
 		GeometryEvaluator evaluator(*this->tree);
 		root_geom = evaluator.evaluateGeometry(*this->tree->root(), true);
+		// Convert Nef polyhedra for drawing here rather than in the GUI thread
+		shared_ptr<const CGAL_Nef_polyhedron> N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(root_geom);
+		if (N && N->getDimension() == 3 && !N->isEmpty()) {
+			buffer.reset(new CGALRenderBuffer(*N->p3));
+		}
 	}
 	catch (const ProgressCancelException &e) {
 		PRINT("Rendering cancelled.");
 	}
 
-	emit done(root_geom);
+	emit done(root_geom, buffer);
 	thread->quit();
 }
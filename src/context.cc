@@ -30,6 +30,7 @@
 #include "function.h"
 #include "module.h"
 #include "builtin.h"
+#include "functionmemo.h"
 #include "printutils.h"
 #include <boost/foreach.hpp>
 #include <boost/filesystem.hpp>
@@ -60,6 +61,7 @@ Context::Context(const Context *parent)
 		this->ctx_stack = new Stack;
 	}
 
+	this->depth = this->ctx_stack->size();
 	this->ctx_stack->push_back(this);
 }
 
@@ -128,6 +130,33 @@ void Context::apply_variables(const Context &other)
 	}
 }
 
+/*!
+	Looks up a non-config variable in this context and its parents.
+	Returns the context the variable was found in, or NULL if it's unknown.
+*/
+const Context *Context::find_variable(const std::string &name, ValuePtr &value) const
+{
+	// Walk the parent chain iteratively; this is the hottest path of expression evaluation
+	const Context *ctx = this;
+	do {
+		if (!ctx->parent) {
+			ValueMap::const_iterator found = ctx->constants.find(name);
+			if (found != ctx->constants.end()) {
+				value = found->second;
+				return ctx;
+			}
+		}
+		ValueMap::const_iterator found = ctx->variables.find(name);
+		if (found != ctx->variables.end()) {
+			value = found->second;
+			return ctx;
+		}
+		ctx = ctx->parent;
+	} while (ctx);
+	value = ValuePtr::undefined;
+	return NULL;
+}
+
 ValuePtr Context::lookup_variable(const std::string &name, bool silent) const
 {
 	if (!this->ctx_stack) {
@@ -135,22 +164,24 @@ ValuePtr Context::lookup_variable(const std::string &name, bool silent) const
 		return ValuePtr::undefined;
 	}
 	if (is_config_variable(name)) {
-		for (int i = this->ctx_stack->size()-1; i >= 0; i--) {
+		int i;
+		for (i = this->ctx_stack->size()-1; i >= 0; i--) {
 			const ValueMap &confvars = ctx_stack->at(i)->config_variables;
-			if (confvars.find(name) != confvars.end())
-				return confvars.find(name)->second;
+			ValueMap::const_iterator found = confvars.find(name);
+			if (found != confvars.end()) {
+				if (FunctionMemo::isRecording()) FunctionMemo::recordConfigLookup(name, i, found->second);
+				return found->second;
+			}
 		}
+		if (FunctionMemo::isRecording()) FunctionMemo::recordConfigLookup(name, i, ValuePtr::undefined);
 		return ValuePtr::undefined;
 	}
-	if (!this->parent && this->constants.find(name) != this->constants.end())
-		return this->constants.find(name)->second;
-	if (this->variables.find(name) != this->variables.end())
-		return this->variables.find(name)->second;
-	if (this->parent)
-		return this->parent->lookup_variable(name, silent);
-	if (!silent)
+	ValuePtr value;
+	const Context *ctx = find_variable(name, value);
+	if (FunctionMemo::isRecording()) FunctionMemo::recordLookup(name, ctx, value);
+	if (!ctx && !silent)
 		PRINTB("WARNING: Ignoring unknown variable '%s'.", name);
-	return ValuePtr::undefined;
+	return value;
 }
 
 bool Context::has_local_variable(const std::string &name) const
@@ -37,8 +37,12 @@ public:
 public:
 
 protected:
+	const Context *find_variable(const std::string &name, ValuePtr &value) const;
+
 	const Context *parent;
 	Stack *ctx_stack;
+	// Index of this context in ctx_stack
+	int depth;
 
 	typedef boost::unordered_map<std::string, ValuePtr> ValueMap;
 	ValueMap constants;
@@ -47,6 +51,8 @@ protected:
 
 	std::string document_path; // FIXME: This is a remnant only needed by dxfdim
 
+	friend class FunctionMemo;
+
 public:
 #ifdef DEBUG
 	virtual std::string dump(const class AbstractModule *mod, const ModuleInstantiation *inst);
@@ -2,6 +2,27 @@
 #include "csgterm.h"
 #include "printutils.h"
 
+namespace {
+	bool overlaps(const BoundingBox &a, const BoundingBox &b)
+	{
+		Vector3d newmin = a.min().array().cwiseMax( b.min().array() );
+		Vector3d newmax = a.max().array().cwiseMin( b.max().array() );
+		return !BoundingBox( newmin, newmax ).isNull();
+	}
+
+	// Terms may be shared between products, so they're copied instead of
+	// being modified in place
+	shared_ptr<CSGTerm> replace_children(const shared_ptr<CSGTerm> &term,
+																			 const shared_ptr<CSGTerm> &left, const shared_ptr<CSGTerm> &right)
+	{
+		if (left == term->left && right == term->right) return term;
+		shared_ptr<CSGTerm> t(new CSGTerm(*term));
+		t->left = left;
+		t->right = right;
+		return t;
+	}
+}
+
 // Helper function to debug normalization bugs
 #if 0
 static bool validate_tree(const shared_ptr<CSGTerm> &term)
@@ -16,6 +37,12 @@ static bool validate_tree(const shared_ptr<CSGTerm> &term)
 
 /*!
 	NB! for e.g. empty intersections, this can normalize a tree to nothing and return NULL.
+
+	Before a union is distributed over an intersection or difference, the
+	parts of it whose bounding boxes don't overlap the other operand are
+	dropped, so e.g. many small holes only end up in the products they
+	actually touch. Products with an empty bounding box are culled when they
+	are created, and equal subterms are shared.
 */
 shared_ptr<CSGTerm> CSGTermNormalizer::normalize(const shared_ptr<CSGTerm> &root)
 {
@@ -25,9 +52,10 @@ shared_ptr<CSGTerm> CSGTermNormalizer::normalize(const shared_ptr<CSGTerm> &root
 		this->rootnode = temp;
 		this->nodecount = 0;
 		shared_ptr<CSGTerm> n = normalizePass(temp);
-		if (!n) return n; // If normalized to nothing
-		if (temp == n) break;
+		this->normalized.clear();
+		const bool done = !n || temp == n; // n is NULL if normalized to nothing
 		temp = n;
+		if (done) break;
 
 		if (this->nodecount > this->limit) {
 			PRINTB("WARNING: Normalized tree is growing past %d elements. Aborting normalization.\n", this->limit);
@@ -38,10 +66,13 @@ shared_ptr<CSGTerm> CSGTermNormalizer::normalize(const shared_ptr<CSGTerm> &root
 				newroot = collapse_null_terms(tmproot);
 			}
 			newroot = cleanup_term(newroot);
-			return newroot;
+			temp = newroot;
+			break;
 		}
 	}
 	this->rootnode.reset();
+	this->terms.clear();
+	this->unpruned.clear();
 	return temp;
 }
 
@@ -75,6 +106,9 @@ shared_ptr<CSGTerm> CSGTermNormalizer::normalizePass(shared_ptr<CSGTerm> term)
 		return term;
 	}
 
+	const shared_ptr<CSGTerm> input = term;
+	if (this->normalized.count(input.get())) return this->normalized[input.get()].second;
+
 	do {
 		while (term && match_and_replace(term)) {	}
 		this->nodecount++;
@@ -84,11 +118,12 @@ shared_ptr<CSGTerm> CSGTermNormalizer::normalizePass(shared_ptr<CSGTerm> term)
 			return shared_ptr<CSGTerm>();
 		}
 		if (!term || term->type == CSGTerm::TYPE_PRIMITIVE) return term;
-		if (term->left) term->left = normalizePass(term->left);
+		if (term->left) term = replace_children(term, normalizePass(term->left), term->right);
+		if (!term->left) break; // Pruned, collapsed below
 	} while (!this->aborted && term->type != CSGTerm::TYPE_UNION &&
 					 ((term->right && term->right->type != CSGTerm::TYPE_PRIMITIVE) ||
 						(term->left && term->left->type == CSGTerm::TYPE_UNION)));
-	if (!this->aborted) term->right = normalizePass(term->right);
+	if (!this->aborted) term = replace_children(term, term->left, normalizePass(term->right));
 
 	// FIXME: Do we need to take into account any transformation of item here?
 	shared_ptr<CSGTerm> t = collapse_null_terms(term);
@@ -96,6 +131,9 @@ shared_ptr<CSGTerm> CSGTermNormalizer::normalizePass(shared_ptr<CSGTerm> term)
 	if (this->aborted) {
 		if (t) t = cleanup_term(t);
 	}
+	else {
+		this->normalized[input.get()] = std::make_pair(input, t);
+	}
 
 	return t;
 }
@@ -119,6 +157,12 @@ bool CSGTermNormalizer::match_and_replace(shared_ptr<CSGTerm> &term)
 		return false;
 	}
 
+	if (prune_operand(term)) return true;
+
+	// If both sides are unions, distribute the left one first (rules 8 and 9),
+	// so the right one can be pruned against each of the resulting products
+	const bool leftfirst = term->left->type == CSGTerm::TYPE_UNION && term->right->type == CSGTerm::TYPE_UNION;
+
 	// Part A: The 'x . (y . z)' expressions
 
 	shared_ptr<CSGTerm> x = term->left;
@@ -128,45 +172,45 @@ bool CSGTermNormalizer::match_and_replace(shared_ptr<CSGTerm> &term)
 	shared_ptr<CSGTerm> result = term;
 
 	// 1.  x - (y + z) -> (x - y) - z
-	if (term->type == CSGTerm::TYPE_DIFFERENCE && term->right->type == CSGTerm::TYPE_UNION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, x, y),
-												 z);
+	if (!leftfirst && term->type == CSGTerm::TYPE_DIFFERENCE && term->right->type == CSGTerm::TYPE_UNION) {
+		term = createTerm(CSGTerm::TYPE_DIFFERENCE, 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, x, y),
+											z);
 		return true;
 	}
 	// 2.  x * (y + z) -> (x * y) + (x * z)
-	else if (term->type == CSGTerm::TYPE_INTERSECTION && term->right->type == CSGTerm::TYPE_UNION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, y), 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, z));
+	else if (!leftfirst && term->type == CSGTerm::TYPE_INTERSECTION && term->right->type == CSGTerm::TYPE_UNION) {
+		term = createTerm(CSGTerm::TYPE_UNION, 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, y), 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, z));
 		return true;
 	}
 	// 3.  x - (y * z) -> (x - y) + (x - z)
 	else if (term->type == CSGTerm::TYPE_DIFFERENCE && term->right->type == CSGTerm::TYPE_INTERSECTION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, x, y), 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, x, z));
+		term = createTerm(CSGTerm::TYPE_UNION, 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, x, y), 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, x, z));
 		return true;
 	}
 	// 4.  x * (y * z) -> (x * y) * z
 	else if (term->type == CSGTerm::TYPE_INTERSECTION && term->right->type == CSGTerm::TYPE_INTERSECTION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, y),
-												 z);
+		term = createTerm(CSGTerm::TYPE_INTERSECTION, 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, y),
+											z);
 		return true;
 	}
 	// 5.  x - (y - z) -> (x - y) + (x * z)
 	else if (term->type == CSGTerm::TYPE_DIFFERENCE && term->right->type == CSGTerm::TYPE_DIFFERENCE) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, x, y), 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, z));
+		term = createTerm(CSGTerm::TYPE_UNION, 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, x, y), 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, z));
 		return true;
 	}
 	// 6.  x * (y - z) -> (x * y) - z
 	else if (term->type == CSGTerm::TYPE_INTERSECTION && term->right->type == CSGTerm::TYPE_DIFFERENCE) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, y),
-												 z);
+		term = createTerm(CSGTerm::TYPE_DIFFERENCE, 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, y),
+											z);
 		return true;
 	}
 
@@ -178,29 +222,102 @@ bool CSGTermNormalizer::match_and_replace(shared_ptr<CSGTerm> &term)
 
 	// 7. (x - y) * z  -> (x * z) - y
 	if (term->left->type == CSGTerm::TYPE_DIFFERENCE && term->type == CSGTerm::TYPE_INTERSECTION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, z), 
-												 y);
+		term = createTerm(CSGTerm::TYPE_DIFFERENCE, 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, z), 
+											y);
 		return true;
 	}
 	// 8. (x + y) - z  -> (x - z) + (y - z)
 	else if (term->left->type == CSGTerm::TYPE_UNION && term->type == CSGTerm::TYPE_DIFFERENCE) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, x, z), 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_DIFFERENCE, y, z));
+		term = createTerm(CSGTerm::TYPE_UNION, 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, x, z), 
+											createTerm(CSGTerm::TYPE_DIFFERENCE, y, z));
 		return true;
 	}
 	// 9. (x + y) * z  -> (x * z) + (y * z)
 	else if (term->left->type == CSGTerm::TYPE_UNION && term->type == CSGTerm::TYPE_INTERSECTION) {
-		term = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, x, z), 
-												 CSGTerm::createCSGTerm(CSGTerm::TYPE_INTERSECTION, y, z));
+		term = createTerm(CSGTerm::TYPE_UNION, 
+											createTerm(CSGTerm::TYPE_INTERSECTION, x, z), 
+											createTerm(CSGTerm::TYPE_INTERSECTION, y, z));
 		return true;
 	}
 
 	return false;
 }
 
+/*!
+	Drops the parts of a union operand which can't touch the other operand,
+	i.e. the right side of an intersection or difference or the left side of
+	an intersection. Returns true if the term was changed.
+*/
+bool CSGTermNormalizer::prune_operand(shared_ptr<CSGTerm> &term)
+{
+	if (term->right->type == CSGTerm::TYPE_UNION) {
+		shared_ptr<CSGTerm> right = prune(term->right, term->left->getBoundingBox());
+		if (right != term->right) {
+			term = createTerm(term->type, term->left, right);
+			return true;
+		}
+	}
+	if (term->type == CSGTerm::TYPE_INTERSECTION && term->left->type == CSGTerm::TYPE_UNION) {
+		shared_ptr<CSGTerm> left = prune(term->left, term->right->getBoundingBox());
+		if (left != term->left) {
+			term = createTerm(term->type, left, term->right);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+	Returns the parts of \a term which overlap \a bbox, descending into unions.
+	Returns NULL if there are none.
+*/
+shared_ptr<CSGTerm> CSGTermNormalizer::prune(const shared_ptr<CSGTerm> &term, const BoundingBox &bbox)
+{
+	if (!overlaps(term->getBoundingBox(), bbox)) return shared_ptr<CSGTerm>();
+	if (term->type != CSGTerm::TYPE_UNION) return term;
+
+	// Pruning against a larger box can't remove anything either
+	if (this->unpruned.count(term.get()) && bbox.contains(this->unpruned[term.get()].second)) return term;
+
+	shared_ptr<CSGTerm> left = prune(term->left, bbox);
+	shared_ptr<CSGTerm> right = prune(term->right, bbox);
+	if (left == term->left && right == term->right) {
+		this->unpruned[term.get()] = std::make_pair(term, bbox);
+		return term;
+	}
+	if (term->flag == CSGTerm::FLAG_NONE) return createTerm(CSGTerm::TYPE_UNION, left, right);
+
+	// Keep the highlight flag, on a term of its own. If only one side is left,
+	// it's copied, since it may be shared with terms which aren't flagged.
+	shared_ptr<CSGTerm> t = CSGTerm::createCSGTerm(CSGTerm::TYPE_UNION, left, right);
+	if (!t) return t;
+	if (t == left || t == right) t.reset(new CSGTerm(*t));
+	t->flag = CSGTerm::Flag(t->flag | term->flag);
+	return t;
+}
+
+/*!
+	Like CSGTerm::createCSGTerm(), but returns the same term when called again
+	with the same type and operands.
+*/
+shared_ptr<CSGTerm> CSGTermNormalizer::createTerm(CSGTerm::type_e type, const shared_ptr<CSGTerm> &left,
+																									const shared_ptr<CSGTerm> &right)
+{
+	if (!left || !right) return CSGTerm::createCSGTerm(type, left, right);
+
+	const TermKey key(type, std::make_pair(left.get(), right.get()));
+	boost::unordered_map<TermKey, SharedTerm>::iterator it = this->terms.find(key);
+	if (it != this->terms.end()) return it->second.term;
+
+	SharedTerm &shared = this->terms[key];
+	shared.left = left;
+	shared.right = right;
+	shared.term = CSGTerm::createCSGTerm(type, left, right);
+	return shared.term;
+}
+
 // Counts all non-leaf nodes
 unsigned int CSGTermNormalizer::count(const shared_ptr<CSGTerm> &term) const
 {
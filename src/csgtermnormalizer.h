@@ -1,6 +1,11 @@
 #pragma once
 
 #include "memory.h"
+#include "linalg.h"
+#include "csgterm.h"
+
+#include <utility>
+#include <boost/unordered_map.hpp>
 
 class CSGTermNormalizer
 {
@@ -13,6 +18,10 @@ public:
 private:
 	shared_ptr<CSGTerm> normalizePass(shared_ptr<CSGTerm> term) ;
 	bool match_and_replace(shared_ptr<CSGTerm> &term);
+	bool prune_operand(shared_ptr<CSGTerm> &term);
+	shared_ptr<CSGTerm> prune(const shared_ptr<CSGTerm> &term, const BoundingBox &bbox);
+	shared_ptr<CSGTerm> createTerm(CSGTerm::type_e type, const shared_ptr<CSGTerm> &left,
+																 const shared_ptr<CSGTerm> &right);
 	shared_ptr<CSGTerm> collapse_null_terms(const shared_ptr<CSGTerm> &term);
 	shared_ptr<CSGTerm> cleanup_term(shared_ptr<CSGTerm> &t);
 	unsigned int count(const shared_ptr<CSGTerm> &term) const;
@@ -21,4 +30,18 @@ private:
 	size_t limit;
 	size_t nodecount;
 	shared_ptr<class CSGTerm> rootnode;
+
+	// Terms created during normalization, keyed by type and operands, so
+	// equal subterms are shared. The operands are kept alive with the key.
+	struct SharedTerm {
+		shared_ptr<CSGTerm> left, right, term;
+	};
+	typedef std::pair<int, std::pair<const CSGTerm *, const CSGTerm *> > TermKey;
+	boost::unordered_map<TermKey, SharedTerm> terms;
+
+	// Results of the current pass, so shared subterms are only normalized once
+	boost::unordered_map<const CSGTerm *, std::pair<shared_ptr<CSGTerm>, shared_ptr<CSGTerm> > > normalized;
+
+	// Unions which prune() left unchanged, and the box they were pruned against
+	boost::unordered_map<const CSGTerm *, std::pair<shared_ptr<CSGTerm>, BoundingBox> > unpruned;
 };
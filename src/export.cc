@@ -28,10 +28,17 @@
 #include "printutils.h"
 #include "polyset.h"
 #include "polyset-utils.h"
+#include "IndexedMesh.h"
 #include "dxfdata.h"
+#include "parallel.h"
 
+#include <string.h>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/cstdint.hpp>
+
+using boost::uint32_t;
 
 #define QUOTE(x__) # x__
 #define QUOTED(x__) QUOTE(x__)
@@ -55,6 +62,9 @@ void exportFile(const class Geometry *root_geom, std::ostream &output, FileForma
 		case OPENSCAD_STL:
 			export_stl(N, output);
 			break;
+		case OPENSCAD_STL_BINARY:
+			export_stl_binary(N, output);
+			break;
 		case OPENSCAD_OFF:
 			export_off(N, output);
 			break;
@@ -74,6 +84,9 @@ void exportFile(const class Geometry *root_geom, std::ostream &output, FileForma
 			case OPENSCAD_STL:
 				export_stl(*ps, output);
 				break;
+			case OPENSCAD_STL_BINARY:
+				export_stl_binary(*ps, output);
+				break;
 			case OPENSCAD_OFF:
 				export_off(*ps, output);
 				break;
@@ -104,7 +117,9 @@ void exportFile(const class Geometry *root_geom, std::ostream &output, FileForma
 void exportFileByName(const class Geometry *root_geom, FileFormat format,
 	const char *name2open, const char *name2display)
 {
-	std::ofstream fstream(name2open);
+	std::ios::openmode mode = std::ios::out;
+	if (format == OPENSCAD_STL_BINARY) mode |= std::ios::binary;
+	std::ofstream fstream(name2open, mode);
 	if (!fstream.is_open()) {
 		PRINTB("Can't open file \"%s\" for export", name2display);
 	} else {
@@ -126,53 +141,183 @@ void exportFileByName(const class Geometry *root_geom, FileFormat format,
 	}
 }
 
+namespace {
+	// Number of facets formatted per task, and number of tasks per thread
+	// buffered before writing, bounding the memory used for the output.
+	const size_t STL_CHUNK_FACETS = 16384;
+	const size_t STL_CHUNKS_PER_THREAD = 4;
+	// Number of unique vertices formatted per task
+	const size_t STL_CHUNK_VERTICES = 16384;
+
+	/*!
+		Formats numbers the same way as the default std::ostream formatting
+		(i.e. %g), but without the stream overhead.
+	*/
+	inline void append_vector(std::string &out, double x, double y, double z)
+	{
+		char buf[128];
+		int len = snprintf(buf, sizeof(buf), "%g %g %g", x, y, z);
+		out.append(buf, len);
+	}
+
+	struct FormatVertices {
+		const IndexedMesh &mesh;
+		std::vector<std::string> &vertexstrings;
+		FormatVertices(const IndexedMesh &mesh, std::vector<std::string> &vertexstrings)
+			: mesh(mesh), vertexstrings(vertexstrings) {}
+		void operator()(size_t chunk) const {
+			size_t end = std::min((chunk + 1) * STL_CHUNK_VERTICES, this->mesh.vertices.size());
+			for (size_t i=chunk * STL_CHUNK_VERTICES;i<end;i++) {
+				const Vector3d &v = this->mesh.vertices[i];
+				append_vector(this->vertexstrings[i], v[0], v[1], v[2]);
+			}
+		}
+	};
+
+	struct FormatFacets {
+		const IndexedMesh &mesh;
+		const std::vector<std::string> &vertexstrings;
+		std::vector<std::string> &buffers;
+		size_t firstchunk;
+		FormatFacets(const IndexedMesh &mesh, const std::vector<std::string> &vertexstrings,
+								 std::vector<std::string> &buffers, size_t firstchunk)
+			: mesh(mesh), vertexstrings(vertexstrings), buffers(buffers), firstchunk(firstchunk) {}
+		void operator()(size_t idx) const {
+			std::string &out = this->buffers[idx];
+			out.clear();
+			const size_t begin = (this->firstchunk + idx) * STL_CHUNK_FACETS;
+			const size_t end = std::min(begin + STL_CHUNK_FACETS, this->mesh.numFaces());
+			for (size_t f=begin;f<end;f++) {
+				assert(this->mesh.faceSize(f) == 3); // STL only allows triangles
+				const int *idx = this->mesh.faceIndices(f);
+				const std::string &vs1 = this->vertexstrings[idx[0]];
+				const std::string &vs2 = this->vertexstrings[idx[1]];
+				const std::string &vs3 = this->vertexstrings[idx[2]];
+				if (vs1 != vs2 && vs1 != vs3 && vs2 != vs3) {
+					// The above condition ensures that there are 3 distinct vertices, but
+					// they may be collinear. If they are, the unit normal is meaningless
+					// so the default value of "0 0 0" is used.
+					out += "  facet normal ";
+					const Vector3d &p0 = this->mesh.vertices[idx[0]];
+					Vector3d normal = (this->mesh.vertices[idx[1]] - p0).cross(this->mesh.vertices[idx[2]] - p0);
+					normal.normalize();
+					if (is_finite(normal) && !is_nan(normal)) {
+						append_vector(out, normal[0], normal[1], normal[2]);
+						out += "\n";
+					}
+					else {
+						out += "0 0 0\n";
+					}
+					out += "    outer loop\n";
+					out += "      vertex "; out += vs1; out += "\n";
+					out += "      vertex "; out += vs2; out += "\n";
+					out += "      vertex "; out += vs3; out += "\n";
+					out += "    endloop\n";
+					out += "  endfacet\n";
+				}
+			}
+		}
+	};
+
+	inline void append_uint32(std::string &out, uint32_t x)
+	{
+		out += char(x & 0xff);
+		out += char((x >> 8) & 0xff);
+		out += char((x >> 16) & 0xff);
+		out += char((x >> 24) & 0xff);
+	}
+
+	inline void append_float(std::string &out, double d)
+	{
+		float f = float(d);
+		uint32_t x;
+		memcpy(&x, &f, 4);
+		append_uint32(out, x);
+	}
+}
+
+/*!
+	Writes the PolySet as ASCII STL.
+
+	Each unique vertex is formatted once. Facets are formatted in chunks,
+	concurrently if more than one thread is available (see
+	Parallel::setMaxThreads()), and the chunks are written in order.
+*/
 void export_stl(const PolySet &ps, std::ostream &output)
 {
 	PolySet triangulated(3);
 	PolysetUtils::tessellate_faces(ps, triangulated);
+	IndexedMesh mesh(triangulated);
 
 	setlocale(LC_NUMERIC, "C"); // Ensure radix is . (not ,) in output
+
+	// Format each unique vertex only once
+	std::vector<std::string> vertexstrings(mesh.vertices.size());
+	Parallel::for_each_index((mesh.vertices.size() + STL_CHUNK_VERTICES - 1) / STL_CHUNK_VERTICES,
+													 FormatVertices(mesh, vertexstrings));
+
 	output << "solid OpenSCAD_Model\n";
-	BOOST_FOREACH(const Polygon &p, triangulated.polygons) {
-		assert(p.size() == 3); // STL only allows triangles
-		std::stringstream stream;
-		stream << p[0][0] << " " << p[0][1] << " " << p[0][2];
-		std::string vs1 = stream.str();
-		stream.str("");
-		stream << p[1][0] << " " << p[1][1] << " " << p[1][2];
-		std::string vs2 = stream.str();
-		stream.str("");
-		stream << p[2][0] << " " << p[2][1] << " " << p[2][2];
-		std::string vs3 = stream.str();
-		if (vs1 != vs2 && vs1 != vs3 && vs2 != vs3) {
-			// The above condition ensures that there are 3 distinct vertices, but
-			// they may be collinear. If they are, the unit normal is meaningless
-			// so the default value of "1 0 0" can be used. If the vertices are not
-			// collinear then the unit normal must be calculated from the
-			// components.
-			output << "  facet normal ";
-
-			Vector3d normal = (p[1] - p[0]).cross(p[2] - p[0]);
-			normal.normalize();
-			if (is_finite(normal) && !is_nan(normal)) {
-				output << normal[0] << " " << normal[1] << " " << normal[2] << "\n";
-			}
-			else {
-				output << "0 0 0\n";
-			}
-			output << "    outer loop\n";
-		
-			BOOST_FOREACH(const Vector3d &v, p) {
-				output << "      vertex " << v[0] << " " << v[1] << " " << v[2] << "\n";
-			}
-			output << "    endloop\n";
-			output << "  endfacet\n";
-		}
+	const size_t numchunks = (mesh.numFaces() + STL_CHUNK_FACETS - 1) / STL_CHUNK_FACETS;
+	std::vector<std::string> buffers(std::min(numchunks, size_t(Parallel::maxThreads() * STL_CHUNKS_PER_THREAD)));
+	for (size_t chunk=0;chunk<numchunks;chunk+=buffers.size()) {
+		const size_t n = std::min(buffers.size(), numchunks - chunk);
+		Parallel::for_each_index(n, FormatFacets(mesh, vertexstrings, buffers, chunk));
+		for (size_t i=0;i<n;i++) output.write(buffers[i].data(), buffers[i].size());
 	}
 	output << "endsolid OpenSCAD_Model\n";
 	setlocale(LC_NUMERIC, "");      // Set default locale
 }
 
+/*!
+	Writes the PolySet as binary STL. Vertices are stored as 32-bit floats,
+	and facets which become degenerate in that precision are skipped.
+*/
+void export_stl_binary(const PolySet &ps, std::ostream &output)
+{
+	PolySet triangulated(3);
+	PolysetUtils::tessellate_faces(ps, triangulated);
+	IndexedMesh mesh(triangulated);
+
+	std::vector<Vector3f> vertices(mesh.vertices.size());
+	for (size_t i=0;i<mesh.vertices.size();i++) vertices[i] = mesh.vertices[i].cast<float>();
+
+	std::vector<size_t> facets;
+	facets.reserve(mesh.numFaces());
+	for (size_t f=0;f<mesh.numFaces();f++) {
+		assert(mesh.faceSize(f) == 3); // STL only allows triangles
+		const int *idx = mesh.faceIndices(f);
+		const Vector3f &v1 = vertices[idx[0]], &v2 = vertices[idx[1]], &v3 = vertices[idx[2]];
+		if (v1 != v2 && v1 != v3 && v2 != v3) facets.push_back(f);
+	}
+
+	std::string header("OpenSCAD Model");
+	header.resize(80, ' ');
+	append_uint32(header, facets.size());
+	output.write(header.data(), header.size());
+
+	std::string buffer;
+	buffer.reserve(STL_CHUNK_FACETS * 50);
+	for (size_t i=0;i<facets.size();i++) {
+		const int *idx = mesh.faceIndices(facets[i]);
+		const Vector3d &p0 = mesh.vertices[idx[0]];
+		Vector3d normal = (mesh.vertices[idx[1]] - p0).cross(mesh.vertices[idx[2]] - p0);
+		normal.normalize();
+		if (!is_finite(normal) || is_nan(normal)) normal = Vector3d(0, 0, 0);
+		for (int j=0;j<3;j++) append_float(buffer, normal[j]);
+		for (int k=0;k<3;k++) {
+			const Vector3f &v = vertices[idx[k]];
+			for (int j=0;j<3;j++) append_float(buffer, v[j]);
+		}
+		buffer += '\0'; // Attribute byte count
+		buffer += '\0';
+		if (buffer.size() >= STL_CHUNK_FACETS * 50) {
+			output.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+	output.write(buffer.data(), buffer.size());
+}
+
 /*!
 	Saves the given CGAL Polyhedon2 as STL to the given file.
 	The file must be open.
@@ -246,6 +391,24 @@ static void export_stl(const CGAL_Polyhedron &P, std::ostream &output)
 	setlocale(LC_NUMERIC, "");      // Set default locale
 }
 
+/*!
+	Saves the current 3D CGAL Nef polyhedron as binary STL to the given file.
+	The file must be open in binary mode.
+ */
+void export_stl_binary(const CGAL_Nef_polyhedron *root_N, std::ostream &output)
+{
+	if (!root_N->p3->is_simple()) {
+		PRINT("WARNING: Exported object may not be a valid 2-manifold and may need repair");
+	}
+
+	PolySet ps(3);
+	bool err = CGALUtils::createPolySetFromNefPolyhedron3(*(root_N->p3), ps);
+	if (err) { PRINT("ERROR: Nef->PolySet failed"); }
+	else {
+		export_stl_binary(ps, output);
+	}
+}
+
 /*!
 	Saves the current 3D CGAL Nef polyhedron as STL to the given file.
 	The file must be open.
@@ -1,14 +1,23 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <vector>
 #include "Tree.h"
 #include "Camera.h"
 #include "memory.h"
 
+// One image of a batch export, see PngBatchExporter
+struct PngView {
+	std::string filename;
+	Camera camera;
+};
+
 #ifdef ENABLE_CGAL
 
 enum FileFormat {
 	OPENSCAD_STL,
+	OPENSCAD_STL_BINARY,
 	OPENSCAD_OFF,
 	OPENSCAD_AMF,
 	OPENSCAD_DXF,
@@ -22,6 +31,8 @@ void export_png(shared_ptr<const class Geometry> root_geom, Camera &c, std::ostr
 
 void export_stl(const class CGAL_Nef_polyhedron *root_N, std::ostream &output);
 void export_stl(const class PolySet &ps, std::ostream &output);
+void export_stl_binary(const class CGAL_Nef_polyhedron *root_N, std::ostream &output);
+void export_stl_binary(const class PolySet &ps, std::ostream &output);
 void export_off(const CGAL_Nef_polyhedron *root_N, std::ostream &output);
 void export_off(const class PolySet &ps, std::ostream &output);
 void export_amf(const class CGAL_Nef_polyhedron *root_N, std::ostream &output);
@@ -32,6 +43,30 @@ void export_png(const CGAL_Nef_polyhedron *root_N, Camera &c, std::ostream &outp
 void export_png_with_opencsg(Tree &tree, Camera &c, std::ostream &output);
 void export_png_with_throwntogether(Tree &tree, Camera &c, std::ostream &output);
 
+/*!
+	Renders many PNG images while keeping one offscreen GL context, sized to
+	the largest image, for all of them. Each call draws one design from all
+	given views, setting up its renderer only once. Images are encoded and
+	written on worker threads.
+*/
+class PngBatchExporter
+{
+public:
+	PngBatchExporter(size_t width, size_t height, unsigned int numthreads);
+	~PngBatchExporter();
+	bool isValid() const { return this->glview != NULL; }
+
+	void render(shared_ptr<const class Geometry> root_geom, const std::vector<PngView> &views);
+	void preview(Tree &tree, bool throwntogether, const std::vector<PngView> &views);
+	bool finish();
+
+private:
+	void paint(const std::vector<PngView> &views);
+
+	class OffscreenView *glview;
+	class PngWriteQueue *queue;
+};
+
 #endif // ENABLE_CGAL
 
 #ifdef DEBUG
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include "polyset.h"
 #include "rendersettings.h"
+#include "PngWriteQueue.h"
+
+#include <boost/foreach.hpp>
 
 #ifdef ENABLE_CGAL
 #include "CGALRenderer.h"
@@ -102,4 +105,91 @@ void export_png_with_throwntogether(Tree &tree, Camera &cam, std::ostream &outpu
 	export_png_preview_common(tree, cam, output, THROWNTOGETHER);
 }
 
+PngBatchExporter::PngBatchExporter(size_t width, size_t height, unsigned int numthreads)
+	: glview(NULL), queue(new PngWriteQueue(numthreads))
+{
+	try {
+		this->glview = new OffscreenView(width, height);
+	} catch (int error) {
+		fprintf(stderr,"Can't create OpenGL OffscreenView. Code: %i.\n", error);
+		return;
+	}
+#ifdef ENABLE_OPENCSG
+	OpenCSG::setContext(0);
+	OpenCSG::setOption(OpenCSG::OffscreenSetting, OpenCSG::FrameBufferObject);
+#endif
+}
+
+PngBatchExporter::~PngBatchExporter()
+{
+	delete this->queue;
+	delete this->glview;
+}
+
+void PngBatchExporter::render(shared_ptr<const Geometry> root_geom, const std::vector<PngView> &views)
+{
+	PRINTD("PngBatchExporter::render");
+	if (!this->glview) return;
+	CGALRenderer cgalRenderer(root_geom);
+	this->glview->setRenderer(&cgalRenderer);
+	paint(views);
+	this->glview->setRenderer(NULL);
+}
+
+void PngBatchExporter::preview(Tree &tree, bool throwntogether, const std::vector<PngView> &views)
+{
+	PRINTD("PngBatchExporter::preview");
+	if (!this->glview) return;
+	CsgInfo csgInfo;
+	csgInfo.compile_chains(tree);
+	{
+#ifdef ENABLE_OPENCSG
+		OpenCSGRenderer openCSGRenderer(csgInfo.root_chain, csgInfo.highlights_chain, csgInfo.background_chain, this->glview->shaderinfo);
+#endif
+		ThrownTogetherRenderer thrownTogetherRenderer(csgInfo.root_chain, csgInfo.highlights_chain, csgInfo.background_chain);
+#ifdef ENABLE_OPENCSG
+		if (!throwntogether)
+			this->glview->setRenderer(&openCSGRenderer);
+		else
+#endif
+			this->glview->setRenderer(&thrownTogetherRenderer);
+		paint(views);
+		this->glview->setRenderer(NULL);
+	}
+	delete csgInfo.root_chain;
+	delete csgInfo.highlights_chain;
+	delete csgInfo.background_chain;
+}
+
+/*!
+	Draws the current renderer from each view. Smaller images only use the
+	lower left part of the context.
+*/
+void PngBatchExporter::paint(const std::vector<PngView> &views)
+{
+	this->glview->setColorScheme(RenderSettings::inst()->colorscheme);
+	const BoundingBox bbox = this->glview->getRenderer()->getBoundingBox();
+	std::vector<unsigned char> pixels;
+	BOOST_FOREACH(const PngView &view, views) {
+		Camera cam = view.camera;
+		setupCamera(cam, bbox);
+		this->glview->resizeGL(cam.pixel_width, cam.pixel_height);
+		this->glview->setCamera(cam);
+		this->glview->paintGL();
+		if (!read_framebuffer(this->glview->ctx, cam.pixel_width, cam.pixel_height, pixels)) {
+			PRINTB("Can't export \"%s\": image is larger than the offscreen context", view.filename);
+			continue;
+		}
+		this->queue->push(view.filename, pixels, cam.pixel_width, cam.pixel_height);
+	}
+}
+
+/*!
+	Waits for all images to be written. Returns false if any of them failed.
+*/
+bool PngBatchExporter::finish()
+{
+	return this->queue->finish();
+}
+
 #endif // ENABLE_CGAL
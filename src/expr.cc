@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <sstream>
 #include <algorithm>
+#include <limits>
 #include "stl-utils.h"
 #include "printutils.h"
 #include "stackcheck.h"
@@ -38,18 +39,8 @@
 
 // unnamed namespace
 namespace {
-	Value::VectorType flatten(Value::VectorType const& vec) {
-		int n = 0;
-		for (unsigned int i = 0; i < vec.size(); i++) {
-			assert(vec[i].type() == Value::VECTOR);
-			n += vec[i].toVector().size();
-		}
-		Value::VectorType ret; ret.reserve(n);
-		for (unsigned int i = 0; i < vec.size(); i++) {
-			std::copy(vec[i].toVector().begin(),vec[i].toVector().end(),std::back_inserter(ret));
-		}
-		return ret;
-	}
+	// Limits the memory used by the result of a list comprehension
+	const size_t LC_MAX_ELEMENTS = 1000000;
 
 	void evaluate_sequential_assignment(const AssignmentList & assignment_list, Context *context) {
 		EvalContext let_context(context, assignment_list);
@@ -114,6 +105,31 @@ bool Expression::isListComprehension() const
 	return false;
 }
 
+bool Expression::isConst() const
+{
+	return false;
+}
+
+/*!
+	Compile step run by the parser on each operator and vector expression as
+	it is reduced. If all children are constants, the expression can't depend
+	on any context, so it's evaluated once and replaced by an ExpressionFolded.
+	Nested literals like point lists or negative numbers thus become shared
+	values instead of being rebuilt on every evaluation.
+
+	Must only be called for expressions which don't have side effects, like
+	warnings, and only depend on their children, i.e. not for lookups,
+	function calls, let or list comprehensions.
+*/
+Expression *fold_constants(Expression *expr)
+{
+	BOOST_FOREACH(const Expression *e, expr->children) {
+		if (!e->isConst()) return expr;
+	}
+	Context c;
+	return new ExpressionFolded(expr, expr->evaluate(&c));
+}
+
 ExpressionNot::ExpressionNot(Expression *expr) : Expression(expr)
 {
 }
@@ -365,6 +381,36 @@ void ExpressionConst::print(std::ostream &stream) const
     stream << *this->const_value;
 }
 
+bool ExpressionConst::isConst() const
+{
+	return true;
+}
+
+ExpressionFolded::ExpressionFolded(Expression *expr, const ValuePtr &val)
+	: expr(expr), const_value(val)
+{
+}
+
+ExpressionFolded::~ExpressionFolded()
+{
+	delete this->expr;
+}
+
+ValuePtr ExpressionFolded::evaluate(const class Context *) const
+{
+	return this->const_value;
+}
+
+void ExpressionFolded::print(std::ostream &stream) const
+{
+	stream << *this->expr;
+}
+
+bool ExpressionFolded::isConst() const
+{
+	return true;
+}
+
 ExpressionRange::ExpressionRange(Expression *expr1, Expression *expr2) : Expression(expr1, expr2)
 {
 }
@@ -408,10 +454,11 @@ ExpressionVector::ExpressionVector(Expression *expr) : Expression(expr)
 ValuePtr ExpressionVector::evaluate(const Context *context) const
 {
 	Value::VectorType vec;
+	vec.reserve(this->children.size());
 	BOOST_FOREACH(const Expression *e, this->children) {
 		vec.push_back(*(e->evaluate(context)));
 	}
-	return ValuePtr(vec);
+	return ValuePtr::takeVector(vec);
 }
 
 void ExpressionVector::print(std::ostream &stream) const
@@ -539,16 +586,41 @@ bool ExpressionLc::isListComprehension() const
 ValuePtr ExpressionLc::evaluate(const Context *context) const
 {
 	Value::VectorType vec;
+	if (!evaluate_elements(context, vec)) {
+		PRINTB("WARNING: Bad list comprehension: too many elements (more than %lu).", LC_MAX_ELEMENTS);
+		vec.clear();
+	}
+	return ValuePtr::takeVector(vec);
+}
 
+/*!
+	Appends the elements generated by expr to out. Nested list comprehensions
+	append their elements directly, so intermediate results are never
+	collected in temporary vectors and flattened afterwards.
+
+	Returns false, without appending, once out holds LC_MAX_ELEMENTS.
+*/
+bool ExpressionLc::evaluate_elements(const Expression *expr, const Context *context, Value::VectorType &out)
+{
+	if (expr->isListComprehension()) {
+		return static_cast<const ExpressionLc *>(expr)->evaluate_elements(context, out);
+	}
+	if (out.size() >= LC_MAX_ELEMENTS) return false;
+	out.push_back(*expr->evaluate(context));
+	return true;
+}
+
+/*!
+	Streams the elements of this list comprehension into out, one element
+	or loop iteration at a time. Returns false if the result would grow
+	beyond LC_MAX_ELEMENTS.
+*/
+bool ExpressionLc::evaluate_elements(const Context *context, Value::VectorType &out) const
+{
 	if (this->name == "if") {
 		if (this->first->evaluate(context)) {
-			if (this->second->isListComprehension()) {
-				return this->second->evaluate(context);
-			} else {
-				vec.push_back((*this->second->evaluate(context)));
-			}
+			return evaluate_elements(this->second, context, out);
 		}
-		return ValuePtr(vec);
 	} else if (this->name == "for") {
 		EvalContext for_context(context, this->call_arguments);
 
@@ -563,38 +635,39 @@ ValuePtr ExpressionLc::evaluate(const Context *context) const
 		if (it_values->type() == Value::RANGE) {
 			Value::RangeType range = it_values->toRange();
 			boost::uint32_t steps = range.nbsteps();
-			if (steps >= 1000000) {
+			// Elements are streamed into the result, so only the number of elements
+			// is limited, not the number of steps. This still rejects ranges which
+			// never terminate.
+			if (steps == std::numeric_limits<boost::uint32_t>::max()) {
 				PRINTB("WARNING: Bad range parameter in for statement: too many elements (%lu).", steps);
 			} else {
 				for (Value::RangeType::iterator it = range.begin();it != range.end();it++) {
 					c.set_variable(it_name, ValuePtr(*it));
-					vec.push_back((*this->first->evaluate(&c)));
+					if (!evaluate_elements(this->first, &c, out)) return false;
 				}
 			}
 		}
 		else if (it_values->type() == Value::VECTOR) {
-			for (size_t i = 0; i < it_values->toVector().size(); i++) {
-				c.set_variable(it_name, it_values->toVector()[i]);
-				vec.push_back((*this->first->evaluate(&c)));
+			const Value::VectorType &vec = it_values->toVector();
+			if (out.empty() && !this->first->isListComprehension()) out.reserve(vec.size());
+			for (size_t i = 0; i < vec.size(); i++) {
+				c.set_variable(it_name, vec[i]);
+				if (!evaluate_elements(this->first, &c, out)) return false;
 			}
 		}
 		else if (it_values->type() != Value::UNDEFINED) {
 			c.set_variable(it_name, it_values);
-			vec.push_back((*this->first->evaluate(&c)));
-		}
-		if (this->first->isListComprehension()) {
-			return ValuePtr(flatten(vec));
-		} else {
-			return ValuePtr(vec);
+			return evaluate_elements(this->first, &c, out);
 		}
 	} else if (this->name == "let") {
 		Context c(context);
 		evaluate_sequential_assignment(this->call_arguments, &c);
 
-		return this->first->evaluate(&c);
+		return evaluate_elements(this->first, &c, out);
 	} else {
 		abort();
 	}
+	return true;
 }
 
 void ExpressionLc::print(std::ostream &stream) const
@@ -20,12 +20,15 @@ public:
 	virtual ~Expression();
 
 	virtual bool isListComprehension() const;
+	virtual bool isConst() const;
 	virtual ValuePtr evaluate(const class Context *context) const = 0;
 	virtual void print(std::ostream &stream) const = 0;
 };
 
 std::ostream &operator<<(std::ostream &stream, const Expression &expr);
 
+Expression *fold_constants(Expression *expr);
+
 class ExpressionNot : public Expression
 {
 public:
@@ -169,7 +172,25 @@ public:
 	ExpressionConst(const ValuePtr &val);
 	ValuePtr evaluate(const class Context *) const;
 	virtual void print(std::ostream &stream) const;
+	virtual bool isConst() const;
+private:
+	ValuePtr const_value;
+};
+
+/*!
+	A constant subexpression which was evaluated at parse time, see
+	fold_constants(). The original expression is kept for printing only.
+*/
+class ExpressionFolded : public Expression
+{
+public:
+	ExpressionFolded(Expression *expr, const ValuePtr &val);
+	virtual ~ExpressionFolded();
+	ValuePtr evaluate(const class Context *) const;
+	virtual void print(std::ostream &stream) const;
+	virtual bool isConst() const;
 private:
+	Expression *expr;
 	ValuePtr const_value;
 };
 
@@ -249,7 +270,10 @@ public:
 							 Expression *expr1, Expression *expr2);
 	ValuePtr evaluate(const class Context *context) const;
 	virtual void print(std::ostream &stream) const;
+	bool evaluate_elements(const class Context *context, Value::VectorType &out) const;
 private:
+	static bool evaluate_elements(const Expression *expr, const class Context *context, Value::VectorType &out);
+
 	std::string name;
 	AssignmentList call_arguments;
 };
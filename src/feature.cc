@@ -18,6 +18,9 @@ Feature::list_t Feature::feature_list;
  * argument to enable the option and for saving the option value in GUI
  * context.
  */
+const Feature Feature::ExperimentalCorefinement("corefinement", "Enable mesh corefinement for 3D boolean operations (requires CGAL 4.10 or newer). Falls back to Nef polyhedra for objects which aren't closed.");
+const Feature Feature::ExperimentalFunctionMemoization("memoize", "Enable caching of results of user-defined functions called repeatedly with the same arguments.");
+
 
 Feature::Feature(const std::string &name, const std::string &description)
 	: enabled(false), name(name), description(description)
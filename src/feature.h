@@ -24,6 +24,9 @@ public:
 	static void dump_features();
 	static void enable_feature(const std::string &feature_name, bool status = true);
 
+	static const Feature ExperimentalCorefinement;
+	static const Feature ExperimentalFunctionMemoization;
+
 private:
 	bool enabled;
   
@@ -100,11 +100,25 @@ ValuePtr Function::evaluate(const Context *ctx, const EvalContext *evalctx) cons
 	if (!expr) return ValuePtr::undefined;
 	Context c(ctx);
 	c.setVariables(definition_arguments, evalctx);
-	ValuePtr result = expr->evaluate(&c);
+	if (!FunctionMemo::isEnabled()) return evaluate_body(c);
+
+	std::string key;
+	if (!FunctionMemo::argumentKey(c, key)) return evaluate_body(c);
+	ValuePtr result;
+	if (this->memo.lookup(key, c, result)) return result;
+
+	FunctionMemo::Recorder recorder(c);
+	result = evaluate_body(c);
+	this->memo.insert(key, result, recorder);
 
 	return result;
 }
 
+ValuePtr Function::evaluate_body(Context &c) const
+{
+	return expr->evaluate(&c);
+}
+
 std::string Function::dump(const std::string &indent, const std::string &name) const
 {
 	std::stringstream dump;
@@ -130,7 +144,8 @@ public:
 	FunctionTailRecursion(const char *name, AssignmentList &definition_arguments, Expression *expr, ExpressionFunctionCall *call, Expression *endexpr, bool invert);
 	virtual ~FunctionTailRecursion();
 
-	virtual ValuePtr evaluate(const Context *ctx, const EvalContext *evalctx) const;
+protected:
+	virtual ValuePtr evaluate_body(Context &c) const;
 };
 
 FunctionTailRecursion::FunctionTailRecursion(const char *name, AssignmentList &definition_arguments, Expression *expr, ExpressionFunctionCall *call, Expression *endexpr, bool invert)
@@ -142,13 +157,8 @@ FunctionTailRecursion::~FunctionTailRecursion()
 {
 }
 
-ValuePtr FunctionTailRecursion::evaluate(const Context *ctx, const EvalContext *evalctx) const
+ValuePtr FunctionTailRecursion::evaluate_body(Context &c) const
 {
-	if (!expr) return ValuePtr::undefined;
-
-	Context c(ctx);
-	c.setVariables(definition_arguments, evalctx);
-
 	EvalContext ec(&c, call->call_arguments);
 	Context tmp(&c);
 	unsigned int counter = 0;
@@ -232,6 +242,7 @@ ValuePtr builtin_sign(const Context *, const EvalContext *evalctx)
 
 ValuePtr builtin_rands(const Context *, const EvalContext *evalctx)
 {
+	FunctionMemo::invalidate();
 	size_t n = evalctx->numArgs();
 	if (n == 3 || n == 4) {
 		ValuePtr v0 = evalctx->getArgValue(0);
@@ -616,15 +627,13 @@ ValuePtr builtin_concat(const Context *, const EvalContext *evalctx)
 	for (size_t i = 0; i < evalctx->numArgs(); i++) {
 		ValuePtr v = evalctx->getArgValue(i);
 		if (v->type() == Value::VECTOR) {
-			Value::VectorType vec = v->toVector();
-			for (Value::VectorType::const_iterator it = vec.begin(); it != vec.end(); it++) {
-				result.push_back(*it);
-			}
+			const Value::VectorType &vec = v->toVector();
+			result.insert(result.end(), vec.begin(), vec.end());
 		} else {
 			result.push_back(*v);
 		}
 	}
-	return ValuePtr(result);
+	return ValuePtr::takeVector(result);
 }
 
 ValuePtr builtin_lookup(const Context *, const EvalContext *evalctx)
@@ -898,6 +907,7 @@ ValuePtr builtin_version_num(const Context *ctx, const EvalContext *evalctx)
 
 ValuePtr builtin_parent_module(const Context *, const EvalContext *evalctx)
 {
+	FunctionMemo::invalidate();
 	int n;
 	double d;
 	int s = Module::stack_size();
@@ -927,7 +937,7 @@ ValuePtr builtin_norm(const Context *, const EvalContext *evalctx)
 		 ValuePtr val = evalctx->getArgValue(0);
 		if (val->type() == Value::VECTOR) {
 			double sum = 0;
-			Value::VectorType v = val->toVector();
+			const Value::VectorType &v = val->toVector();
 			size_t n = v.size();
 			for (size_t i = 0; i < n; i++)
 				if (v[i].type() == Value::NUMBER) {
@@ -958,8 +968,8 @@ ValuePtr builtin_cross(const Context *, const EvalContext *evalctx)
 		return ValuePtr::undefined;
 	}
 	
-	Value::VectorType v0 = arg0->toVector();
-	Value::VectorType v1 = arg1->toVector();
+	const Value::VectorType &v0 = arg0->toVector();
+	const Value::VectorType &v1 = arg1->toVector();
 	if ((v0.size() == 2) && (v1.size() == 2)) {
 		return ValuePtr(Value(v0[0].toDouble() * v1[1].toDouble() - v0[1].toDouble() * v1[0].toDouble()));
 	}
@@ -3,6 +3,7 @@
 #include "value.h"
 #include "typedefs.h"
 #include "feature.h"
+#include "functionmemo.h"
 
 #include <string>
 #include <vector>
@@ -50,4 +51,9 @@ public:
 	virtual std::string dump(const std::string &indent, const std::string &name) const;
         
         static Function * create(const char *name, AssignmentList &definition_arguments, Expression *expr);
+
+protected:
+	virtual ValuePtr evaluate_body(Context &c) const;
+
+	mutable FunctionMemo memo;
 };
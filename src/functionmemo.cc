@@ -0,0 +1,224 @@
+#include "functionmemo.h"
+#include "context.h"
+#include "feature.h"
+
+#include <string.h>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+
+std::vector<FunctionMemo::Recorder *> FunctionMemo::recorders;
+
+namespace /* anonymous */ {
+	/*!
+		Encoding the arguments costs about as much as evaluating a cheap
+		function, so calls with larger arguments, like long point lists, are
+		not memoized. The key is kept exact instead of hashed, since a hash
+		collision would silently return a wrong result.
+	*/
+	const size_t MAX_KEY_SIZE = 4096;
+
+	/*!
+		Appends an exact, unambiguous encoding of the value to the key. Unlike
+		Value::operator==, numbers are compared by their bits, so e.g. 0 and -0
+		are considered different.
+
+		Returns false, leaving a partial key, as soon as the key grows beyond
+		MAX_KEY_SIZE.
+	*/
+	bool appendValue(std::string &key, const Value &v)
+	{
+		switch (v.type()) {
+		case Value::UNDEFINED:
+			key += 'u';
+			break;
+		case Value::BOOL:
+			key += v.toBool() ? 't' : 'f';
+			break;
+		case Value::NUMBER: {
+			double d = v.toDouble();
+			key += 'n';
+			key.append(reinterpret_cast<const char *>(&d), sizeof(d));
+			break;
+		}
+		case Value::STRING: {
+			const std::string s = v.toString();
+			boost::uint32_t len = s.size();
+			if (key.size() + s.size() > MAX_KEY_SIZE) return false;
+			key += 's';
+			key.append(reinterpret_cast<const char *>(&len), sizeof(len));
+			key += s;
+			break;
+		}
+		case Value::VECTOR: {
+			const Value::VectorType &vec = v.toVector();
+			boost::uint32_t len = vec.size();
+			key += 'v';
+			key.append(reinterpret_cast<const char *>(&len), sizeof(len));
+			BOOST_FOREACH(const Value &e, vec) {
+				if (!appendValue(key, e)) return false;
+			}
+			break;
+		}
+		case Value::RANGE: {
+			Value::RangeType range = v.toRange();
+			double d[3] = { range.begin_value(), range.step_value(), range.end_value() };
+			key += 'r';
+			key.append(reinterpret_cast<const char *>(d), sizeof(d));
+			break;
+		}
+		}
+		return key.size() <= MAX_KEY_SIZE;
+	}
+
+	/*!
+		Estimates the memory used by a value, which is charged to the cache.
+	*/
+	size_t valueSize(const Value &v)
+	{
+		size_t size = sizeof(Value);
+		if (v.type() == Value::STRING) {
+			size += v.toString().size();
+		}
+		else if (v.type() == Value::VECTOR) {
+			BOOST_FOREACH(const Value &e, v.toVector()) size += valueSize(e);
+		}
+		return size;
+	}
+
+	typedef std::pair<std::string, ValuePtr> NamedValue;
+	bool lessByName(const NamedValue &a, const NamedValue &b) { return a.first < b.first; }
+}
+
+bool FunctionMemo::isEnabled()
+{
+	return Feature::ExperimentalFunctionMemoization.is_enabled();
+}
+
+FunctionMemo::Recorder::Recorder(const Context &c) : context(c), valid(true)
+{
+	recorders.push_back(this);
+}
+
+FunctionMemo::Recorder::~Recorder()
+{
+	recorders.pop_back();
+}
+
+void FunctionMemo::Recorder::add(const std::string &name, const ValuePtr &value)
+{
+	// Repeated lookups of an outside variable always find the same value
+	if (this->names.insert(name).second) {
+		std::string encoded;
+		if (appendValue(encoded, *value)) {
+			this->dependencies.push_back(std::make_pair(name, encoded));
+		}
+		else {
+			this->valid = false;
+		}
+	}
+}
+
+/*!
+	Builds the cache key from all variables set in the function's context.
+	Returns false if the arguments are too large to be memoized.
+*/
+bool FunctionMemo::argumentKey(const Context &c, std::string &key)
+{
+	std::vector<NamedValue> vars(c.variables.begin(), c.variables.end());
+	vars.insert(vars.end(), c.config_variables.begin(), c.config_variables.end());
+	std::sort(vars.begin(), vars.end(), lessByName);
+
+	key.clear();
+	BOOST_FOREACH(const NamedValue &var, vars) {
+		key += var.first;
+		key += '\0';
+		if (!appendValue(key, *var.second)) return false;
+	}
+	return true;
+}
+
+/*!
+	Looks up a cached result and verifies its dependencies against the
+	context of the current call.
+*/
+bool FunctionMemo::lookup(const std::string &key, const Context &c, ValuePtr &result) const
+{
+	const Entry *entry = this->cache.object(key);
+	if (!entry) return false;
+
+	typedef std::pair<std::string, std::string> Dependency;
+	BOOST_FOREACH(const Dependency &dep, entry->dependencies) {
+		std::string encoded;
+		if (!appendValue(encoded, *c.lookup_variable(dep.first, true)) ||
+				encoded != dep.second) return false;
+	}
+	result = entry->result;
+	return true;
+}
+
+void FunctionMemo::insert(const std::string &key, const ValuePtr &result, const Recorder &recorder)
+{
+	if (!recorder.valid) return;
+	Entry *entry = new Entry;
+	entry->result = result;
+	entry->dependencies = recorder.dependencies;
+
+	// Each entry is charged the memory used by its key, result and dependencies
+	size_t cost = sizeof(Entry) + key.size() + valueSize(*result);
+	typedef std::pair<std::string, std::string> Dependency;
+	BOOST_FOREACH(const Dependency &dep, entry->dependencies) {
+		cost += dep.first.size() + dep.second.size();
+	}
+	this->cache.insert(key, entry, int(cost));
+}
+
+/*!
+	Called for each lookup of a regular variable while recording. found is
+	the context the variable was found in, or NULL if it's unknown.
+
+	Lookups which resolve in a context created during the evaluation depend
+	only on the arguments. Other lookups are dependencies, but only if a
+	lookup from the function's own context would find the same variable. This
+	isn't the case for free variables of functions called from the body which
+	were defined in a different scope, so such evaluations aren't cached.
+*/
+void FunctionMemo::recordLookup(const std::string &name, const Context *found, const ValuePtr &value)
+{
+	int depth = found ? found->depth : -1;
+	for (std::vector<Recorder *>::reverse_iterator it = recorders.rbegin(); it != recorders.rend(); it++) {
+		Recorder &r = **it;
+		if (depth >= r.context.depth) break;
+		if (!r.valid) continue;
+		ValuePtr tmp;
+		if (r.context.find_variable(name, tmp) == found) {
+			r.add(name, value);
+		}
+		else {
+			r.valid = false;
+		}
+	}
+}
+
+/*!
+	Called for each lookup of a `$` variable while recording. depth is the
+	index of the context in the context stack the variable was found in, or -1.
+	Since these are dynamically scoped, a lookup from the function's context
+	always finds the same variable.
+*/
+void FunctionMemo::recordConfigLookup(const std::string &name, int depth, const ValuePtr &value)
+{
+	for (std::vector<Recorder *>::reverse_iterator it = recorders.rbegin(); it != recorders.rend(); it++) {
+		Recorder &r = **it;
+		if (depth >= r.context.depth) break;
+		if (r.valid) r.add(name, value);
+	}
+}
+
+/*!
+	Marks all evaluations in progress as not cacheable.
+*/
+void FunctionMemo::invalidate()
+{
+	BOOST_FOREACH(Recorder *r, recorders) r->valid = false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "value.h"
+#include "cache.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/unordered_set.hpp>
+
+class Context;
+
+/*!
+	Memoization of user-defined function calls, enabled by the "memoize"
+	experimental feature.
+
+	Results are cached per function, keyed by the values of all variables in
+	the function's own context, i.e. the evaluated arguments. While the body
+	is evaluated, every variable lookup which resolves outside of the call,
+	like global variables, variables of an enclosing module and `$` special
+	variables, is recorded as a dependency. A cached result is only reused if
+	all its dependencies have the same values at the time of the new call.
+
+	Evaluations which can't be described by their dependencies, e.g. calls to
+	rands(), invalidate the recording and are never cached. Neither are calls
+	with large arguments or dependencies, which are too expensive to compare.
+	The cache size is given in bytes.
+*/
+class FunctionMemo
+{
+public:
+	FunctionMemo(int maxbytes = 1024*1024) : cache(maxbytes) {}
+
+	static bool isEnabled();
+
+	/*!
+		Records the dependencies of one function evaluation. Recorders nest
+		with function calls and collect lookups for their lifetime.
+	*/
+	class Recorder
+	{
+	public:
+		Recorder(const Context &c);
+		~Recorder();
+	private:
+		const Context &context;
+		bool valid;
+		std::vector<std::pair<std::string, std::string> > dependencies;
+		boost::unordered_set<std::string> names;
+
+		void add(const std::string &name, const ValuePtr &value);
+
+		friend class FunctionMemo;
+	};
+
+	static bool argumentKey(const Context &c, std::string &key);
+	bool lookup(const std::string &key, const Context &c, ValuePtr &result) const;
+	void insert(const std::string &key, const ValuePtr &result, const Recorder &recorder);
+	void clear() { cache.clear(); }
+
+	static bool isRecording() { return !recorders.empty(); }
+	static void recordLookup(const std::string &name, const Context *found, const ValuePtr &value);
+	static void recordConfigLookup(const std::string &name, int depth, const ValuePtr &value);
+	static void invalidate();
+
+private:
+	struct Entry {
+		ValuePtr result;
+		std::vector<std::pair<std::string, std::string> > dependencies;
+	};
+	mutable Cache<std::string, Entry> cache;
+
+	static std::vector<Recorder *> recorders;
+};
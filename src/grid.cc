@@ -1,4 +1,5 @@
 #include "grid.h"
+#include <boost/cstdint.hpp>
 
 namespace Eigen {
 		size_t hash_value(Vector3f const &v) {
@@ -17,3 +18,99 @@ namespace Eigen {
 			return seed;
 		}
 }
+
+namespace {
+	size_t hash_gridkey(const Vector3l &k)
+	{
+		boost::uint64_t h = boost::uint64_t(k[0]) * 0x9E3779B97F4A7C15ULL;
+		h ^= boost::uint64_t(k[1]) * 0xC2B2AE3D27D4EB4FULL;
+		h ^= boost::uint64_t(k[2]) * 0x165667B19E3779F9ULL;
+		h ^= h >> 29;
+		h *= 0xBF58476D1CE4E5B9ULL;
+		h ^= h >> 32;
+		return size_t(h);
+	}
+}
+
+GridWelder::GridWelder(double resolution, size_t expectedvertices)
+	: res(resolution), mask(0), count(0)
+{
+	size_t capacity = 16;
+	while (capacity < 2 * expectedvertices) capacity *= 2;
+	rehash(capacity);
+}
+
+const GridWelder::Slot *GridWelder::find(const Vector3l &key) const
+{
+	for (size_t i = hash_gridkey(key) & this->mask;; i = (i + 1) & this->mask) {
+		const Slot &slot = this->slots[i];
+		if (slot.index < 0) return NULL;
+		if (slot.key == key) return &slot;
+	}
+}
+
+void GridWelder::insert(const Vector3l &key, int index)
+{
+	size_t i = hash_gridkey(key) & this->mask;
+	while (this->slots[i].index >= 0) i = (i + 1) & this->mask;
+	this->slots[i].key = key;
+	this->slots[i].index = index;
+}
+
+void GridWelder::rehash(size_t capacity)
+{
+	std::vector<Slot> old;
+	old.swap(this->slots);
+	Slot empty;
+	empty.key.setZero();
+	empty.index = -1;
+	this->slots.resize(capacity, empty);
+	this->mask = capacity - 1;
+	for (size_t i=0;i<old.size();i++) {
+		if (old[i].index >= 0) insert(old[i].key, old[i].index);
+	}
+}
+
+/*!
+	Aligns v to the grid, or to an existing vertex in a neighboring grid cell.
+	Returns the index of the welded vertex. New vertices get consecutive indices
+	starting at 0.
+*/
+int GridWelder::align(Vector3d &v)
+{
+	Vector3l key(int64_t(v[0] / this->res), int64_t(v[1] / this->res), int64_t(v[2] / this->res));
+	const Slot *slot = find(key);
+	if (!slot) {
+		float dist = 10.0f; // > max possible distance
+		for (int64_t jx = key[0] - 1; jx <= key[0] + 1; jx++) {
+			for (int64_t jy = key[1] - 1; jy <= key[1] + 1; jy++) {
+				for (int64_t jz = key[2] - 1; jz <= key[2] + 1; jz++) {
+					Vector3l k(jx, jy, jz);
+					const Slot *tmpslot = find(k);
+					if (!tmpslot) continue;
+					float d = sqrt((key-k).squaredNorm());
+					if (d < dist) {
+						dist = d;
+						slot = tmpslot;
+					}
+				}
+			}
+		}
+	}
+
+	int index;
+	if (!slot) {
+		index = this->count++;
+		if (2 * this->count > this->slots.size()) rehash(2 * this->slots.size());
+		insert(key, index);
+	}
+	else {
+		key = slot->key;
+		index = slot->index;
+	}
+
+	v[0] = key[0] * this->res;
+	v[1] = key[1] * this->res;
+	v[2] = key[2] * this->res;
+	return index;
+}
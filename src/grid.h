@@ -11,6 +11,7 @@ typedef __int64 int64_t;
 #include <stdlib.h>
 #include <boost/unordered_map.hpp>
 #include <utility>
+#include <vector>
 
 //const double GRID_COARSE = 0.001;
 //const double GRID_FINE   = 0.000001;
@@ -181,3 +182,35 @@ public:
 	}
 
 };
+
+/*!
+	Welds vertices to a 3D grid, giving each distinct grid vertex an index.
+
+	Behaves exactly like Grid3d<int>::align(), but uses an open addressing hash
+	table with linear probing instead of a node based map, so welding millions
+	of vertices doesn't allocate per vertex. Pass the expected number of input
+	vertices to avoid rehashing.
+*/
+class GridWelder
+{
+public:
+	GridWelder(double resolution, size_t expectedvertices = 0);
+
+	int align(Vector3d &v);
+	size_t size() const { return this->count; }
+
+private:
+	struct Slot {
+		Vector3l key;
+		int index; // -1 if the slot is empty
+	};
+
+	const Slot *find(const Vector3l &key) const;
+	void insert(const Vector3l &key, int index);
+	void rehash(size_t capacity);
+
+	double res;
+	std::vector<Slot> slots;
+	size_t mask;
+	size_t count;
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <string>
+
+class PolySet *import_stl(const std::string &filename);
@@ -0,0 +1,303 @@
+/*
+ *  OpenSCAD (www.openscad.org)
+ *  Copyright (C) 2009-2011 Clifford Wolf <clifford@clifford.at> and
+ *                          Marius Kintel <marius@kintel.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  As a special exception, you have permission to link this program
+ *  with the CGAL library and distribute executables, as long as you
+ *  follow the requirements of the GNU GPL in regard to all of the
+ *  software in the executable aside from CGAL.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "import.h"
+#include "polyset.h"
+#include "printutils.h"
+
+#include <string.h>
+#include <vector>
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/detail/endian.hpp>
+#include <boost/cstdint.hpp>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using boost::uint32_t;
+
+namespace {
+
+	/*!
+		Read-only view of a whole file. Uses mmap() where available, otherwise
+		(or if mapping fails) the file is read into memory. data is NULL for an
+		empty file; opened tells it apart from a file which couldn't be read.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::string &filename) : data(NULL), size(0), opened(false), mapped(false) {
+#ifndef _WIN32
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd >= 0) {
+				struct stat st;
+				if (fstat(fd, &st) == 0 && st.st_size > 0) {
+					void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (ptr != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+						madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+#endif
+						this->data = static_cast<const char *>(ptr);
+						this->size = st.st_size;
+						this->opened = true;
+						this->mapped = true;
+					}
+				}
+				::close(fd);
+				if (this->mapped) return;
+			}
+#endif
+			std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+			if (!f.good()) return;
+			std::streamoff len = f.tellg();
+			if (len < 0) return;
+			this->opened = true;
+			if (len == 0) return;
+			this->buffer.resize(len);
+			f.seekg(0);
+			f.read(&this->buffer[0], len);
+			if (f.gcount() != len) {
+				this->buffer.clear();
+				this->opened = false;
+				return;
+			}
+			this->data = &this->buffer[0];
+			this->size = len;
+		}
+		~MappedFile() {
+#ifndef _WIN32
+			if (this->mapped) munmap(const_cast<char *>(this->data), this->size);
+#endif
+		}
+
+		const char *data;
+		size_t size;
+		bool opened;
+
+	private:
+		bool mapped;
+		std::vector<char> buffer;
+	};
+
+	const size_t STL_HEADER_NUMBYTES = 80 + 4;
+	const size_t STL_FACET_NUMBYTES = 4*3*4 + 2;
+
+	// as there is no 'float32_t' standard, we assume the systems 'float'
+	// is a 'binary32' aka 'single' standard IEEE 32-bit floating point type
+	inline uint32_t read_uint32(const char *p)
+	{
+		const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+		return uint32_t(u[0]) | (uint32_t(u[1]) << 8) | (uint32_t(u[2]) << 16) | (uint32_t(u[3]) << 24);
+	}
+
+	inline float read_float(const char *p)
+	{
+		float f;
+#ifdef BOOST_BIG_ENDIAN
+		uint32_t x = read_uint32(p);
+		memcpy(&f, &x, 4);
+#else
+		memcpy(&f, p, 4);
+#endif
+		return f;
+	}
+
+	void read_binary_stl(const char *data, uint32_t facenum, PolySet &ps)
+	{
+		ps.polygons.reserve(facenum);
+		const char *facet = data + STL_HEADER_NUMBYTES;
+		for (uint32_t i=0;i<facenum;i++, facet += STL_FACET_NUMBYTES) {
+			// Skip the normal, and ignore the attribute byte count
+			const char *v = facet + 3*4;
+			ps.append_poly();
+			for (int j=0;j<3;j++, v += 3*4) {
+				ps.append_vertex(read_float(v), read_float(v + 4), read_float(v + 8));
+			}
+		}
+	}
+
+	inline bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+	}
+
+	inline const char *skip_space(const char *p, const char *end)
+	{
+		while (p < end && is_space(*p)) p++;
+		return p;
+	}
+
+	inline const char *token_end(const char *p, const char *end)
+	{
+		while (p < end && !is_space(*p)) p++;
+		return p;
+	}
+
+	inline bool token_equals(const char *p, const char *end, const char *str)
+	{
+		size_t len = strlen(str);
+		return size_t(end - p) == len && !memcmp(p, str, len);
+	}
+
+	/*!
+		Parses a decimal floating point number from [p, end).
+		Numbers which are exactly representable from their mantissa and a small
+		power of ten are converted directly, since that's exact (i.e. gives the same
+		result as a correctly rounding parser). Everything else is left to
+		lexical_cast. Throws boost::bad_lexical_cast on invalid input.
+	*/
+	double parse_double(const char *p, const char *end)
+	{
+		static const double pow10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		const char *s = p;
+		bool negative = false;
+		if (s < end && (*s == '-' || *s == '+')) negative = (*s++ == '-');
+
+		boost::uint64_t mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool valid = false;
+		for (;s < end && *s >= '0' && *s <= '9';s++, valid = true) {
+			if (mantissa == 0 && *s == '0') continue;
+			mantissa = mantissa * 10 + (*s - '0');
+			digits++;
+		}
+		if (s < end && *s == '.') {
+			for (s++;s < end && *s >= '0' && *s <= '9';s++, valid = true) {
+				if (mantissa == 0 && *s == '0') { exponent--; continue; }
+				mantissa = mantissa * 10 + (*s - '0');
+				digits++;
+				exponent--;
+			}
+		}
+		if (valid && s < end && (*s == 'e' || *s == 'E')) {
+			s++;
+			bool expnegative = false;
+			if (s < end && (*s == '-' || *s == '+')) expnegative = (*s++ == '-');
+			int e = 0;
+			bool expvalid = false;
+			for (;s < end && *s >= '0' && *s <= '9';s++, expvalid = true) {
+				if (e < 10000) e = e * 10 + (*s - '0');
+			}
+			if (!expvalid) valid = false;
+			exponent += expnegative ? -e : e;
+		}
+
+		if (valid && s == end && digits <= 15 && exponent >= -22 && exponent <= 22) {
+			double value = double(mantissa);
+			if (exponent < 0) value /= pow10[-exponent];
+			else value *= pow10[exponent];
+			return negative ? -value : value;
+		}
+		return boost::lexical_cast<double>(std::string(p, end));
+	}
+
+	void read_ascii_stl(const char *data, size_t size, PolySet &ps)
+	{
+		const char *end = data + size;
+		// Skip the "solid <name>" line
+		const char *line = static_cast<const char *>(memchr(data, '\n', size));
+		int i = 0;
+		double vdata[3][3];
+		while (line && line < end) {
+			const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+			if (!eol) eol = end;
+
+			const char *tok = skip_space(line, eol);
+			const char *tokend = token_end(tok, eol);
+			if (token_equals(tok, tokend, "outer")) {
+				i = 0;
+			}
+			else if (token_equals(tok, tokend, "vertex") && i < 3) {
+				try {
+					const char *p = tokend;
+					for (int v=0;v<3;v++) {
+						p = skip_space(p, eol);
+						const char *numend = token_end(p, eol);
+						if (p == numend) throw boost::bad_lexical_cast();
+						vdata[i][v] = parse_double(p, numend);
+						p = numend;
+					}
+				}
+				catch (const boost::bad_lexical_cast &blc) {
+					PRINTB("WARNING: Can't parse vertex line '%s'.", std::string(tok, eol));
+					i = 10;
+				}
+				if (i < 3 && ++i == 3) {
+					ps.append_poly();
+					ps.append_vertex(vdata[0][0], vdata[0][1], vdata[0][2]);
+					ps.append_vertex(vdata[1][0], vdata[1][1], vdata[1][2]);
+					ps.append_vertex(vdata[2][0], vdata[2][1], vdata[2][2]);
+				}
+			}
+			line = eol + 1;
+		}
+	}
+}
+
+/*!
+	Imports an ASCII or binary STL file. The file is memory mapped and parsed
+	in place. Vertex coordinates are kept exactly as read; snapping to the grid
+	is left to the conversion to CGAL.
+
+	Returns an empty PolySet if the import failed, but not NULL.
+*/
+PolySet *import_stl(const std::string &filename)
+{
+	PolySet *p = new PolySet(3);
+
+	MappedFile file(filename);
+	if (!file.opened) {
+		PRINTB("WARNING: Can't open import file '%s'.", filename);
+		return p;
+	}
+	// An empty file gives an empty object, like an STL file without facets
+	if (!file.data) return p;
+
+	bool binary = false;
+	uint32_t facenum = 0;
+	if (file.size >= STL_HEADER_NUMBYTES) {
+		facenum = read_uint32(file.data + 80);
+		binary = file.size == STL_HEADER_NUMBYTES + STL_FACET_NUMBYTES * size_t(facenum);
+	}
+
+	if (binary) {
+		read_binary_stl(file.data, facenum, *p);
+	}
+	else if (file.size > 5 && !memcmp(file.data, "solid", 5)) {
+		read_ascii_stl(file.data, file.size, *p);
+	}
+
+	return p;
+}
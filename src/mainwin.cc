@@ -103,6 +103,7 @@
 #ifdef ENABLE_CGAL
 
 #include "CGALCache.h"
+#include "ConvexDecompositionCache.h"
 #include "GeometryEvaluator.h"
 #include "CGALRenderer.h"
 #include "CGAL_Nef_polyhedron.h"
@@ -222,8 +223,8 @@ MainWindow::MainWindow(const QString &filename)
 
 #ifdef ENABLE_CGAL
 	this->cgalworker = new CGALWorker();
-	connect(this->cgalworker, SIGNAL(done(shared_ptr<const Geometry>)), 
-					this, SLOT(actionRenderDone(shared_ptr<const Geometry>)));
+	connect(this->cgalworker, SIGNAL(done(shared_ptr<const Geometry>, shared_ptr<CGALRenderBuffer>)), 
+					this, SLOT(actionRenderDone(shared_ptr<const Geometry>, shared_ptr<CGALRenderBuffer>)));
 #endif
 
 	top_ctx.registerBuiltin();
@@ -1028,8 +1029,9 @@ void MainWindow::instantiateRoot()
 	delete this->thrownTogetherRenderer;
 	this->thrownTogetherRenderer = NULL;
 
-	// Remove previous CSG tree
-	delete this->absolute_root_node;
+	// Remove previous CSG tree. Unchanged subtrees are moved into the new tree,
+	// so it's deleted after instantiation.
+	AbstractNode *previous_root = this->absolute_root_node;
 	this->absolute_root_node = NULL;
 
 	this->root_raw_term.reset();
@@ -1047,7 +1049,7 @@ void MainWindow::instantiateRoot()
 	this->background_chain = NULL;
 
 	this->root_node = NULL;
-	this->tree.setRoot(NULL);
+	const bool treehadabsoluteroot = previous_root && this->tree.root() == previous_root;
 
 	if (this->root_module) {
 		// Evaluate CSG tree
@@ -1060,20 +1062,34 @@ void MainWindow::instantiateRoot()
 		ModuleInstantiation mi = ModuleInstantiation( "group" );
 		this->root_inst = mi;
 
-		this->absolute_root_node = this->root_module->instantiate(&top_ctx, &this->root_inst, NULL);
+		this->absolute_root_node = this->root_module->instantiateCached(&top_ctx, &this->root_inst, &this->instantiation_cache);
 
 		if (this->absolute_root_node) {
+			std::vector<std::pair<size_t, size_t> > moved;
+			this->instantiation_cache.renumber(*this->absolute_root_node, moved);
+
 			// Do we have an explicit root node (! modifier)?
 			if (!(this->root_node = find_root_tag(this->absolute_root_node))) {
 				this->root_node = this->absolute_root_node;
 			}
 			// FIXME: Consider giving away ownership of root_node to the Tree, or use reference counted pointers
-			this->tree.setRoot(this->root_node);
+			// Cached dumps are indented by depth, so only keep them if the tree root didn't move
+			if (treehadabsoluteroot && this->root_node == this->absolute_root_node) {
+				this->tree.setRoot(this->root_node, moved);
+			}
+			else {
+				this->tree.setRoot(this->root_node);
+			}
 			// Dump the tree (to initialize caches).
 			// FIXME: We shouldn't really need to do this explicitly..
 			this->tree.getString(*this->root_node);
 		}
 	}
+	else {
+		this->instantiation_cache.clear();
+	}
+	if (!this->root_node) this->tree.setRoot(NULL);
+	delete previous_root;
 
 	if (!this->root_node) {
 		if (parser_error_pos < 0) {
@@ -1810,7 +1826,7 @@ void MainWindow::cgalRender()
 	this->cgalworker->start(this->tree);
 }
 
-void MainWindow::actionRenderDone(shared_ptr<const Geometry> root_geom)
+void MainWindow::actionRenderDone(shared_ptr<const Geometry> root_geom, shared_ptr<CGALRenderBuffer> buffer)
 {
 	progress_report_fin();
 
@@ -1854,7 +1870,7 @@ void MainWindow::actionRenderDone(shared_ptr<const Geometry> root_geom)
 		PRINT("Rendering finished.");
 
 		this->root_geom = root_geom;
-		this->cgalRenderer = new CGALRenderer(root_geom);
+		this->cgalRenderer = new CGALRenderer(root_geom, buffer);
 		// Go to CGAL view mode
 		if (viewActionWireframe->isChecked()) viewModeWireframe();
 		else viewModeSurface();
@@ -2190,6 +2206,7 @@ void MainWindow::actionFlushCaches()
 	GeometryCache::instance()->clear();
 #ifdef ENABLE_CGAL
 	CGALCache::instance()->clear();
+	ConvexDecompositionCache::instance()->clear();
 #endif
 	dxf_dim_cache.clear();
 	dxf_cross_cache.clear();
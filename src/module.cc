@@ -26,6 +26,7 @@
 
 #include "module.h"
 #include "ModuleCache.h"
+#include "InstantiationCache.h"
 #include "node.h"
 #include "modcontext.h"
 #include "evalcontext.h"
@@ -346,7 +347,15 @@ bool FileModule::handleDependencies()
 AbstractNode *FileModule::instantiate(const Context *ctx, const ModuleInstantiation *inst, EvalContext *evalctx)
 {
 	assert(evalctx == NULL);
-	
+	return instantiateCached(ctx, inst, NULL);
+}
+
+/*!
+	Instantiates the top-level statements, reusing the nodes of statements which
+	are unchanged since the previous instantiation through \a cache, if given.
+*/
+AbstractNode *FileModule::instantiateCached(const Context *ctx, const ModuleInstantiation *inst, InstantiationCache *cache)
+{
 	delete context;
 	context = new FileContext(*this, ctx);
 	AbstractNode *node = new AbstractNode(inst);
@@ -359,7 +368,9 @@ AbstractNode *FileModule::instantiate(const Context *ctx, const ModuleInstantiat
 		c.dump(this, inst);
 #endif
 
-		std::vector<AbstractNode *> instantiatednodes = this->scope.instantiateChildren(context);
+		std::vector<AbstractNode *> instantiatednodes = cache ?
+			cache->instantiateChildren(*this, *context, *node) :
+			this->scope.instantiateChildren(context);
 		node->children.insert(node->children.end(), instantiatednodes.begin(), instantiatednodes.end());
 	}
 	catch (RecursionException &e) {
@@ -43,6 +43,17 @@ public:
 		this->cache.clear();
 	}
 
+	void swap(NodeCache &other) {
+		this->cache.swap(other.cache);
+	}
+
+	/*! Moves the string cached at index from in other to index to in this cache. */
+	void take(NodeCache &other, size_t from, size_t to) {
+		if (other.cache.size() <= from || other.cache[from].empty()) return;
+		if (this->cache.size() <= to) this->cache.resize(to + 1);
+		this->cache[to].swap(other.cache[from]);
+	}
+
 private:
   std::vector<std::string> cache;
 	std::string nullvalue;
@@ -67,7 +67,11 @@ std::string NodeDumper::dumpChildren(const AbstractNode &node)
 */
 Response NodeDumper::visit(State &state, const AbstractNode &node)
 {
-	if (isCached(node)) return PruneTraversal;
+	if (isCached(node)) {
+		// A cached subtree is still part of its parent's dump
+		handleVisitedChildren(state, node);
+		return PruneTraversal;
+	}
 
 	handleIndent(state);
 	if (state.isPostfix()) {
@@ -0,0 +1,151 @@
+#include "nodehasher.h"
+#include "state.h"
+#include "module.h"
+
+#include <assert.h>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+
+using boost::uint64_t;
+using boost::uint8_t;
+
+namespace {
+	inline uint64_t rotl64(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t fmix64(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	inline uint64_t getblock64(const uint8_t *p)
+	{
+		uint64_t k = 0;
+		for (int i=7;i>=0;i--) k = (k << 8) | p[i];
+		return k;
+	}
+
+	/*!
+		MurmurHash3 (x64, 128 bit variant), returned as a 32 character hex string.
+		Reads blocks byte by byte so the result doesn't depend on endianness.
+	*/
+	std::string murmurhash3_128(const std::string &str)
+	{
+		const uint8_t *data = reinterpret_cast<const uint8_t *>(str.data());
+		const size_t len = str.size();
+		const size_t nblocks = len / 16;
+		const uint64_t c1 = 0x87c37b91114253d5ULL;
+		const uint64_t c2 = 0x4cf5ad432745937fULL;
+		uint64_t h1 = 0, h2 = 0;
+
+		for (size_t i=0;i<nblocks;i++) {
+			uint64_t k1 = getblock64(data + i*16);
+			uint64_t k2 = getblock64(data + i*16 + 8);
+			k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+			h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+			k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+			h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+		}
+
+		const uint8_t *tail = data + nblocks * 16;
+		uint64_t k1 = 0, k2 = 0;
+		switch (len & 15) {
+		case 15: k2 ^= uint64_t(tail[14]) << 48;
+		case 14: k2 ^= uint64_t(tail[13]) << 40;
+		case 13: k2 ^= uint64_t(tail[12]) << 32;
+		case 12: k2 ^= uint64_t(tail[11]) << 24;
+		case 11: k2 ^= uint64_t(tail[10]) << 16;
+		case 10: k2 ^= uint64_t(tail[9]) << 8;
+		case  9: k2 ^= uint64_t(tail[8]);
+			k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		case  8: k1 ^= uint64_t(tail[7]) << 56;
+		case  7: k1 ^= uint64_t(tail[6]) << 48;
+		case  6: k1 ^= uint64_t(tail[5]) << 40;
+		case  5: k1 ^= uint64_t(tail[4]) << 32;
+		case  4: k1 ^= uint64_t(tail[3]) << 24;
+		case  3: k1 ^= uint64_t(tail[2]) << 16;
+		case  2: k1 ^= uint64_t(tail[1]) << 8;
+		case  1: k1 ^= uint64_t(tail[0]);
+			k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		}
+
+		h1 ^= len; h2 ^= len;
+		h1 += h2; h2 += h1;
+		h1 = fmix64(h1); h2 = fmix64(h2);
+		h1 += h2; h2 += h1;
+
+		static const char hexdigits[] = "0123456789abcdef";
+		std::string digest(32, '0');
+		for (int i=0;i<16;i++) {
+			digest[15 - i] = hexdigits[h1 & 0xf]; h1 >>= 4;
+			digest[31 - i] = hexdigits[h2 & 0xf]; h2 >>= 4;
+		}
+		return digest;
+	}
+}
+
+/*!
+	Removes all whitespace except inside string literals, so that equivalent
+	nodes with different formatting get the same ID.
+*/
+std::string NodeHasher::stripWhitespace(const std::string &str)
+{
+	std::string result;
+	result.reserve(str.size());
+	const size_t len = str.size();
+	size_t i = 0;
+	while (i < len) {
+		const char c = str[i];
+		if (c == '"') {
+			// Find the end of the string literal, skipping escaped characters
+			size_t end = i + 1;
+			while (end < len && str[end] != '"') end += (str[end] == '\\') ? 2 : 1;
+			if (end < len) {
+				result.append(str, i, end - i + 1);
+				i = end + 1;
+			}
+			else {
+				// Unterminated quote; drop it
+				i++;
+			}
+		}
+		else {
+			if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\v') result += c;
+			i++;
+		}
+	}
+	return result;
+}
+
+/*!
+	Called for each node in the tree. Children are hashed before their parent,
+	so the postfix visit can combine their hashes.
+*/
+Response NodeHasher::visit(State &state, const AbstractNode &node)
+{
+	if (this->cache.contains(node)) return PruneTraversal;
+
+	if (state.isPostfix()) {
+		// Prefix with the length so the node's own string can't be confused with child hashes
+		const std::string str = stripWhitespace(node.toString());
+		this->buffer.clear();
+		for (int i=0;i<8;i++) this->buffer += char((uint64_t(str.size()) >> (i*8)) & 0xff);
+		this->buffer += str;
+		BOOST_FOREACH(const AbstractNode *child, node.getChildren()) {
+			assert(this->cache.contains(*child));
+			this->buffer += '{';
+			if (child->modinst->isBackground()) this->buffer += '%';
+			if (child->modinst->isHighlight()) this->buffer += '#';
+			this->buffer += this->cache[*child];
+		}
+		this->cache.insert(node, murmurhash3_128(this->buffer));
+	}
+	return ContinueTraversal;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include "visitor.h"
+#include "nodecache.h"
+
+/*!
+	Computes a structural hash of each subtree and stores it in the given
+	NodeCache as a 32 character hex string.
+
+	The hash of a node is computed from its own (whitespace stripped) string
+	representation and the hashes of its children, so equivalent subtrees get
+	the same hash regardless of where they appear in the tree.
+*/
+class NodeHasher : public Visitor
+{
+public:
+	NodeHasher(NodeCache &cache) : cache(cache) { }
+	virtual ~NodeHasher() {}
+
+	virtual Response visit(State &state, const AbstractNode &node);
+
+	static std::string stripWhitespace(const std::string &str);
+
+private:
+	NodeCache &cache;
+	std::string buffer;
+};
@@ -42,14 +42,21 @@
 #include "stackcheck.h"
 #include "CocoaUtils.h"
 #include "FontCache.h"
+#include "parallel.h"
+#include "DiskCache.h"
+#include "GeometryCache.h"
+#include "CGALCache.h"
 
 #include <string>
 #include <vector>
+#include <set>
 #include <fstream>
+#include <algorithm>
 
 #ifdef ENABLE_CGAL
 #include "CGAL_Nef_polyhedron.h"
 #include "cgalutils.h"
+#include "GeometryProfiler.h"
 #endif
 
 #include "csgterm.h"
@@ -89,6 +96,8 @@ std::string commandline_commands;
 std::string currentdir;
 static bool arg_info = false;
 static std::string arg_colorscheme;
+static std::string arg_export_format;
+static std::string arg_profile;
 
 #define QUOTE(x__) # x__
 #define QUOTED(x__) QUOTE(x__)
@@ -133,7 +142,7 @@ static void help(const char *progname, bool failure = false)
   for (int i=0;i<tablen;i++) tabstr[i] = ' ';
   tabstr[tablen] = '\0';
 
-	PRINTB("Usage: %1% [ -o output_file [ -d deps_file ] ]\\\n"
+	PRINTB("Usage: %1% [ -o output_file [ -d deps_file ] [ --export-format=asciistl|binstl ] ]\\\n"
          "%2%[ -m make_command ] [ -D var=val [..] ] \\\n"
 	 "%2%[ --help ] print this help message and exit \\\n"
          "%2%[ --version ] [ --info ] \\\n"
@@ -143,8 +152,11 @@ static void help(const char *progname, bool failure = false)
          "%2%[ --viewall ] \\\n"
          "%2%[ --imgsize=width,height ] [ --projection=(o)rtho|(p)ersp] \\\n"
          "%2%[ --render | --preview[=throwntogether] ] \\\n"
+         "%2%[ --views=file [ --variants=file ] ] \\\n"
          "%2%[ --colorscheme=[Cornfield|Sunset|Metallic|Starnight|BeforeDawn|Nature|DeepOcean] ] \\\n"
-         "%2%[ --csglimit=num ]"
+         "%2%[ --csglimit=num ] [ --jobs=num ] \\\n"
+         "%2%[ --cache-dir=dir [ --cache-size=MB ] ] [ --cache-stats ] \\\n"
+         "%2%[ --profile=file.json ]"
 #ifdef ENABLE_EXPERIMENTAL
          " [ --enable=<feature> ]"
 #endif
@@ -272,6 +284,97 @@ Camera get_camera(po::variables_map vm)
 	return camera;
 }
 
+/*!
+	Reads the views for --views: one per line, a name followed by any of the
+	--camera, --imgsize, --projection, --viewall and --autocenter options.
+	Options not given on a line are taken from \a defaults.
+*/
+static bool read_png_views(const std::string &filename, const po::variables_map &defaults, vector<PngView> &views)
+{
+	std::ifstream ifs(filename.c_str());
+	if (!ifs.is_open()) {
+		PRINTB("Can't open views file '%s'!", filename);
+		return false;
+	}
+
+	po::options_description desc;
+	desc.add_options()
+		("camera", po::value<string>())
+		("imgsize", po::value<string>())
+		("projection", po::value<string>())
+		("autocenter", "")
+		("viewall", "");
+
+	std::set<string> names;
+	string line;
+	while (std::getline(ifs, line)) {
+		boost::algorithm::trim(line);
+		if (line.empty() || line[0] == '#') continue;
+		vector<string> args;
+		boost::split(args, line, is_any_of(" \t"), boost::token_compress_on);
+		po::variables_map vm;
+		try {
+			po::store(po::command_line_parser(vector<string>(args.begin() + 1, args.end())).options(desc).run(), vm);
+		}
+		catch (const std::exception &e) {
+			PRINTB("Invalid view '%s': %s", args[0] % e.what());
+			return false;
+		}
+		BOOST_FOREACH(const po::variables_map::value_type &opt, defaults) {
+			if (!vm.count(opt.first)) vm.insert(opt);
+		}
+		// The names end up in the output filenames, so they must be unique
+		if (!names.insert(args[0]).second) {
+			PRINTB("Duplicate view '%s' in '%s'", args[0] % filename);
+			return false;
+		}
+		PngView view;
+		view.filename = args[0];
+		view.camera = get_camera(vm);
+		views.push_back(view);
+	}
+	if (views.empty()) {
+		PRINTB("No views in '%s'", filename);
+		return false;
+	}
+	return true;
+}
+
+struct Variant {
+	string name;
+	string commands;
+};
+
+/*!
+	Reads the variants for --variants: one per line, a name followed by
+	assignments like those given with -D, separated by semicolons.
+*/
+static bool read_variants(const std::string &filename, vector<Variant> &variants)
+{
+	std::ifstream ifs(filename.c_str());
+	if (!ifs.is_open()) {
+		PRINTB("Can't open variants file '%s'!", filename);
+		return false;
+	}
+
+	std::set<string> names;
+	string line;
+	while (std::getline(ifs, line)) {
+		boost::algorithm::trim(line);
+		if (line.empty() || line[0] == '#') continue;
+		size_t pos = line.find_first_of(" \t");
+		Variant variant;
+		variant.name = line.substr(0, pos);
+		if (!names.insert(variant.name).second) {
+			PRINTB("Duplicate variant '%s' in '%s'", variant.name % filename);
+			return false;
+		}
+		if (pos != string::npos) variant.commands = line.substr(pos + 1) + ";\n";
+		variants.push_back(variant);
+	}
+	return true;
+}
+
 #ifdef OPENSCAD_TESTING
 #undef OPENSCAD_QTGUI
 #else
@@ -316,7 +419,88 @@ void set_render_color_scheme(const std::string color_scheme, const bool exit_if_
 	}
 }
 
-int cmdline(const char *deps_output_file, const std::string &filename, Camera &camera, const char *output_file, const fs::path &original_path, Render::type renderer, int argc, char ** argv )
+#ifdef ENABLE_CGAL
+/*!
+	Exports all views of all variants of the design as png images. Each variant
+	is parsed and evaluated once, then drawn from every view in the same
+	offscreen context. The images are named after the output file, e.g.
+	out-<variant>-<view>.png for out.png.
+*/
+static int export_png_batch(const std::string &filename, const vector<PngView> &views,
+	const vector<Variant> &variants, const char *output_file, const fs::path &original_path,
+	Render::type renderer, ModuleContext &top_ctx)
+{
+	std::ifstream ifs(filename.c_str());
+	if (!ifs.is_open()) {
+		PRINTB("Can't open input file '%s'!\n", filename.c_str());
+		return 1;
+	}
+	std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	text += "\n" + commandline_commands;
+	fs::path fpath = boosty::absolute(fs::path(filename));
+	fs::path fparent = fpath.parent_path();
+	std::string parentpath = boosty::stringy(fparent);
+
+	// Images are written by worker threads while the next variant is evaluated
+	// in the document directory, so make their names absolute
+	const fs::path outpath = boosty::absolute(fs::path(output_file));
+	std::string outprefix = boosty::stringy(outpath);
+	outprefix.erase(outprefix.size() - boosty::extension_str(outpath).size());
+
+	size_t width = 0, height = 0;
+	BOOST_FOREACH(const PngView &view, views) {
+		width = std::max<size_t>(width, view.camera.pixel_width);
+		height = std::max<size_t>(height, view.camera.pixel_height);
+	}
+	PngBatchExporter exporter(width, height, Parallel::maxThreads());
+	if (!exporter.isValid()) return 1;
+
+	vector<PngView> images(views);
+	BOOST_FOREACH(const Variant &variant, variants) {
+		const std::string prefix = variant.name.empty() ? outprefix : outprefix + "-" + variant.name;
+		for (size_t i=0;i<views.size();i++) images[i].filename = prefix + "-" + views[i].filename + ".png";
+
+		FileModule *root_module = parse((text + variant.commands).c_str(), parentpath.c_str(), false);
+		if (!root_module) {
+			PRINTB("Can't parse file '%s'!\n", filename.c_str());
+			return 1;
+		}
+		root_module->handleDependencies();
+
+		fs::current_path(fparent);
+		top_ctx.setDocumentPath(fparent.string());
+
+		AbstractNode::resetIndexCounter();
+		ModuleInstantiation root_inst("group");
+		AbstractNode *absolute_root_node = root_module->instantiate(&top_ctx, &root_inst, NULL);
+		AbstractNode *root_node = find_root_tag(absolute_root_node);
+		if (!root_node) root_node = absolute_root_node;
+
+		Tree tree(root_node);
+		if (renderer == Render::CGAL || renderer == Render::GEOMETRY) {
+			GeometryEvaluator geomevaluator(tree);
+			shared_ptr<const Geometry> root_geom = geomevaluator.evaluateGeometry(*tree.root(), true);
+			if (!root_geom) root_geom.reset(new CGAL_Nef_polyhedron());
+			if (renderer == Render::CGAL && root_geom->getDimension() == 3 &&
+					!dynamic_cast<const CGAL_Nef_polyhedron*>(root_geom.get())) {
+				root_geom.reset(CGALUtils::createNefPolyhedronFromGeometry(*root_geom));
+			}
+			exporter.render(root_geom, images);
+		}
+		else {
+			exporter.preview(tree, renderer == Render::THROWNTOGETHER, images);
+		}
+		fs::current_path(original_path);
+
+		delete absolute_root_node;
+		delete root_module;
+	}
+
+	return exporter.finish() ? 0 : 1;
+}
+#endif
+
+int cmdline(const char *deps_output_file, const std::string &filename, Camera &camera, const char *output_file, const fs::path &original_path, Render::type renderer, const vector<PngView> &views, const vector<Variant> &variants, int argc, char ** argv )
 {
 #ifdef OPENSCAD_QTGUI
 	QCoreApplication app(argc, argv);
@@ -377,6 +561,19 @@ int cmdline(const char *deps_output_file, const std::string &filename, Camera &c
 	if (echo_output_file)
 		echostream.reset( new Echostream( echo_output_file ) );
 
+	if (!views.empty()) {
+		if (!png_output_file) {
+			PRINT("--views requires a png output file");
+			return 1;
+		}
+#ifdef ENABLE_CGAL
+		return export_png_batch(filename, views, variants, png_output_file, original_path, renderer, top_ctx);
+#else
+		PRINT("OpenSCAD has been compiled without CGAL support!\n");
+		return 1;
+#endif
+	}
+
 	FileModule *root_module;
 	ModuleInstantiation root_inst("group");
 	AbstractNode *root_node;
@@ -467,6 +664,15 @@ int cmdline(const char *deps_output_file, const std::string &filename, Camera &c
 			// echo or OpenCSG png -> don't necessarily need geometry evaluation
 		} else {
 			root_geom = geomevaluator.evaluateGeometry(*tree.root(), true);
+			if (!arg_profile.empty()) {
+				// The collapsed stacks go next to the report, e.g. out.json -> out.folded
+				std::string stackfile = boosty::stringy(fs::path(arg_profile).replace_extension(".folded"));
+				if (stackfile == arg_profile) stackfile += ".folded";
+				if (!GeometryProfiler::instance()->write(*tree.root(), arg_profile, stackfile)) {
+					PRINTB("ERROR: Failed to write profile to '%s'", arg_profile);
+					return 1;
+				}
+			}
 			if (!root_geom) root_geom.reset(new CGAL_Nef_polyhedron());
 			if (renderer == Render::CGAL && root_geom->getDimension() == 3) {
 				const CGAL_Nef_polyhedron *N = dynamic_cast<const CGAL_Nef_polyhedron*>(root_geom.get());
@@ -502,7 +708,8 @@ int cmdline(const char *deps_output_file, const std::string &filename, Camera &c
 		}
 
 		if (stl_output_file) {
-			if (!checkAndExport(root_geom, 3, OPENSCAD_STL, stl_output_file))
+			enum FileFormat format = arg_export_format == "binstl" ? OPENSCAD_STL_BINARY : OPENSCAD_STL;
+			if (!checkAndExport(root_geom, 3, format, stl_output_file))
 				return 1;
 		}
 
@@ -574,6 +781,8 @@ Q_IMPORT_PLUGIN(qtaccessiblewidgets)
 #include <QtConcurrentRun>
 
 Q_DECLARE_METATYPE(shared_ptr<const Geometry>);
+class CGALRenderBuffer;
+Q_DECLARE_METATYPE(shared_ptr<CGALRenderBuffer>);
 
 // Only if "fileName" is not absolute, prepend the "absoluteBase".
 static QString assemblePath(const fs::path& absoluteBaseDir,
@@ -657,6 +866,7 @@ int gui(vector<string> &inputFiles, const fs::path &original_path, int argc, cha
 	
 	// Other global settings
 	qRegisterMetaType<shared_ptr<const Geometry> >();
+	qRegisterMetaType<shared_ptr<CGALRenderBuffer> >();
 	
 	const QString &app_path = app.applicationDirPath();
 	PlatformUtils::registerApplicationPath(app_path.toLocal8Bit().constData());
@@ -788,14 +998,22 @@ int main(int argc, char **argv)
 		("render", po::value<string>()->implicit_value(""), "if exporting a png image, do a full geometry evaluation")
 		("preview", po::value<string>()->implicit_value(""), "if exporting a png image, do an OpenCSG(default) or ThrownTogether preview")
 		("csglimit", po::value<unsigned int>(), "if exporting a png image, stop rendering at the given number of CSG elements")
+		("jobs", po::value<unsigned int>(), "number of threads to use for geometry evaluation (0 = one per CPU core)")
+		("cache-dir", po::value<string>(), "keep evaluated geometry in the given directory between runs")
+		("cache-size", po::value<unsigned int>(), "maximum size of the cache directory in MB (default 1024)")
+		("cache-stats", "print geometry cache statistics when done")
+		("profile", po::value<string>(), "write a geometry evaluation profile to the given JSON file")
 		("camera", po::value<string>(), "parameters for camera when exporting png")
 		("autocenter", "adjust camera to look at object center")
 		("viewall", "adjust camera to fit object")
 		("imgsize", po::value<string>(), "=width,height for exporting png")
 		("projection", po::value<string>(), "(o)rtho or (p)erspective when exporting png")
 		("colorscheme", po::value<string>(), "colorscheme")
+		("views", po::value<string>(), "export one png image per view listed in the given file")
+		("variants", po::value<string>(), "with --views, render the views once per set of assignments listed in the given file")
 		("debug", po::value<string>(), "special debug info")
 		("o,o", po::value<string>(), "out-file")
+		("export-format", po::value<string>(), "format of exported STL files: asciistl (default) or binstl")
 		("s,s", po::value<string>(), "stl-file")
 		("x,x", po::value<string>(), "dxf-file")
 		("d,d", po::value<string>(), "deps-file")
@@ -848,6 +1066,23 @@ int main(int argc, char **argv)
 		RenderSettings::inst()->openCSGTermLimit = vm["csglimit"].as<unsigned int>();
 	}
 
+	if (vm.count("jobs")) {
+		Parallel::setMaxThreads(vm["jobs"].as<unsigned int>());
+	}
+
+#ifdef ENABLE_CGAL
+	if (vm.count("profile")) {
+		arg_profile = vm["profile"].as<string>();
+		GeometryProfiler::instance()->setEnabled(true);
+	}
+#endif
+
+	if (vm.count("cache-dir")) {
+		size_t cachesize = 1024;
+		if (vm.count("cache-size")) cachesize = vm["cache-size"].as<unsigned int>();
+		DiskCache::instance()->setDirectory(vm["cache-dir"].as<string>(), cachesize * 1024 * 1024);
+	}
+
 	if (vm.count("o")) {
 		// FIXME: Allow for multiple output files?
 		if (output_file) help(argv[0], true);
@@ -894,10 +1129,32 @@ int main(int argc, char **argv)
 		arg_colorscheme = vm["colorscheme"].as<string>();
 	}
 
+	if (vm.count("export-format")) {
+		arg_export_format = vm["export-format"].as<string>();
+		if (arg_export_format != "asciistl" && arg_export_format != "binstl") {
+			PRINTB("Unknown export format '%s'.", arg_export_format);
+			help(argv[0], true);
+		}
+	}
+
 	currentdir = boosty::stringy(fs::current_path());
 
 	Camera camera = get_camera(vm);
 
+	vector<PngView> views;
+	vector<Variant> variants;
+	if (vm.count("views")) {
+		if (!read_png_views(vm["views"].as<string>(), vm, views)) exit(1);
+		if (vm.count("variants")) {
+			if (!read_variants(vm["variants"].as<string>(), variants)) exit(1);
+		}
+		if (variants.empty()) variants.push_back(Variant());
+	}
+	else if (vm.count("variants")) {
+		PRINT("--variants requires --views");
+		help(argv[0], true);
+	}
+
 	// Initialize global visitors
 	NodeCache nodecache;
 	NodeDumper dumper(nodecache);
@@ -910,7 +1167,13 @@ int main(int argc, char **argv)
 
 	if (arg_info || cmdlinemode) {
 		if (inputFiles.size() > 1) help(argv[0], true);
-		rc = cmdline(deps_output_file, inputFiles[0], camera, output_file, original_path, renderer, argc, argv);
+		rc = cmdline(deps_output_file, inputFiles[0], camera, output_file, original_path, renderer, views, variants, argc, argv);
+		if (vm.count("cache-stats")) {
+			GeometryCache::instance()->printStats();
+#ifdef ENABLE_CGAL
+			CGALCache::instance()->printStats();
+#endif
+		}
 	}
 	else if (QtUseGUI()) {
 		rc = gui(inputFiles, original_path, argc, argv);
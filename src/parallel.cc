@@ -0,0 +1,152 @@
+#include "parallel.h"
+#include "progress.h"
+
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/version.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace {
+	boost::mutex budget_mutex;
+	unsigned int max_threads = 1;
+	// Number of worker threads currently running, not counting calling threads
+	unsigned int active_workers = 0;
+	// Set in threads started by for_each_index()
+	boost::thread_specific_ptr<bool> worker_flag;
+
+	unsigned int acquireWorkers(size_t wanted)
+	{
+		boost::lock_guard<boost::mutex> lock(budget_mutex);
+		if (active_workers + 1 >= max_threads) return 0;
+		unsigned int granted = (unsigned int)std::min<size_t>(wanted, max_threads - 1 - active_workers);
+		active_workers += granted;
+		return granted;
+	}
+
+	void releaseWorkers(unsigned int num)
+	{
+		boost::lock_guard<boost::mutex> lock(budget_mutex);
+		active_workers -= num;
+	}
+
+	class TaskQueue
+	{
+	public:
+		TaskQueue(size_t n, const boost::function<void (size_t)> &task)
+			: task(task), next(0), n(n), cancelled(false), failed(false) {}
+
+		void run() {
+			size_t idx;
+			while (pop(idx)) {
+				try {
+					task(idx);
+				}
+				catch (const ProgressCancelException &e) {
+					cancel();
+				}
+				catch (const std::exception &e) {
+					fail(e.what());
+				}
+				catch (...) {
+					fail("unknown exception in worker thread");
+				}
+			}
+		}
+
+		void rethrow() const {
+			if (this->cancelled) throw ProgressCancelException();
+			if (this->failed) throw std::runtime_error(this->error);
+		}
+
+	private:
+		bool pop(size_t &idx) {
+			boost::lock_guard<boost::mutex> lock(this->mutex);
+			if (this->cancelled || this->next >= this->n) return false;
+			idx = this->next++;
+			return true;
+		}
+		void cancel() {
+			boost::lock_guard<boost::mutex> lock(this->mutex);
+			this->cancelled = true;
+		}
+		void fail(const std::string &msg) {
+			boost::lock_guard<boost::mutex> lock(this->mutex);
+			if (!this->failed) this->error = msg;
+			this->failed = true;
+		}
+
+		const boost::function<void (size_t)> &task;
+		boost::mutex mutex;
+		size_t next, n;
+		bool cancelled, failed;
+		std::string error;
+	};
+
+	void runWorker(TaskQueue *queue)
+	{
+		worker_flag.reset(new bool(true));
+		queue->run();
+	}
+}
+
+namespace Parallel {
+	unsigned int maxThreads()
+	{
+		boost::lock_guard<boost::mutex> lock(budget_mutex);
+		return max_threads;
+	}
+
+	/*!
+		Sets the number of threads to use. 0 means one thread per hardware thread.
+	*/
+	void setMaxThreads(unsigned int num)
+	{
+		boost::lock_guard<boost::mutex> lock(budget_mutex);
+		max_threads = num > 0 ? num : hardwareThreads();
+	}
+
+	unsigned int hardwareThreads()
+	{
+		unsigned int num = boost::thread::hardware_concurrency();
+		return num > 0 ? num : 1;
+	}
+
+	bool isWorkerThread()
+	{
+		return worker_flag.get() != NULL;
+	}
+
+	void for_each_index(size_t n, const boost::function<void (size_t)> &task)
+	{
+		if (n == 0) return;
+		unsigned int workers = n > 1 ? acquireWorkers(n - 1) : 0;
+		if (workers == 0) {
+			for (size_t i=0;i<n;i++) task(i);
+			return;
+		}
+
+		TaskQueue queue(n, task);
+		boost::thread_group group;
+#if BOOST_VERSION >= 105000
+		// Geometry evaluation recurses deeply; match the main thread's stack limit
+		boost::thread::attributes attrs;
+		attrs.set_stack_size(8 * 1024 * 1024);
+		for (unsigned int i=0;i<workers;i++) {
+			group.add_thread(new boost::thread(attrs, boost::bind(&runWorker, &queue)));
+		}
+#else
+		for (unsigned int i=0;i<workers;i++) {
+			group.create_thread(boost::bind(&runWorker, &queue));
+		}
+#endif
+		queue.run();
+		group.join_all();
+		releaseWorkers(workers);
+		queue.rethrow();
+	}
+};
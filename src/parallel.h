@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <boost/function.hpp>
+
+/*!
+	Minimal task parallelism used by the geometry code.
+
+	The number of threads is a process-wide setting (--jobs on the command line)
+	and defaults to 1, i.e. everything runs in the calling thread. All parallel
+	loops share that budget: a loop started from within a worker thread only gets
+	additional threads if some are idle, otherwise it runs serially.
+*/
+namespace Parallel {
+	unsigned int maxThreads();
+	void setMaxThreads(unsigned int num);
+	unsigned int hardwareThreads();
+
+	/*!
+		Returns true if called from a thread started by for_each_index().
+		Such threads must not call into the GUI.
+	*/
+	bool isWorkerThread();
+
+	/*!
+		Calls task(i) for all i in [0, n) and blocks until all calls have returned.
+		Indices are handed out on demand, so a thread which is done with a cheap
+		task immediately picks up the next pending one.
+
+		A ProgressCancelException thrown by any task is rethrown in the calling
+		thread once all workers have stopped. Any other exception is rethrown as
+		a std::runtime_error.
+	*/
+	void for_each_index(size_t n, const boost::function<void (size_t)> &task);
+};
@@ -319,7 +319,7 @@ expr:
             }
         | expr '.' TOK_ID
             {
-              $$ = new ExpressionMember($1, $3);
+              $$ = fold_constants(new ExpressionMember($1, $3));
                 free($3);
             }
         | TOK_STRING
@@ -338,11 +338,13 @@ expr:
             }
         | '[' expr ':' expr ']'
             {
+                // Not folded: a reversed [begin:end] range prints a
+                // deprecation warning, which must not happen while parsing
                 $$ = new ExpressionRange($2, $4);
             }
         | '[' expr ':' expr ':' expr ']'
             {
-                $$ = new ExpressionRange($2, $4, $6);
+                $$ = fold_constants(new ExpressionRange($2, $4, $6));
             }
         | '[' list_comprehension_elements ']'
             {
@@ -354,59 +356,59 @@ expr:
             }
         | '[' vector_expr optional_commas ']'
             {
-                $$ = $2;
+                $$ = fold_constants($2);
             }
         | expr '*' expr
             {
-                $$ = new ExpressionMultiply($1, $3);
+                $$ = fold_constants(new ExpressionMultiply($1, $3));
             }
         | expr '/' expr
             {
-                $$ = new ExpressionDivision($1, $3);
+                $$ = fold_constants(new ExpressionDivision($1, $3));
             }
         | expr '%' expr
             {
-                $$ = new ExpressionModulo($1, $3);
+                $$ = fold_constants(new ExpressionModulo($1, $3));
             }
         | expr '+' expr
             {
-                $$ = new ExpressionPlus($1, $3);
+                $$ = fold_constants(new ExpressionPlus($1, $3));
             }
         | expr '-' expr
             {
-                $$ = new ExpressionMinus($1, $3);
+                $$ = fold_constants(new ExpressionMinus($1, $3));
             }
         | expr '<' expr
             {
-                $$ = new ExpressionLess($1, $3);
+                $$ = fold_constants(new ExpressionLess($1, $3));
             }
         | expr LE expr
             {
-                $$ = new ExpressionLessOrEqual($1, $3);
+                $$ = fold_constants(new ExpressionLessOrEqual($1, $3));
             }
         | expr EQ expr
             {
-                $$ = new ExpressionEqual($1, $3);
+                $$ = fold_constants(new ExpressionEqual($1, $3));
             }
         | expr NE expr
             {
-                $$ = new ExpressionNotEqual($1, $3);
+                $$ = fold_constants(new ExpressionNotEqual($1, $3));
             }
         | expr GE expr
             {
-                $$ = new ExpressionGreaterOrEqual($1, $3);
+                $$ = fold_constants(new ExpressionGreaterOrEqual($1, $3));
             }
         | expr '>' expr
             {
-                $$ = new ExpressionGreater($1, $3);
+                $$ = fold_constants(new ExpressionGreater($1, $3));
             }
         | expr AND expr
             {
-                $$ = new ExpressionLogicalAnd($1, $3);
+                $$ = fold_constants(new ExpressionLogicalAnd($1, $3));
             }
         | expr OR expr
             {
-                $$ = new ExpressionLogicalOr($1, $3);
+                $$ = fold_constants(new ExpressionLogicalOr($1, $3));
             }
         | '+' expr
             {
@@ -414,11 +416,11 @@ expr:
             }
         | '-' expr
             {
-                $$ = new ExpressionInvert($2);
+                $$ = fold_constants(new ExpressionInvert($2));
             }
         | '!' expr
             {
-                $$ = new ExpressionNot($2);
+                $$ = fold_constants(new ExpressionNot($2));
             }
         | '(' expr ')'
             {
@@ -426,11 +428,11 @@ expr:
             }
         | expr '?' expr ':' expr
             {
-                $$ = new ExpressionTernary($1, $3, $5);
+                $$ = fold_constants(new ExpressionTernary($1, $3, $5));
             }
         | expr '[' expr ']'
             {
-                $$ = new ExpressionArrayLookup($1, $3);
+                $$ = fold_constants(new ExpressionArrayLookup($1, $3));
             }
         | TOK_ID '(' arguments_call ')'
             {
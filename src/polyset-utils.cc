@@ -10,6 +10,7 @@
 #endif
 
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace PolysetUtils {
 
@@ -103,6 +104,52 @@ namespace PolysetUtils {
 		if (degeneratePolygons > 0) PRINT("WARNING: PolySet has degenerate polygons");
 	}
 
+	/*!
+		Returns true if the polyset is a closed, consistently oriented 2-manifold:
+		Every edge is shared by exactly two faces, in opposite directions, and the
+		faces around each vertex form a single fan. Objects touching themselves in an
+		edge or a vertex are rejected. Self-intersections are not detected.
+	*/
+	bool is_closed_manifold(const PolySet &ps) {
+		typedef std::pair<int, int> Edge;
+		Reindexer<Vector3d> verts;
+		// Directed edge -> vertex preceding the edge in its face
+		boost::unordered_map<Edge, int> edges;
+		BOOST_FOREACH(const Polygon &p, ps.polygons) {
+			if (p.size() < 3) return false;
+			std::vector<int> indices(p.size());
+			for (size_t i=0;i<p.size();i++) indices[i] = verts.lookup(p[i]);
+			for (size_t i=0;i<indices.size();i++) {
+				int prev = indices[(i + indices.size() - 1) % indices.size()];
+				Edge edge(indices[i], indices[(i+1) % indices.size()]);
+				if (edge.first == edge.second) return false;
+				if (!edges.insert(std::make_pair(edge, prev)).second) return false;
+			}
+		}
+
+		std::vector<int> outgoing(verts.size());
+		for (boost::unordered_map<Edge, int>::const_iterator it = edges.begin(); it != edges.end(); it++) {
+			if (edges.find(Edge(it->first.second, it->first.first)) == edges.end()) return false;
+			outgoing[it->first.first]++;
+		}
+
+		// Walk around each vertex once, starting at any of its outgoing edges
+		std::vector<bool> visited(verts.size());
+		for (boost::unordered_map<Edge, int>::const_iterator it = edges.begin(); it != edges.end(); it++) {
+			int v = it->first.first;
+			if (visited[v]) continue;
+			visited[v] = true;
+			int steps = 0;
+			Edge edge = it->first;
+			do {
+				edge = Edge(v, edges[edge]);
+				steps++;
+			} while (edge != it->first && steps <= outgoing[v]);
+			if (steps != outgoing[v]) return false;
+		}
+		return true;
+	}
+
 	bool is_approximately_convex(const PolySet &ps) {
 #ifdef ENABLE_CGAL
 		return CGALUtils::is_approximately_convex(ps);
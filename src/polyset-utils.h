@@ -7,6 +7,7 @@ namespace PolysetUtils {
 
 	Polygon2d *project(const PolySet &ps);
 	void tessellate_faces(const PolySet &inps, PolySet &outps);
+	bool is_closed_manifold(const PolySet &ps);
 	bool is_approximately_convex(const PolySet &ps);
 
 };
@@ -29,6 +29,7 @@
 #include "linalg.h"
 #include "printutils.h"
 #include "grid.h"
+#include "VBOCache.h"
 
 #include <Eigen/LU>
 #include <boost/foreach.hpp>
@@ -154,6 +155,10 @@ void PolySet::append(const PolySet &ps)
 	if (!dirty && !this->bbox.isNull()) {
 		this->bbox.extend(ps.getBoundingBox());
 	}
+	else {
+		// The cached bbox may be null just because nothing was added yet
+		this->dirty = true;
+	}
 }
 
 void PolySet::transform(const Transform3d &mat)
@@ -210,10 +215,14 @@ void PolySet::resize(Vector3d newsize, const Eigen::Matrix<bool,3,1> &autosize)
 */
 void PolySet::quantizeVertices()
 {
-	Grid3d<int> grid(GRID_FINE);
-	int numverts = 0;
+	size_t numverts = 0;
+	BOOST_FOREACH(const Polygon &p, this->polygons) numverts += p.size();
+	GridWelder grid(GRID_FINE, numverts);
+
 	std::vector<int> indices; // Vertex indices in one polygon
-	for (std::vector<Polygon>::iterator iter = this->polygons.begin(); iter != this->polygons.end();) {
+	// Collapsed polygons are removed by moving the remaining ones forward
+	std::vector<Polygon>::iterator out = this->polygons.begin();
+	for (std::vector<Polygon>::iterator iter = this->polygons.begin(); iter != this->polygons.end(); iter++) {
 		Polygon &p = *iter;
 		indices.resize(p.size());
 		// Quantize all vertices. Build index list
@@ -228,82 +237,28 @@ void PolySet::quantizeVertices()
 		p.erase(currp, p.end());
 		if (p.size() < 3) {
 			PRINTD("Removing collapsed polygon due to quantizing");
-			this->polygons.erase(iter);
 		}
 		else {
-			iter++;
+			if (out != iter) out->swap(p);
+			out++;
 		}
 	}
+	this->polygons.erase(out, this->polygons.end());
+	this->dirty = true;
 }
 
 // all GL functions grouped together here
 #ifndef NULLGL
-static void gl_draw_triangle(GLint *shaderinfo, const Vector3d &p0, const Vector3d &p1, const Vector3d &p2, bool e0, bool e1, bool e2, double z, bool mirrored)
-{
-	double ax = p1[0] - p0[0], bx = p1[0] - p2[0];
-	double ay = p1[1] - p0[1], by = p1[1] - p2[1];
-	double az = p1[2] - p0[2], bz = p1[2] - p2[2];
-	double nx = ay*bz - az*by;
-	double ny = az*bx - ax*bz;
-	double nz = ax*by - ay*bx;
-	double nl = sqrt(nx*nx + ny*ny + nz*nz);
-	glNormal3d(nx / nl, ny / nl, nz / nl);
-#ifdef ENABLE_OPENCSG
-	if (shaderinfo) {
-		double e0f = e0 ? 2.0 : -1.0;
-		double e1f = e1 ? 2.0 : -1.0;
-		double e2f = e2 ? 2.0 : -1.0;
-		glVertexAttrib3d(shaderinfo[3], e0f, e1f, e2f);
-		glVertexAttrib3d(shaderinfo[4], p1[0], p1[1], p1[2] + z);
-		glVertexAttrib3d(shaderinfo[5], p2[0], p2[1], p2[2] + z);
-		glVertexAttrib3d(shaderinfo[6], 0.0, 1.0, 0.0);
-		glVertex3d(p0[0], p0[1], p0[2] + z);
-		if (!mirrored) {
-			glVertexAttrib3d(shaderinfo[3], e0f, e1f, e2f);
-			glVertexAttrib3d(shaderinfo[4], p0[0], p0[1], p0[2] + z);
-			glVertexAttrib3d(shaderinfo[5], p2[0], p2[1], p2[2] + z);
-			glVertexAttrib3d(shaderinfo[6], 0.0, 0.0, 1.0);
-			glVertex3d(p1[0], p1[1], p1[2] + z);
-		}
-		glVertexAttrib3d(shaderinfo[3], e0f, e1f, e2f);
-		glVertexAttrib3d(shaderinfo[4], p0[0], p0[1], p0[2] + z);
-		glVertexAttrib3d(shaderinfo[5], p1[0], p1[1], p1[2] + z);
-		glVertexAttrib3d(shaderinfo[6], 1.0, 0.0, 0.0);
-		glVertex3d(p2[0], p2[1], p2[2] + z);
-		if (mirrored) {
-			glVertexAttrib3d(shaderinfo[3], e0f, e1f, e2f);
-			glVertexAttrib3d(shaderinfo[4], p0[0], p0[1], p0[2] + z);
-			glVertexAttrib3d(shaderinfo[5], p2[0], p2[1], p2[2] + z);
-			glVertexAttrib3d(shaderinfo[6], 0.0, 0.0, 1.0);
-			glVertex3d(p1[0], p1[1], p1[2] + z);
-		}
-	}
-	else
-#endif
-	{
-		glVertex3d(p0[0], p0[1], p0[2] + z);
-		if (!mirrored)
-			glVertex3d(p1[0], p1[1], p1[2] + z);
-		glVertex3d(p2[0], p2[1], p2[2] + z);
-		if (mirrored)
-			glVertex3d(p1[0], p1[1], p1[2] + z);
-	}
-}
-
-void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m, GLint *shaderinfo) const
+/*!
+	Creates the triangles for rendering the surface. 2D objects are extruded
+	to 1mm, differences slightly thicker.
+*/
+void PolySet::createSurfaceVertices(Renderer::csgmode_e csgmode, bool edgeattribs, VertexArray &vertices) const
 {
-	PRINTD("Polyset render");
-	bool mirrored = m.matrix().determinant() < 0;
-#ifdef ENABLE_OPENCSG
-	if (shaderinfo) {
-		glUniform1f(shaderinfo[7], shaderinfo[9]);
-		glUniform1f(shaderinfo[8], shaderinfo[10]);
-	}
-#endif /* ENABLE_OPENCSG */
+	vertices = VertexArray(GL_TRIANGLES, true, edgeattribs);
 	if (this->dim == 2) {
 		// Render 2D objects 1mm thick, but differences slightly larger
 		double zbase = 1 + ((csgmode & CSGMODE_DIFFERENCE_FLAG) ? 0.1 : 0);
-		glBegin(GL_TRIANGLES);
 
 		// Render top+bottom
 		for (double z = -zbase/2; z < zbase; z += zbase) {
@@ -311,18 +266,18 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 				const Polygon *poly = &polygons[i];
 				if (poly->size() == 3) {
 					if (z < 0) {
-						gl_draw_triangle(shaderinfo, poly->at(0), poly->at(2), poly->at(1), true, true, true, z, mirrored);
+						vertices.addTriangle(poly->at(0), poly->at(2), poly->at(1), true, true, true, z);
 					} else {
-						gl_draw_triangle(shaderinfo, poly->at(0), poly->at(1), poly->at(2), true, true, true, z, mirrored);
+						vertices.addTriangle(poly->at(0), poly->at(1), poly->at(2), true, true, true, z);
 					}
 				}
 				else if (poly->size() == 4) {
 					if (z < 0) {
-						gl_draw_triangle(shaderinfo, poly->at(0), poly->at(3), poly->at(1), true, false, true, z, mirrored);
-						gl_draw_triangle(shaderinfo, poly->at(2), poly->at(1), poly->at(3), true, false, true, z, mirrored);
+						vertices.addTriangle(poly->at(0), poly->at(3), poly->at(1), true, false, true, z);
+						vertices.addTriangle(poly->at(2), poly->at(1), poly->at(3), true, false, true, z);
 					} else {
-						gl_draw_triangle(shaderinfo, poly->at(0), poly->at(1), poly->at(3), true, false, true, z, mirrored);
-						gl_draw_triangle(shaderinfo, poly->at(2), poly->at(3), poly->at(1), true, false, true, z, mirrored);
+						vertices.addTriangle(poly->at(0), poly->at(1), poly->at(3), true, false, true, z);
+						vertices.addTriangle(poly->at(2), poly->at(3), poly->at(1), true, false, true, z);
 					}
 				}
 				else {
@@ -335,11 +290,11 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 					center[1] /= poly->size();
 					for (size_t j = 1; j <= poly->size(); j++) {
 						if (z < 0) {
-							gl_draw_triangle(shaderinfo, center, poly->at(j % poly->size()), poly->at(j - 1),
-									false, true, false, z, mirrored);
+							vertices.addTriangle(center, poly->at(j % poly->size()), poly->at(j - 1),
+																	 false, true, false, z);
 						} else {
-							gl_draw_triangle(shaderinfo, center, poly->at(j - 1), poly->at(j % poly->size()),
-									false, true, false, z, mirrored);
+							vertices.addTriangle(center, poly->at(j - 1), poly->at(j % poly->size()),
+																	 false, true, false, z);
 						}
 					}
 				}
@@ -354,8 +309,8 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 					Vector3d p2(o.vertices[j-1][0], o.vertices[j-1][1], zbase/2);
 					Vector3d p3(o.vertices[j % o.vertices.size()][0], o.vertices[j % o.vertices.size()][1], -zbase/2);
 					Vector3d p4(o.vertices[j % o.vertices.size()][0], o.vertices[j % o.vertices.size()][1], zbase/2);
-					gl_draw_triangle(shaderinfo, p2, p1, p3, true, true, false, 0, mirrored);
-					gl_draw_triangle(shaderinfo, p2, p3, p4, false, true, true, 0, mirrored);
+					vertices.addTriangle(p2, p1, p3, true, true, false, 0);
+					vertices.addTriangle(p2, p3, p4, false, true, true, 0);
 				}
 			}
 		}
@@ -370,22 +325,20 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 					Vector3d p3 = poly->at(j % poly->size()), p4 = poly->at(j % poly->size());
 					p1[2] -= zbase/2, p2[2] += zbase/2;
 					p3[2] -= zbase/2, p4[2] += zbase/2;
-					gl_draw_triangle(shaderinfo, p2, p1, p3, true, true, false, 0, mirrored);
-					gl_draw_triangle(shaderinfo, p2, p3, p4, false, true, true, 0, mirrored);
+					vertices.addTriangle(p2, p1, p3, true, true, false, 0);
+					vertices.addTriangle(p2, p3, p4, false, true, true, 0);
 				}
 			}
 		}
-		glEnd();
 	} else if (this->dim == 3) {
 		for (size_t i = 0; i < polygons.size(); i++) {
 			const Polygon *poly = &polygons[i];
-			glBegin(GL_TRIANGLES);
 			if (poly->size() == 3) {
-				gl_draw_triangle(shaderinfo, poly->at(0), poly->at(1), poly->at(2), true, true, true, 0, mirrored);
+				vertices.addTriangle(poly->at(0), poly->at(1), poly->at(2), true, true, true, 0);
 			}
 			else if (poly->size() == 4) {
-				gl_draw_triangle(shaderinfo, poly->at(0), poly->at(1), poly->at(3), true, false, true, 0, mirrored);
-				gl_draw_triangle(shaderinfo, poly->at(2), poly->at(3), poly->at(1), true, false, true, 0, mirrored);
+				vertices.addTriangle(poly->at(0), poly->at(1), poly->at(3), true, false, true, 0);
+				vertices.addTriangle(poly->at(2), poly->at(3), poly->at(1), true, false, true, 0);
 			}
 			else {
 				Vector3d center = Vector3d::Zero();
@@ -398,10 +351,9 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 				center[1] /= poly->size();
 				center[2] /= poly->size();
 				for (size_t j = 1; j <= poly->size(); j++) {
-					gl_draw_triangle(shaderinfo, center, poly->at(j - 1), poly->at(j % poly->size()), false, true, false, 0, mirrored);
+					vertices.addTriangle(center, poly->at(j - 1), poly->at(j % poly->size()), false, true, false, 0);
 				}
 			}
-			glEnd();
 		}
 	}
 	else {
@@ -409,24 +361,24 @@ void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m,
 	}
 }
 
-/*! This is used in throwntogether and CGAL mode
-
-	csgmode is set to CSGMODE_NONE in CGAL mode. In this mode a pure 2D rendering is performed.
+/*!
+	Creates the line segments for rendering the edges.
 
-	For some reason, this is not used to render edges in Preview mode
+	csgmode is set to CSGMODE_NONE in CGAL mode. In this mode only the
+	outlines of 2D objects are created.
 */
-void PolySet::render_edges(Renderer::csgmode_e csgmode) const
+void PolySet::createEdgeVertices(Renderer::csgmode_e csgmode, VertexArray &vertices) const
 {
-	glDisable(GL_LIGHTING);
+	vertices = VertexArray(GL_LINES);
 	if (this->dim == 2) {
 		if (csgmode == Renderer::CSGMODE_NONE) {
 			// Render only outlines
 			BOOST_FOREACH(const Outline2d &o, polygon.outlines()) {
-				glBegin(GL_LINE_LOOP);
-				BOOST_FOREACH(const Vector2d &v, o.vertices) {
-					glVertex3d(v[0], v[1], -0.1);
+				for (size_t j = 1; j <= o.vertices.size(); j++) {
+					const Vector2d &v1 = o.vertices[j-1], &v2 = o.vertices[j % o.vertices.size()];
+					vertices.addVertex(Vector3d(v1[0], v1[1], -0.1));
+					vertices.addVertex(Vector3d(v2[0], v2[1], -0.1));
 				}
-				glEnd();
 			}
 		}
 		else {
@@ -434,42 +386,61 @@ void PolySet::render_edges(Renderer::csgmode_e csgmode) const
 			double zbase = 1 + ((csgmode & CSGMODE_DIFFERENCE_FLAG) ? 0.1 : 0);
 
 			BOOST_FOREACH(const Outline2d &o, polygon.outlines()) {
-				// Render top+bottom outlines
-				for (double z = -zbase/2; z < zbase; z += zbase) {
-					glBegin(GL_LINE_LOOP);
-					BOOST_FOREACH(const Vector2d &v, o.vertices) {
-						glVertex3d(v[0], v[1], z);
+				for (size_t j = 1; j <= o.vertices.size(); j++) {
+					const Vector2d &v1 = o.vertices[j-1], &v2 = o.vertices[j % o.vertices.size()];
+					// Render top+bottom outlines
+					for (double z = -zbase/2; z < zbase; z += zbase) {
+						vertices.addVertex(Vector3d(v1[0], v1[1], z));
+						vertices.addVertex(Vector3d(v2[0], v2[1], z));
 					}
-					glEnd();
+					// Render sides
+					vertices.addVertex(Vector3d(v1[0], v1[1], -zbase/2));
+					vertices.addVertex(Vector3d(v1[0], v1[1], +zbase/2));
 				}
-				// Render sides
-				glBegin(GL_LINES);
-				BOOST_FOREACH(const Vector2d &v, o.vertices) {
-					glVertex3d(v[0], v[1], -zbase/2);
-					glVertex3d(v[0], v[1], +zbase/2);
-				}
-				glEnd();
 			}
 		}
 	} else if (dim == 3) {
 		for (size_t i = 0; i < polygons.size(); i++) {
 			const Polygon *poly = &polygons[i];
-			glBegin(GL_LINE_LOOP);
-			for (size_t j = 0; j < poly->size(); j++) {
-				const Vector3d &p = poly->at(j);
-				glVertex3d(p[0], p[1], p[2]);
+			for (size_t j = 1; j <= poly->size(); j++) {
+				vertices.addVertex(poly->at(j - 1));
+				vertices.addVertex(poly->at(j % poly->size()));
 			}
-			glEnd();
 		}
 	}
 	else {
 		assert(false && "Cannot render object with no dimension");
 	}
+}
+
+/*!
+	Renders the surface without caching the vertex data, see VBOCache for
+	the cached variant.
+*/
+void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m, GLint *shaderinfo) const
+{
+	PRINTD("Polyset render");
+	VertexArray vertices;
+	createSurfaceVertices(csgmode, shaderinfo != NULL, vertices);
+	vertices.draw(shaderinfo, m.matrix().determinant() < 0);
+}
+
+/*! This is used in throwntogether and CGAL mode
+
+	For some reason, this is not used to render edges in Preview mode
+*/
+void PolySet::render_edges(Renderer::csgmode_e csgmode) const
+{
+	VertexArray vertices;
+	createEdgeVertices(csgmode, vertices);
+	glDisable(GL_LIGHTING);
+	vertices.draw(NULL, false);
 	glEnable(GL_LIGHTING);
 }
 
 #else //NULLGL
-static void gl_draw_triangle(GLint *shaderinfo, const Vector3d &p0, const Vector3d &p1, const Vector3d &p2, bool e0, bool e1, bool e2, double z, bool mirrored) {}
+void PolySet::createSurfaceVertices(Renderer::csgmode_e csgmode, bool edgeattribs, VertexArray &vertices) const {}
+void PolySet::createEdgeVertices(Renderer::csgmode_e csgmode, VertexArray &vertices) const {}
 void PolySet::render_surface(Renderer::csgmode_e csgmode, const Transform3d &m, GLint *shaderinfo) const {}
 void PolySet::render_edges(Renderer::csgmode_e csgmode) const {}
 #endif //NULLGL
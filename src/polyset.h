@@ -42,6 +42,8 @@ public:
 
 	void render_surface(Renderer::csgmode_e csgmode, const Transform3d &m, GLint *shaderinfo = NULL) const;
 	void render_edges(Renderer::csgmode_e csgmode) const;
+	void createSurfaceVertices(Renderer::csgmode_e csgmode, bool edgeattribs, class VertexArray &vertices) const;
+	void createEdgeVertices(Renderer::csgmode_e csgmode, VertexArray &vertices) const;
 
 	void transform(const Transform3d &mat);
 	void resize(Vector3d newsize, const Eigen::Matrix<bool,3,1> &autosize);
@@ -5,6 +5,8 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/locks.hpp>
 namespace fs = boost::filesystem;
 #include "boosty.h"
 
@@ -14,6 +16,10 @@ void *outputhandler_data = NULL;
 std::string OpenSCAD::debug("");
 
 boost::circular_buffer<std::string> lastmessages(5);
+static size_t printed_messages = 0;
+
+// Output may come from several geometry evaluation threads at once
+static boost::recursive_mutex print_mutex;
 
 void set_output_handler(OutputHandlerFunc *newhandler, void *userdata)
 {
@@ -23,11 +29,13 @@ void set_output_handler(OutputHandlerFunc *newhandler, void *userdata)
 
 void print_messages_push()
 {
+	boost::lock_guard<boost::recursive_mutex> lock(print_mutex);
 	print_messages_stack.push_back(std::string());
 }
 
 void print_messages_pop()
 {
+	boost::lock_guard<boost::recursive_mutex> lock(print_mutex);
 	std::string msg = print_messages_stack.back();
 	print_messages_stack.pop_back();
 	if (print_messages_stack.size() > 0 && !msg.empty()) {
@@ -41,6 +49,7 @@ void print_messages_pop()
 void PRINT(const std::string &msg)
 {
 	if (msg.empty()) return;
+	boost::lock_guard<boost::recursive_mutex> lock(print_mutex);
 	if (print_messages_stack.size() > 0) {
 		if (!print_messages_stack.back().empty()) {
 			print_messages_stack.back() += "\n";
@@ -53,6 +62,8 @@ void PRINT(const std::string &msg)
 void PRINT_NOCACHE(const std::string &msg)
 {
 	if (msg.empty()) return;
+	boost::lock_guard<boost::recursive_mutex> lock(print_mutex);
+	printed_messages++;
 
 	if (boost::starts_with(msg, "WARNING") || boost::starts_with(msg, "ERROR")) {
 		size_t i;
@@ -70,6 +81,16 @@ void PRINT_NOCACHE(const std::string &msg)
 	}
 }
 
+/*!
+	Returns the number of messages output so far, including suppressed ones.
+	Used to detect whether evaluating something had visible side effects.
+*/
+size_t printed_message_count()
+{
+	boost::lock_guard<boost::recursive_mutex> lock(print_mutex);
+	return printed_messages;
+}
+
 void PRINTDEBUG(const std::string &filename, const std::string &msg)
 {
 	// see printutils.h for usage instructions
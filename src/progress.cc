@@ -1,15 +1,37 @@
 #include "progress.h"
 #include "node.h"
+#include "parallel.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 int progress_report_count;
 void (*progress_report_f)(const class AbstractNode*, void*, int);
 void *progress_report_userdata;
 
+namespace {
+	// Progress made by worker threads, reported with the next update from the
+	// evaluating thread. See progress_update().
+	boost::mutex pending_mutex;
+	const AbstractNode *pending_node = NULL;
+	int pending_mark = 0;
+	bool cancelled = false;
+
+	void reset_pending()
+	{
+		boost::lock_guard<boost::mutex> lock(pending_mutex);
+		pending_node = NULL;
+		pending_mark = 0;
+		cancelled = false;
+	}
+}
+
 void progress_report_prep(AbstractNode *root, void (*f)(const class AbstractNode *node, void *userdata, int mark), void *userdata)
 {
 	progress_report_count = 0;
 	progress_report_f = f;
 	progress_report_userdata = userdata;
+	reset_pending();
 	root->progress_prepare();
 }
 
@@ -18,11 +40,42 @@ void progress_report_fin()
 	progress_report_count = 0;
 	progress_report_f = NULL;
 	progress_report_userdata = NULL;
+	reset_pending();
 }
 
+/*!
+	The report function may update the GUI, so it is only called from the
+	thread which started the evaluation. Worker threads (see Parallel) just
+	record their progress, and throw ProgressCancelException once the report
+	function has requested cancellation.
+*/
 void progress_update(const AbstractNode *node, int mark)
 {
-	if (progress_report_f)
+	if (!progress_report_f) return;
+
+	if (Parallel::isWorkerThread()) {
+		boost::lock_guard<boost::mutex> lock(pending_mutex);
+		if (cancelled) throw ProgressCancelException();
+		if (mark > pending_mark) {
+			pending_node = node;
+			pending_mark = mark;
+		}
+		return;
+	}
+
+	{
+		boost::lock_guard<boost::mutex> lock(pending_mutex);
+		if (pending_mark > mark) {
+			node = pending_node;
+			mark = pending_mark;
+		}
+	}
+	try {
 		progress_report_f(node, progress_report_userdata, mark);
+	}
+	catch (const ProgressCancelException &e) {
+		boost::lock_guard<boost::mutex> lock(pending_mutex);
+		cancelled = true;
+		throw;
+	}
 }
-
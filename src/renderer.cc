@@ -2,10 +2,13 @@
 #include "rendersettings.h"
 #include "Geometry.h"
 #include "polyset.h"
+#include "VBOCache.h"
 #include "Polygon2d.h"
 #include "colormap.h"
 #include "printutils.h"
 
+#include <boost/foreach.hpp>
+
 bool Renderer::getColor(Renderer::ColorMode colormode, Color4f &col) const
 {
 	if (colormode==COLORMODE_NONE) return false;
@@ -102,12 +105,90 @@ void Renderer::setColorScheme(const ColorScheme &cs) {
 void Renderer::render_surface(shared_ptr<const Geometry> geom, csgmode_e csgmode, const Transform3d &m, GLint *shaderinfo)
 {
 	shared_ptr<const PolySet> ps = dynamic_pointer_cast<const PolySet>(geom);
-	if (ps) ps->render_surface(csgmode, m, shaderinfo);
+	if (!ps) return;
+	if (VBOCache *cache = VBOCache::current()) cache->render_surface(ps, csgmode, m, shaderinfo);
+	else ps->render_surface(csgmode, m, shaderinfo);
 }
 
 void Renderer::render_edges(shared_ptr<const Geometry> geom, csgmode_e csgmode)
 {
 	shared_ptr<const PolySet> ps = dynamic_pointer_cast<const PolySet>(geom);
-	if (ps) ps->render_edges(csgmode);
+	if (!ps) return;
+	if (VBOCache *cache = VBOCache::current()) cache->render_edges(ps, csgmode);
+	else ps->render_edges(csgmode);
 }
 
+
+void Renderer::InstanceGroups::add(const shared_ptr<const Geometry> &geom, csgmode_e csgmode,
+																	 const Transform3d &m, const Color4f &color,
+																	 ColorMode colormode, ColorMode edge_colormode)
+{
+	shared_ptr<const PolySet> ps = dynamic_pointer_cast<const PolySet>(geom);
+	if (!ps) return;
+	Instance inst = { &m, &color, colormode, edge_colormode };
+
+	// Blending depends on the draw order, so translucent instances are only
+	// added to the last group, and nothing after them is moved before them
+	const bool translucent = colormode == COLORMODE_BACKGROUND || colormode == COLORMODE_HIGHLIGHT ||
+		(color[3] >= 0 && color[3] < 1);
+	if (translucent) {
+		this->index.clear();
+		if (this->groups.empty() || this->groups.back().ps != ps || this->groups.back().csgmode != csgmode) {
+			this->groups.push_back(Group());
+			this->groups.back().ps = ps;
+			this->groups.back().csgmode = csgmode;
+		}
+		this->groups.back().instances.push_back(inst);
+		return;
+	}
+
+	std::pair<const PolySet *, int> key(ps.get(), csgmode);
+	boost::unordered_map<std::pair<const PolySet *, int>, size_t>::iterator it = this->index.find(key);
+	if (it == this->index.end()) {
+		it = this->index.insert(std::make_pair(key, this->groups.size())).first;
+		this->groups.push_back(Group());
+		this->groups.back().ps = ps;
+		this->groups.back().csgmode = csgmode;
+	}
+	this->groups[it->second].instances.push_back(inst);
+}
+
+void Renderer::InstanceGroups::clear()
+{
+	this->groups.clear();
+	this->index.clear();
+}
+
+#ifndef NULLGL
+/*!
+	Draws the surfaces of all instances, followed by their edges if \a showedges
+	is set. Each group's vertex arrays are only bound once per pass.
+*/
+void Renderer::render_instances(const InstanceGroups &instances, bool showedges, GLint *shaderinfo) const
+{
+	BOOST_FOREACH(const InstanceGroups::Group &group, instances.groups) {
+		{
+			VBOCache::Batch batch(group.ps, group.csgmode, shaderinfo);
+			BOOST_FOREACH(const InstanceGroups::Instance &inst, group.instances) {
+				glPushMatrix();
+				glMultMatrixd(inst.m->data());
+				setColor(inst.colormode, inst.color->data(), shaderinfo);
+				batch.draw(*inst.m);
+				glPopMatrix();
+			}
+		}
+		if (showedges) {
+			VBOCache::Batch batch(group.ps, group.csgmode, NULL, true);
+			BOOST_FOREACH(const InstanceGroups::Instance &inst, group.instances) {
+				glPushMatrix();
+				glMultMatrixd(inst.m->data());
+				setColor(inst.edge_colormode);
+				batch.draw(*inst.m);
+				glPopMatrix();
+			}
+		}
+	}
+}
+#else //NULLGL
+void Renderer::render_instances(const InstanceGroups &instances, bool showedges, GLint *shaderinfo) const {}
+#endif //NULLGL
@@ -5,6 +5,10 @@
 #include "memory.h"
 #include "colormap.h"
 
+#include <vector>
+#include <utility>
+#include <boost/unordered_map.hpp>
+
 #ifdef _MSC_VER // NULL
 #include <cstdlib>
 #endif
@@ -51,6 +55,44 @@ public:
 	static void render_edges(shared_ptr<const Geometry> geom, csgmode_e csgmode);
 
 protected:
+	/*!
+		Objects sharing the same PolySet and csgmode, in the order their
+		geometry first appeared. Each group is drawn by setting up its vertex
+		arrays once and then drawing every instance with its own transform and
+		color. Transforms and colors are referenced, not copied.
+
+		Only opaque objects are grouped. Translucent ones, i.e. background,
+		highlighted and alpha colored objects, keep their order relative to
+		all other objects.
+	*/
+	class InstanceGroups
+	{
+	public:
+		void add(const shared_ptr<const class Geometry> &geom, csgmode_e csgmode,
+						 const Transform3d &m, const Color4f &color,
+						 ColorMode colormode, ColorMode edge_colormode = COLORMODE_NONE);
+		bool empty() const { return this->groups.empty(); }
+		void clear();
+
+		struct Instance {
+			const Transform3d *m;
+			const Color4f *color;
+			ColorMode colormode;
+			ColorMode edge_colormode;
+		};
+		struct Group {
+			shared_ptr<const class PolySet> ps;
+			csgmode_e csgmode;
+			std::vector<Instance> instances;
+		};
+		std::vector<Group> groups;
+
+	private:
+		boost::unordered_map<std::pair<const PolySet *, int>, size_t> index;
+	};
+
+	void render_instances(const InstanceGroups &instances, bool showedges, GLint *shaderinfo = NULL) const;
+
 	std::map<ColorMode,Color4f> colormap;
 	const ColorScheme *colorscheme;
 };
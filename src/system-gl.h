@@ -13,6 +13,11 @@
 #else // NULLGL
 #define GLint int
 #define GLuint unsigned int
+#define GLenum unsigned int
+#define GLsizei int
+#define GLfloat float
+#define GL_LINES 0x0001
+#define GL_TRIANGLES 0x0004
 inline void glColor4fv( float *c ) {}
 #endif // NULLGL
 
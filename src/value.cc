@@ -454,6 +454,7 @@ public:
 
   Value operator()(const Value::VectorType &op1, const Value::VectorType &op2) const {
     Value::VectorType sum;
+    sum.reserve(std::min(op1.size(), op2.size()));
     for (size_t i = 0; i < op1.size() && i < op2.size(); i++) {
       sum.push_back(op1[i] + op2[i]);
     }
@@ -479,6 +480,7 @@ public:
 
   Value operator()(const Value::VectorType &op1, const Value::VectorType &op2) const {
     Value::VectorType sum;
+    sum.reserve(std::min(op1.size(), op2.size()));
     for (size_t i = 0; i < op1.size() && i < op2.size(); i++) {
       sum.push_back(op1[i] - op2[i]);
     }
@@ -491,11 +493,85 @@ Value Value::operator-(const Value &v) const
   return boost::apply_visitor(minus_visitor(), this->value, v.value);
 }
 
+namespace /* anonymous */ {
+  /*!
+    Contiguous storage for the numbers of an operand. Typical operands, like
+    points and 4x4 matrices, fit into the fixed-size buffer, so only larger
+    ones are allocated on the heap.
+  */
+  class NumberBuffer
+  {
+  public:
+    NumberBuffer() : ptr(fixed), n(0) {}
+
+    void resize(size_t size) {
+      if (size > FIXED_SIZE) {
+        heap.resize(size);
+        ptr = &heap[0];
+      }
+      else {
+        ptr = fixed;
+      }
+      n = size;
+    }
+    size_t size() const { return n; }
+    double &operator[](size_t i) { return ptr[i]; }
+    const double &operator[](size_t i) const { return ptr[i]; }
+    const double *data() const { return ptr; }
+
+  private:
+    // Not copyable, ptr may point into the object itself
+    NumberBuffer(const NumberBuffer &);
+    NumberBuffer &operator=(const NumberBuffer &);
+
+    static const size_t FIXED_SIZE = 16;
+    double fixed[FIXED_SIZE];
+    std::vector<double> heap;
+    double *ptr;
+    size_t n;
+  };
+
+  /*!
+    Copies a vector of numbers into contiguous storage.
+    Returns false if any element isn't a number.
+  */
+  bool getNumbers(const Value::VectorType &vec, NumberBuffer &out)
+  {
+    out.resize(vec.size());
+    for (size_t i=0;i<vec.size();i++) {
+      if (!vec[i].getDouble(out[i])) return false;
+    }
+    return true;
+  }
+
+  /*!
+    Copies the first cols columns of a matrix of numbers into contiguous
+    row-major storage. Returns false if any row isn't a vector, is too short
+    or contains something else than numbers. If exactcols is true, longer
+    rows are rejected as well.
+  */
+  bool getMatrix(const Value::VectorType &mat, size_t cols, NumberBuffer &out, bool exactcols)
+  {
+    out.resize(mat.size() * cols);
+    for (size_t i=0;i<mat.size();i++) {
+      if (mat[i].type() != Value::VECTOR) return false;
+      const Value::VectorType &row = mat[i].toVector();
+      if (row.size() < cols || (exactcols && row.size() != cols)) return false;
+      for (size_t j=0;j<cols;j++) {
+        if (!row[j].getDouble(out[i*cols + j])) return false;
+      }
+    }
+    return true;
+  }
+}
+
 Value Value::multvecnum(const Value &vecval, const Value &numval)
 {
   // Vector * Number
+  const VectorType &vec = vecval.toVector();
   VectorType dstv;
-  BOOST_FOREACH(const Value &val, vecval.toVector()) {
+  dstv.reserve(vec.size());
+  BOOST_FOREACH(const Value &val, vec) {
     dstv.push_back(val * numval);
   }
   return Value(dstv);
@@ -507,46 +583,50 @@ Value Value::multmatvec(const Value &matrixval, const Value &vectorval)
   const VectorType &vectorvec = vectorval.toVector();
 
   // Matrix * Vector
+  NumberBuffer vec, mat;
+  if (!getNumbers(vectorvec, vec) || !getMatrix(matrixvec, vec.size(), mat, true)) return Value();
+
+  const size_t cols = vec.size();
   VectorType dstv;
+  dstv.reserve(matrixvec.size());
   for (size_t i=0;i<matrixvec.size();i++) {
-    if (matrixvec[i].type() != VECTOR || 
-        matrixvec[i].toVector().size() != vectorvec.size()) {
-      return Value();
-    }
+    const double *row = &mat[i*cols];
     double r_e = 0.0;
-    for (size_t j=0;j<matrixvec[i].toVector().size();j++) {
-      if (matrixvec[i].toVector()[j].type() != NUMBER || vectorvec[j].type() != NUMBER) {
-        return Value();
-      }
-      r_e += matrixvec[i].toVector()[j].toDouble() * vectorvec[j].toDouble();
-    }
+    for (size_t j=0;j<cols;j++) r_e += row[j] * vec[j];
     dstv.push_back(Value(r_e));
   }
   return Value(dstv);
 }
 
-Value Value::multvecmat(const Value &vectorval, const Value &matrixval)
+/*!
+  Vector * Matrix, with the vector and the rows x cols matrix already in
+  contiguous, row-major storage.
+*/
+Value Value::multvecmat(const double *vec, const double *mat, size_t rows, size_t cols)
 {
-  const VectorType &vectorvec = vectorval.toVector();
-  const VectorType &matrixvec = matrixval.toVector();
-  assert(vectorvec.size() == matrixvec.size());
-  // Vector * Matrix
   VectorType dstv;
-  for (size_t i=0;i<matrixvec[0].toVector().size();i++) {
+  dstv.reserve(cols);
+  for (size_t i=0;i<cols;i++) {
     double r_e = 0.0;
-    for (size_t j=0;j<vectorvec.size();j++) {
-      if (matrixvec[j].type() != VECTOR ||
-          matrixvec[j].toVector()[i].type() != NUMBER || 
-          vectorvec[j].type() != NUMBER) {
-        return Value::undefined;
-      }
-      r_e += vectorvec[j].toDouble() * matrixvec[j].toVector()[i].toDouble();
-    }
+    for (size_t j=0;j<rows;j++) r_e += vec[j] * mat[j*cols + i];
     dstv.push_back(Value(r_e));
   }
   return Value(dstv);
 }
 
+Value Value::multvecmat(const Value &vectorval, const Value &matrixval)
+{
+  const VectorType &vectorvec = vectorval.toVector();
+  const VectorType &matrixvec = matrixval.toVector();
+  if (vectorvec.size() != matrixvec.size()) return Value::undefined;
+  // Vector * Matrix
+  const size_t cols = matrixvec[0].toVector().size();
+  if (cols == 0) return Value(VectorType());
+  NumberBuffer vec, mat;
+  if (!getNumbers(vectorvec, vec) || !getMatrix(matrixvec, cols, mat, false)) return Value::undefined;
+  return multvecmat(vec.data(), mat.data(), vec.size(), cols);
+}
+
 Value Value::operator*(const Value &v) const
 {
   if (this->type() == NUMBER && v.type() == NUMBER) {
@@ -561,6 +641,7 @@ Value Value::operator*(const Value &v) const
   else if (this->type() == VECTOR && v.type() == VECTOR) {
     const VectorType &vec1 = this->toVector();
     const VectorType &vec2 = v.toVector();
+    if (vec1.empty() || vec2.empty()) return Value::undefined;
     if (vec1[0].type() == NUMBER && vec2[0].type() == NUMBER &&
         vec1.size() == vec2.size()) { 
         // Vector dot product.
@@ -581,9 +662,19 @@ Value Value::operator*(const Value &v) const
     } else if (vec1[0].type() == VECTOR && vec2[0].type() == VECTOR &&
                vec1[0].toVector().size() == vec2.size()) {
       // Matrix * Matrix
+      // Unpack the right hand side once instead of for every row
+      const size_t cols = vec2[0].toVector().size();
+      NumberBuffer mat, row;
+      const bool dense = cols > 0 && getMatrix(vec2, cols, mat, false);
       VectorType dstv;
+      dstv.reserve(vec1.size());
       BOOST_FOREACH(const Value &srcrow, vec1) {
-        dstv.push_back(multvecmat(srcrow, vec2));
+        if (dense && getNumbers(srcrow.toVector(), row) && row.size() == vec2.size()) {
+          dstv.push_back(multvecmat(row.data(), mat.data(), row.size(), cols));
+        }
+        else {
+          dstv.push_back(multvecmat(srcrow, vec2));
+        }
       }
       return Value(dstv);
     }
@@ -599,6 +690,7 @@ Value Value::operator/(const Value &v) const
   else if (this->type() == VECTOR && v.type() == NUMBER) {
     const VectorType &vec = this->toVector();
     VectorType dstv;
+    dstv.reserve(vec.size());
     BOOST_FOREACH(const Value &vecval, vec) {
       dstv.push_back(vecval / v);
     }
@@ -607,6 +699,7 @@ Value Value::operator/(const Value &v) const
   else if (this->type() == NUMBER && v.type() == VECTOR) {
     const VectorType &vec = v.toVector();
     VectorType dstv;
+    dstv.reserve(vec.size());
     BOOST_FOREACH(const Value &vecval, vec) {
       dstv.push_back(*this / vecval);
     }
@@ -631,6 +724,7 @@ Value Value::operator-() const
   else if (this->type() == VECTOR) {
     const VectorType &vec = this->toVector();
     VectorType dstv;
+    dstv.reserve(vec.size());
     BOOST_FOREACH(const Value &vecval, vec) {
       dstv.push_back(-vecval);
     }
@@ -736,7 +830,11 @@ boost::uint32_t Value::RangeType::nbsteps() const {
     }
     steps = (end_val - begin_val) / step_val;
   }
-  
+
+  // Converting a double beyond the range of the integer type is undefined
+  if (steps >= std::numeric_limits<boost::uint32_t>::max()) {
+    return std::numeric_limits<boost::uint32_t>::max();
+  }
   return steps;
 }
 
@@ -852,6 +950,19 @@ ValuePtr::ValuePtr(const Value::RangeType &v)
 	this->reset(new Value(v));
 }
 
+/*!
+	Creates a vector value by taking over the elements of v, which is left
+	empty. Avoids a deep copy of vectors built up element by element.
+*/
+ValuePtr ValuePtr::takeVector(Value::VectorType &v)
+{
+	Value *val = new Value(Value::VectorType());
+	boost::get<Value::VectorType>(val->value).swap(v);
+	ValuePtr ptr(ValuePtr::undefined);
+	ptr.reset(val);
+	return ptr;
+}
+
 bool ValuePtr::operator==(const ValuePtr &v) const
 {
 	return ValuePtr(**this == *v);
@@ -164,8 +164,11 @@ private:
   static Value multvecnum(const Value &vecval, const Value &numval);
   static Value multmatvec(const Value &matrixval, const Value &vectorval);
   static Value multvecmat(const Value &vectorval, const Value &matrixval);
+  static Value multvecmat(const double *vec, const double *mat, size_t rows, size_t cols);
 
   Variant value;
+
+  friend class ValuePtr;
 };
 
 class ValuePtr : public shared_ptr<const Value>
@@ -184,6 +187,8 @@ public:
   ValuePtr(const Value::VectorType &v);
   ValuePtr(const Value::RangeType &v);
 
+  static ValuePtr takeVector(Value::VectorType &v);
+
 	operator bool() const { return **this; }
 
   bool operator==(const ValuePtr &v) const;
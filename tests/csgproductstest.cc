@@ -0,0 +1,187 @@
+/*
+ *  OpenSCAD (www.openscad.org)
+ *  Copyright (C) 2009-2011 Clifford Wolf <clifford@clifford.at> and
+ *                          Marius Kintel <marius@kintel.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  As a special exception, you have permission to link this program
+ *  with the CGAL library and distribute executables, as long as you
+ *  follow the requirements of the GNU GPL in regard to all of the
+ *  software in the executable aside from CGAL.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "tests-common.h"
+#include "openscad.h"
+#include "printutils.h"
+#include "parsersettings.h"
+#include "node.h"
+#include "module.h"
+#include "modcontext.h"
+#include "value.h"
+#include "builtin.h"
+#include "Tree.h"
+#include "csgterm.h"
+#include "csgtermnormalizer.h"
+#include "CSGTermEvaluator.h"
+#include "GeometryEvaluator.h"
+#include "rendersettings.h"
+#include "stackcheck.h"
+
+#include <iostream>
+#include <fstream>
+#include <boost/foreach.hpp>
+
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+#include "boosty.h"
+#include "PlatformUtils.h"
+
+std::string commandline_commands;
+std::string currentdir;
+
+using std::string;
+
+po::variables_map parse_options(int argc, char *argv[])
+{
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help,h", "help message")
+		("normalizelimit", po::value<size_t>(), "Set the maximum number of elements of the normalized tree");
+	
+	po::options_description hidden("Hidden options");
+	hidden.add_options()
+		("input-file", po::value<string>(), "input file")
+		("output-file", po::value<string>(), "output file");
+	
+	po::positional_options_description p;
+	p.add("input-file", 1).add("output-file", 1);
+	
+	po::options_description all_options;
+	all_options.add(desc).add(hidden);
+	
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(all_options).positional(p).run(), vm);
+	po::notify(vm);
+	
+	return vm;
+}
+
+/*!
+	Normalizes the terms and writes the resulting products, one per line.
+*/
+void dumpProducts(std::ostream &out, const std::string &title, CSGTermNormalizer &normalizer,
+									const std::vector<shared_ptr<CSGTerm> > &terms)
+{
+	CSGChain chain;
+	BOOST_FOREACH(const shared_ptr<CSGTerm> &term, terms) {
+		shared_ptr<CSGTerm> normterm = normalizer.normalize(term);
+		if (normterm) chain.import(normterm);
+	}
+	out << title << ":\n";
+	if (!chain.objects.empty()) out << chain.dump();
+}
+
+int main(int argc, char **argv)
+{
+	string filename, outfilename;
+	size_t normalizelimit = RenderSettings::inst()->openCSGTermLimit;
+	StackCheck::inst()->init();
+
+	po::variables_map vm;
+	try {
+		vm = parse_options(argc, argv);
+	} catch ( po::error e ) {
+		std::cerr << "error parsing options: " << e.what() << "\n";
+	}
+	if (vm.count("normalizelimit")) {
+		normalizelimit = vm["normalizelimit"].as<size_t>();
+	}
+	if (vm.count("input-file")) {
+		filename = vm["input-file"].as<string>();
+	}
+	if (vm.count("output-file")) {
+		outfilename = vm["output-file"].as<string>();
+	}
+
+	if (filename.empty() || outfilename.empty()) {
+		std::cerr << "Usage: " << argv[0] << " [--normalizelimit=<n>] <file.scad> <output.txt>\n";
+		exit(1);
+	}
+
+	Builtins::instance()->initialize();
+
+	fs::path original_path = fs::current_path();
+
+	currentdir = boosty::stringy(fs::current_path());
+
+	PlatformUtils::registerApplicationPath(boosty::stringy(fs::path(argv[0]).branch_path()));
+	parser_init();
+
+	ModuleContext top_ctx;
+	top_ctx.registerBuiltin();
+
+	FileModule *root_module;
+	ModuleInstantiation root_inst("group");
+
+	root_module = parsefile(filename.c_str());
+	if (!root_module) {
+		exit(1);
+	}
+
+	if (fs::path(filename).has_parent_path()) {
+		fs::current_path(fs::path(filename).parent_path());
+	}
+
+	AbstractNode::resetIndexCounter();
+	AbstractNode *absolute_root_node = root_module->instantiate(&top_ctx, &root_inst);
+	AbstractNode *root_node;
+	// Do we have an explicit root node (! modifier)?
+	if (!(root_node = find_root_tag(absolute_root_node))) root_node = absolute_root_node;
+
+	Tree tree(root_node);
+
+	GeometryEvaluator geomevaluator(tree);
+	CSGTermEvaluator evaluator(tree, &geomevaluator);
+	std::vector<shared_ptr<CSGTerm> > highlight_terms, background_terms;
+	shared_ptr<CSGTerm> root_raw_term = evaluator.evaluateCSGTerm(*root_node, highlight_terms, background_terms);
+
+	current_path(original_path);
+	std::ofstream outfile(outfilename.c_str());
+	if (!outfile.is_open()) {
+		std::cerr << "Can't open file \"" << outfilename << "\" for writing\n";
+		exit(1);
+	}
+
+	// Normalize the same way as for OpenCSG previews, see CsgInfo::compile_chains()
+	CSGTermNormalizer normalizer(normalizelimit);
+	if (!root_raw_term) {
+		outfile << "No top-level CSG object\n";
+	}
+	else {
+		dumpProducts(outfile, "Products", normalizer, std::vector<shared_ptr<CSGTerm> >(1, root_raw_term));
+	}
+	if (!highlight_terms.empty()) dumpProducts(outfile, "Highlights", normalizer, highlight_terms);
+	if (!background_terms.empty()) dumpProducts(outfile, "Background", normalizer, background_terms);
+	outfile.close();
+
+	Builtins::instance(true);
+
+	return 0;
+}
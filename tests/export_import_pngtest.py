@@ -3,7 +3,7 @@
 # Export-import test
 #
 #
-# Usage: <script> <inputfile> --openscad=<executable-path> --format=<format> --require-manifold [<openscad args>] file.png
+# Usage: <script> <inputfile> --openscad=<executable-path> --format=<format> [--export-format=<stl format>] --require-manifold [<openscad args>] file.png
 #
 #
 # step 1. If the input file is _not_ an .scad file, create a temporary .scad file importing the input file.
@@ -16,7 +16,7 @@
 # All the optional openscad args are passed on to OpenSCAD both in step 2 and 4.
 # Exception: In any --render arguments are passed, the first pass (step 2) will always
 # be run with --render=cgal while the second pass (step 4) will use the passed --render 
-# argument.
+# argument. --export-format (asciistl or binstl) is only passed to the first pass.
 #
 # This script should return 0 on success, not-0 on error.
 #
@@ -54,6 +54,7 @@ formats = ['csg', 'stl','off', 'amf', 'dxf', 'svg']
 parser = argparse.ArgumentParser()
 parser.add_argument('--openscad', required=True, help='Specify OpenSCAD executable')
 parser.add_argument('--format', required=True, choices=[item for sublist in [(f,f.upper()) for f in formats] for item in sublist], help='Specify 3d export format')
+parser.add_argument('--export-format', dest='exportformat', choices=['asciistl', 'binstl'], help='Specify STL export format')
 parser.add_argument('--require-manifold', dest='requiremanifold', action='store_true', help='Require STL output to be manifold')
 parser.set_defaults(requiremanifold=False)
 args,remaining_args = parser.parse_known_args()
@@ -91,6 +92,8 @@ if inputsuffix != '.scad' and inputsuffix != '.csg':
 # For any --render arguments to --render=cgal
 #
 tmpargs =  ['--render=cgal' if arg.startswith('--render') else arg for arg in remaining_args]
+if args.exportformat:
+        tmpargs.append('--export-format=' + args.exportformat)
 
 export_cmd = [args.openscad, inputfile, '-o', exportfile] + tmpargs
 print >> sys.stderr, 'Running OpenSCAD #1:'
@@ -100,6 +103,8 @@ if result != 0:
 	failquit('OpenSCAD #1 failed with return code ' + str(result))
 
 if args.format == 'stl' and args.requiremanifold:
+        if args.exportformat == 'binstl':
+                failquit('--require-manifold only works with ASCII STL files')
         if not validateSTL(exportfile):
                 failquit("Error: Non-manifold STL file exported from OpenSCAD")
 
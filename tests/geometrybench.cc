@@ -0,0 +1,519 @@
+/*
+ *  OpenSCAD (www.openscad.org)
+ *  Copyright (C) 2009-2011 Clifford Wolf <clifford@clifford.at> and
+ *                          Marius Kintel <marius@kintel.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  As a special exception, you have permission to link this program
+ *  with the CGAL library and distribute executables, as long as you
+ *  follow the requirements of the GNU GPL in regard to all of the
+ *  software in the executable aside from CGAL.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+	Micro benchmarks for the geometry kernels.
+
+	Each benchmark runs on generated input of increasing size and reports the
+	best wall time of a few runs, the peak resident set size so far and the
+	throughput, as one JSON object per line. Given a baseline (the saved output
+	of an earlier run), benchmarks which became slower than the threshold are
+	reported and the exit code is non-zero.
+
+	Usage: geometrybench [--filter=name] [--sizes=1,2,4] [--repeat=3]
+	                     [--output=file] [--baseline=file [--threshold=0.2]]
+*/
+
+#include "openscad.h"
+#include "node.h"
+#include "module.h"
+#include "polyset.h"
+#include "polyset-utils.h"
+#include "Polygon2d.h"
+#include "clipper-utils.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "cgalutils.h"
+#include "export.h"
+#include "import.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+#include "boosty.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+std::string commandline_commands;
+std::string currentdir;
+
+using std::string;
+
+// Dummy node reported as the origin of all geometry, for progress reporting
+static ModuleInstantiation bench_inst("geometrybench");
+static AbstractNode bench_node(&bench_inst);
+
+/*!
+	UV sphere with the given number of segments around the equator.
+	All faces are planar (triangles at the poles, quads elsewhere).
+*/
+static PolySet *sphere(int segments, double r = 10, const Vector3d &center = Vector3d(0, 0, 0))
+{
+	PolySet *ps = new PolySet(3, true);
+	int rings = std::max(segments / 2, 2);
+	std::vector<std::vector<Vector3d> > points(rings + 1);
+	for (int i=0;i<=rings;i++) {
+		double phi = M_PI * i / rings;
+		for (int j=0;j<segments;j++) {
+			double theta = 2 * M_PI * j / segments;
+			points[i].push_back(center + r * Vector3d(sin(phi) * cos(theta), sin(phi) * sin(theta), cos(phi)));
+		}
+	}
+	for (int i=0;i<rings;i++) {
+		for (int j=0;j<segments;j++) {
+			int k = (j + 1) % segments;
+			ps->append_poly();
+			if (i > 0) ps->append_vertex(points[i][j]);
+			ps->append_vertex(points[i+1][j]);
+			if (i < rings - 1) ps->append_vertex(points[i+1][k]);
+			ps->append_vertex(points[i][k]);
+		}
+	}
+	return ps;
+}
+
+/*!
+	Prism with n-gon end caps, for polygon tessellation.
+*/
+static PolySet *prism(int n, double r = 10, double h = 10)
+{
+	PolySet *ps = new PolySet(3, true);
+	ps->append_poly();
+	for (int i=n-1;i>=0;i--) ps->append_vertex(r * cos(2 * M_PI * i / n), r * sin(2 * M_PI * i / n), 0);
+	ps->append_poly();
+	for (int i=0;i<n;i++) ps->append_vertex(r * cos(2 * M_PI * i / n), r * sin(2 * M_PI * i / n), h);
+	for (int i=0;i<n;i++) {
+		double a1 = 2 * M_PI * i / n, a2 = 2 * M_PI * (i + 1) / n;
+		ps->append_poly();
+		ps->append_vertex(r * cos(a1), r * sin(a1), 0);
+		ps->append_vertex(r * cos(a2), r * sin(a2), 0);
+		ps->append_vertex(r * cos(a2), r * sin(a2), h);
+		ps->append_vertex(r * cos(a1), r * sin(a1), h);
+	}
+	return ps;
+}
+
+static Polygon2d *circle(int n, double r, const Vector2d &center = Vector2d(0, 0))
+{
+	Polygon2d *poly = new Polygon2d;
+	Outline2d o;
+	for (int i=0;i<n;i++) o.vertices.push_back(center + r * Vector2d(cos(2 * M_PI * i / n), sin(2 * M_PI * i / n)));
+	poly->addOutline(o);
+	return poly;
+}
+
+static Polygon2d *star(int n, double r1, double r2)
+{
+	Polygon2d *poly = new Polygon2d;
+	Outline2d o;
+	for (int i=0;i<n;i++) {
+		double r = (i % 2) ? r1 : r2;
+		o.vertices.push_back(r * Vector2d(cos(2 * M_PI * i / n), sin(2 * M_PI * i / n)));
+	}
+	poly->addOutline(o);
+	return poly;
+}
+
+static Geometry::ChildList children(Geometry *g1, Geometry *g2 = NULL, Geometry *g3 = NULL)
+{
+	Geometry::ChildList list;
+	list.push_back(std::make_pair((const AbstractNode *)&bench_node, shared_ptr<const Geometry>(g1)));
+	if (g2) list.push_back(std::make_pair((const AbstractNode *)&bench_node, shared_ptr<const Geometry>(g2)));
+	if (g3) list.push_back(std::make_pair((const AbstractNode *)&bench_node, shared_ptr<const Geometry>(g3)));
+	return list;
+}
+
+static Geometry::ChildList toNef(const Geometry::ChildList &list)
+{
+	Geometry::ChildList result;
+	BOOST_FOREACH(const Geometry::ChildItem &item, list) {
+		result.push_back(std::make_pair(item.first, shared_ptr<const Geometry>(CGALUtils::createNefPolyhedronFromGeometry(*item.second))));
+	}
+	return result;
+}
+
+/*!
+	A benchmark prepares its input for the given size once (outside of the
+	timing), then run() is timed. items is the number of input elements
+	(e.g. facets) processed by one run, used for the throughput.
+*/
+class Benchmark
+{
+public:
+	Benchmark(const string &name) : name(name), items(0) {}
+	virtual ~Benchmark() {}
+	virtual void setup(int size) = 0;
+	virtual void run() = 0;
+	virtual void teardown() {}
+
+	string name;
+	size_t items;
+};
+
+class CGALOperatorBenchmark : public Benchmark
+{
+public:
+	CGALOperatorBenchmark(const string &name, OpenSCADOperator op) : Benchmark(name), op(op) {}
+	virtual void setup(int size) {
+		int segments = 12 * size;
+		this->operands = toNef(children(sphere(segments), sphere(segments, 8, Vector3d(5, 0, 0)), sphere(segments, 6, Vector3d(0, 5, 0))));
+		this->items = 0;
+		BOOST_FOREACH(const Geometry::ChildItem &item, this->operands) {
+			this->items += dynamic_cast<const CGAL_Nef_polyhedron *>(item.second.get())->p3->number_of_facets();
+		}
+	}
+	virtual void run() { delete CGALUtils::applyOperator(this->operands, this->op); }
+	virtual void teardown() { this->operands.clear(); }
+private:
+	OpenSCADOperator op;
+	Geometry::ChildList operands;
+};
+
+class HullBenchmark : public Benchmark
+{
+public:
+	HullBenchmark() : Benchmark("hull") {}
+	virtual void setup(int size) {
+		int segments = 32 * size;
+		this->operands = children(sphere(segments), sphere(segments, 5, Vector3d(20, 0, 0)));
+		this->items = segments * segments;
+	}
+	virtual void run() { PolySet result(3); CGALUtils::applyHull(this->operands, result); }
+	virtual void teardown() { this->operands.clear(); }
+private:
+	Geometry::ChildList operands;
+};
+
+class MinkowskiBenchmark : public Benchmark
+{
+public:
+	MinkowskiBenchmark() : Benchmark("minkowski") {}
+	virtual void setup(int size) {
+		int segments = 8 * size;
+		this->operands = children(prism(4 * size), sphere(segments, 2));
+		this->items = 4 * size + segments * segments / 2;
+	}
+	virtual void run() { delete CGALUtils::applyMinkowski(this->operands); }
+	virtual void teardown() { this->operands.clear(); }
+private:
+	Geometry::ChildList operands;
+};
+
+class ClipperUnionBenchmark : public Benchmark
+{
+public:
+	ClipperUnionBenchmark() : Benchmark("clipper_union") {}
+	virtual void setup(int size) {
+		int n = 100 * size;
+		for (int i=0;i<n;i++) this->polygons.push_back(circle(64, 2, Vector2d(1.5 * (i % 20), 1.5 * (i / 20))));
+		this->items = n * 64;
+	}
+	virtual void run() { delete ClipperUtils::apply(this->polygons, ClipperLib::ctUnion); }
+	virtual void teardown() {
+		BOOST_FOREACH(const Polygon2d *p, this->polygons) delete p;
+		this->polygons.clear();
+	}
+private:
+	std::vector<const Polygon2d *> polygons;
+};
+
+class OffsetBenchmark : public Benchmark
+{
+public:
+	OffsetBenchmark() : Benchmark("offset") {}
+	virtual void setup(int size) {
+		this->items = 2000 * size;
+		this->polygon.reset(star(this->items, 10, 20));
+	}
+	virtual void run() { delete ClipperUtils::applyOffset(*this->polygon, 0.5, ClipperLib::jtRound, 2, 0.01); }
+	virtual void teardown() { this->polygon.reset(); }
+private:
+	shared_ptr<Polygon2d> polygon;
+};
+
+class TessellateBenchmark : public Benchmark
+{
+public:
+	TessellateBenchmark() : Benchmark("tessellate_faces") {}
+	virtual void setup(int size) {
+		this->ps.reset(prism(5000 * size));
+		this->items = this->ps->polygons.size();
+	}
+	virtual void run() { PolySet result(3); PolysetUtils::tessellate_faces(*this->ps, result); }
+	virtual void teardown() { this->ps.reset(); }
+private:
+	shared_ptr<PolySet> ps;
+};
+
+class NefConversionBenchmark : public Benchmark
+{
+public:
+	NefConversionBenchmark() : Benchmark("nef_conversion") {}
+	virtual void setup(int size) {
+		this->ps.reset(sphere(24 * size));
+		this->items = this->ps->polygons.size();
+	}
+	virtual void run() { delete CGALUtils::createNefPolyhedronFromGeometry(*this->ps); }
+	virtual void teardown() { this->ps.reset(); }
+private:
+	shared_ptr<PolySet> ps;
+};
+
+class ExportSTLBenchmark : public Benchmark
+{
+public:
+	ExportSTLBenchmark(bool binary) : Benchmark(binary ? "export_binstl" : "export_stl"), binary(binary) {}
+	virtual void setup(int size) {
+		this->ps.reset(sphere(128 * size));
+		this->items = this->ps->polygons.size();
+	}
+	virtual void run() {
+		std::ostringstream out;
+		if (this->binary) export_stl_binary(*this->ps, out);
+		else export_stl(*this->ps, out);
+	}
+	virtual void teardown() { this->ps.reset(); }
+private:
+	bool binary;
+	shared_ptr<PolySet> ps;
+};
+
+class ImportSTLBenchmark : public Benchmark
+{
+public:
+	ImportSTLBenchmark(bool binary) : Benchmark(binary ? "import_binstl" : "import_stl"), binary(binary) {}
+	virtual void setup(int size) {
+		shared_ptr<PolySet> ps(sphere(128 * size));
+		this->filename = boosty::stringy(fs::temp_directory_path() / fs::unique_path("geometrybench-%%%%-%%%%.stl"));
+		std::ofstream out(this->filename.c_str(), std::ios::out | std::ios::binary);
+		if (this->binary) export_stl_binary(*ps, out);
+		else export_stl(*ps, out);
+		this->items = ps->polygons.size();
+	}
+	virtual void run() { delete import_stl(this->filename); }
+	virtual void teardown() { fs::remove(this->filename); }
+private:
+	bool binary;
+	string filename;
+};
+
+struct Result {
+	string name;
+	int size;
+	double time;
+	long peakrss;
+	double throughput;
+};
+
+static double seconds_since(const boost::posix_time::ptime &start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+}
+
+/*!
+	Peak resident set size of the process so far, in kB.
+*/
+static long peak_rss()
+{
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes
+#else
+	return usage.ru_maxrss;
+#endif
+#else
+	return 0;
+#endif
+}
+
+static string toJSON(const Result &r)
+{
+	std::ostringstream out;
+	out << "{\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"time\": " << r.time
+			<< ", \"peak_rss_kb\": " << r.peakrss << ", \"throughput\": " << r.throughput << "}";
+	return out.str();
+}
+
+/*!
+	Extracts the value of the given key from a line written by toJSON().
+*/
+static string jsonValue(const string &line, const string &key)
+{
+	string pattern = "\"" + key + "\": ";
+	size_t pos = line.find(pattern);
+	if (pos == string::npos) return "";
+	pos += pattern.size();
+	if (line[pos] == '"') {
+		size_t end = line.find('"', pos + 1);
+		return line.substr(pos + 1, end - pos - 1);
+	}
+	size_t end = line.find_first_of(",}", pos);
+	return line.substr(pos, end - pos);
+}
+
+typedef std::map<std::pair<string, int>, double> Baseline;
+
+static bool readBaseline(const string &filename, Baseline &baseline)
+{
+	std::ifstream in(filename.c_str());
+	if (!in.good()) return false;
+	string line;
+	while (std::getline(in, line)) {
+		try {
+			string name = jsonValue(line, "name");
+			if (name.empty()) continue;
+			int size = boost::lexical_cast<int>(jsonValue(line, "size"));
+			baseline[std::make_pair(name, size)] = boost::lexical_cast<double>(jsonValue(line, "time"));
+		}
+		catch (const boost::bad_lexical_cast &) {
+			std::cerr << "Ignoring malformed baseline line: " << line << "\n";
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help,h", "help message")
+		("filter", po::value<string>(), "only run benchmarks whose name contains this string")
+		("sizes", po::value<string>()->default_value("1,2,4"), "comma separated input size factors")
+		("repeat", po::value<int>()->default_value(3), "number of timed runs per benchmark; the fastest is reported")
+		("output", po::value<string>(), "also write the results to this file")
+		("baseline", po::value<string>(), "compare against results saved from an earlier run")
+		("threshold", po::value<double>()->default_value(0.2), "relative slowdown reported as a regression");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}
+	catch (const po::error &e) {
+		std::cerr << "error parsing options: " << e.what() << "\n";
+		return 1;
+	}
+	if (vm.count("help")) {
+		std::cerr << desc << "\n";
+		return 0;
+	}
+
+	std::vector<int> sizes;
+	std::vector<string> tokens;
+	boost::split(tokens, vm["sizes"].as<string>(), boost::is_any_of(","));
+	BOOST_FOREACH(const string &token, tokens) {
+		try {
+			sizes.push_back(boost::lexical_cast<int>(token));
+		}
+		catch (const boost::bad_lexical_cast &) {
+			std::cerr << "Invalid size: " << token << "\n";
+			return 1;
+		}
+	}
+	const int repeat = std::max(vm["repeat"].as<int>(), 1);
+	const double threshold = vm["threshold"].as<double>();
+
+	Baseline baseline;
+	if (vm.count("baseline") && !readBaseline(vm["baseline"].as<string>(), baseline)) {
+		std::cerr << "Can't read baseline file " << vm["baseline"].as<string>() << "\n";
+		return 1;
+	}
+
+	std::ofstream output;
+	if (vm.count("output")) {
+		output.open(vm["output"].as<string>().c_str());
+		if (!output.good()) {
+			std::cerr << "Can't open output file " << vm["output"].as<string>() << "\n";
+			return 1;
+		}
+	}
+
+	std::vector<Benchmark *> benchmarks;
+	benchmarks.push_back(new CGALOperatorBenchmark("union", OPENSCAD_UNION));
+	benchmarks.push_back(new CGALOperatorBenchmark("difference", OPENSCAD_DIFFERENCE));
+	benchmarks.push_back(new CGALOperatorBenchmark("intersection", OPENSCAD_INTERSECTION));
+	benchmarks.push_back(new HullBenchmark);
+	benchmarks.push_back(new MinkowskiBenchmark);
+	benchmarks.push_back(new ClipperUnionBenchmark);
+	benchmarks.push_back(new OffsetBenchmark);
+	benchmarks.push_back(new TessellateBenchmark);
+	benchmarks.push_back(new NefConversionBenchmark);
+	benchmarks.push_back(new ExportSTLBenchmark(false));
+	benchmarks.push_back(new ExportSTLBenchmark(true));
+	benchmarks.push_back(new ImportSTLBenchmark(false));
+	benchmarks.push_back(new ImportSTLBenchmark(true));
+
+	int regressions = 0;
+	BOOST_FOREACH(Benchmark *benchmark, benchmarks) {
+		if (vm.count("filter") && benchmark->name.find(vm["filter"].as<string>()) == string::npos) continue;
+		BOOST_FOREACH(int size, sizes) {
+			benchmark->setup(size);
+			double best = 0;
+			for (int i=0;i<repeat;i++) {
+				boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+				benchmark->run();
+				double time = seconds_since(start);
+				if (i == 0 || time < best) best = time;
+			}
+			benchmark->teardown();
+
+			Result result = { benchmark->name, size, best, peak_rss(), best > 0 ? benchmark->items / best : 0 };
+			string json = toJSON(result);
+			std::cout << json << std::endl;
+			if (output.is_open()) output << json << "\n";
+
+			Baseline::const_iterator it = baseline.find(std::make_pair(result.name, size));
+			if (it != baseline.end() && result.time > it->second * (1 + threshold)) {
+				std::cerr << "REGRESSION: " << result.name << " (size " << size << "): "
+									<< result.time << "s, baseline " << it->second << "s\n";
+				regressions++;
+			}
+		}
+	}
+	BOOST_FOREACH(Benchmark *benchmark, benchmarks) delete benchmark;
+
+	if (regressions > 0) {
+		std::cerr << regressions << " benchmark(s) regressed by more than " << threshold * 100 << "%\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+
+# Batch png export test
+#
+#
+# Usage: <script> <inputfile> --openscad=<executable-path> [<openscad args>] file.png
+#
+#
+# step 1. Run OpenSCAD once with --views and --variants, exporting three views
+#         of two variants of the .scad file
+# step 2. Run OpenSCAD once per view and variant, exporting a single image
+#         with the equivalent --camera etc. and -D options
+# step 3. Compare each batch image to the corresponding single image. They
+#         must be identical.
+# step 4. Copy the batch image of the default view and variant to the given
+#         .png file
+# step 5. (done in CTest) - compare the given .png file to expected output
+#         of the original .scad file. they should be the same!
+#
+# All the optional openscad args are passed on to OpenSCAD in step 1 and 2.
+# They're also the defaults of the views.
+#
+# This script should return 0 on success, not-0 on error.
+
+import sys, os, shutil, subprocess, argparse
+
+def failquit(*args):
+	if len(args)!=0: print(args)
+	print('png_batch_test args:',str(sys.argv))
+	print('exiting png_batch_test.py with failure')
+	sys.exit(1)
+
+def writefile(filename, lines):
+	try:
+		f = open(filename, 'w')
+		f.write(os.linesep.join(lines) + os.linesep)
+		f.close()
+	except:
+		failquit('failure while opening/writing ' + filename + ': ' + str(sys.exc_info()))
+
+def readfile(filename):
+	try:
+		f = open(filename, 'rb')
+		data = f.read()
+		f.close()
+		return data
+	except:
+		failquit('failure while reading ' + filename + ': ' + str(sys.exc_info()))
+
+def run(cmd):
+	print >> sys.stderr, ' '.join(cmd)
+	result = subprocess.call(cmd, env = fontenv)
+	if result != 0:
+		failquit('OpenSCAD failed with return code ' + str(result))
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=True, help='Specify OpenSCAD executable')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+pngfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+	failquit('cant find input file named: ' + inputfile)
+if not os.path.exists(args.openscad):
+	failquit('cant find openscad executable named: ' + args.openscad)
+
+outputdir = os.path.dirname(pngfile)
+inputbasename = os.path.splitext(os.path.basename(inputfile))[0]
+batchdir = os.path.join(outputdir, inputbasename + '-batch')
+if not os.path.exists(batchdir): os.makedirs(batchdir)
+
+fontdir =  os.path.join(os.path.dirname(args.openscad), "..", "testdata");
+fontenv = os.environ.copy();
+fontenv["OPENSCAD_FONT_PATH"] = fontdir;
+
+# name, options
+views = [('default', []),
+         ('top', ['--camera=0,0,100,0,0,0', '--viewall', '--autocenter', '--projection=ortho']),
+         ('small', ['--imgsize=300,200'])]
+# name, assignments
+variants = [('default', []),
+            ('fn8', ['$fn=8'])]
+
+viewsfile = os.path.join(batchdir, 'views.txt')
+variantsfile = os.path.join(batchdir, 'variants.txt')
+writefile(viewsfile, [' '.join([name] + options) for name, options in views])
+writefile(variantsfile, [' '.join([name] + ['; '.join(assignments)]) for name, assignments in variants])
+
+#
+# Batch run: All views of all variants, named batch-<variant>-<view>.png
+#
+print >> sys.stderr, 'Running OpenSCAD batch export:'
+run([args.openscad, inputfile, '--views=' + viewsfile, '--variants=' + variantsfile,
+     '-o', os.path.join(batchdir, 'batch.png')] + remaining_args)
+
+#
+# Single runs, compared to the batch images
+#
+for variant, assignments in variants:
+	defines = []
+	for assignment in assignments: defines += ['-D', assignment]
+	for view, options in views:
+		batchfile = os.path.join(batchdir, 'batch-' + variant + '-' + view + '.png')
+		singlefile = os.path.join(batchdir, 'single-' + variant + '-' + view + '.png')
+		print >> sys.stderr, 'Running OpenSCAD single export:'
+		run([args.openscad, inputfile, '-o', singlefile] + remaining_args + options + defines)
+		if not os.path.exists(batchfile):
+			failquit('batch export didn\'t write ' + batchfile)
+		if readfile(batchfile) != readfile(singlefile):
+			failquit('batch image ' + batchfile + ' differs from single image ' + singlefile)
+
+try:    shutil.copyfile(os.path.join(batchdir, 'batch-default-default.png'), pngfile)
+except: failquit('failure at copying the batch image to ' + pngfile)
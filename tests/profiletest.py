@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+
+# Renders a .scad file with --profile, checks that the JSON report and the
+# collapsed stack file are well-formed and writes the profiled node tree to
+# the output file. Timings aren't written since they vary between runs.
+#
+# Usage: <script> <inputfile> <openscad-executable> [<openscad args>] <outputfile>
+
+import sys, subprocess, os, json, re
+
+def fail(msg):
+    sys.stderr.write('profiletest: ' + msg + '\n')
+    sys.exit(1)
+
+outputfile = sys.argv[-1]
+stlfile = outputfile + '.stl'
+profilefile = outputfile + '.json'
+stackfile = outputfile + '.folded'
+
+subprocess.check_call([sys.argv[2], sys.argv[1], '-o', stlfile,
+                       '--profile=' + profilefile] + sys.argv[3:-1])
+
+try:
+    profile = json.load(open(profilefile))
+except ValueError as e:
+    fail('invalid JSON in %s: %s' % (profilefile, e))
+stacks = open(stackfile).read().splitlines()
+for f in [stlfile, profilefile, stackfile]: os.unlink(f)
+
+def frame_name(node):
+    name = node['module'] or node['name']
+    return name.replace(';', '_').replace(' ', '_')
+
+lines = []
+paths = set()
+def check_node(node, path, depth):
+    for key, kind in [('index', int), ('name', basestring), ('module', basestring),
+                      ('time', float), ('cache', basestring), ('type', basestring),
+                      ('vertices', int), ('facets', int), ('memsize', int),
+                      ('children', list), ('self_time', float)]:
+        if key not in node: fail('node without "%s"' % key)
+        if kind is float: kind = (int, float)
+        if not isinstance(node[key], kind): fail('bad "%s" in node %s' % (key, node.get('index')))
+    if node['time'] < 0 or node['self_time'] < 0: fail('negative time in node %d' % node['index'])
+    if node['cache'] not in ['hit', 'miss']: fail('bad cache state in node %d' % node['index'])
+    path = path + ';' + frame_name(node) if path else frame_name(node)
+    paths.add(path)
+    lines.append('%s%s (%s) cache %s' % ('  ' * depth, node['name'], node['module'], node['cache']))
+    for child in node['children']: check_node(child, path, depth + 1)
+
+if profile.get('root') is None: fail('no root node')
+check_node(profile['root'], '', 0)
+
+if not isinstance(profile.get('operations'), list): fail('no operations')
+for op in profile['operations']:
+    if not isinstance(op.get('name'), basestring) or not isinstance(op.get('calls'), int) or \
+       not isinstance(op.get('time'), (int, float)) or op['calls'] <= 0 or op['time'] < 0:
+        fail('bad operation %s' % op)
+
+for line in stacks:
+    m = re.match(r'^(.+) (\d+)$', line)
+    if not m: fail('bad stack line "%s"' % line)
+    if m.group(1) not in paths: fail('stack "%s" is not in the node tree' % m.group(1))
+
+out = open(outputfile, 'w')
+out.write('\n'.join(lines) + '\n')
+out.close()